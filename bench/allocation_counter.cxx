@@ -0,0 +1,26 @@
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+
+#include "allocation_counter.hxx"
+
+std::atomic<std::uint64_t> AllocationCounter::allocations = 0;
+std::atomic<std::uint64_t> AllocationCounter::bytes = 0;
+
+void *operator new(std::size_t size)
+{
+	AllocationCounter::allocations.fetch_add(1, std::memory_order_relaxed);
+	AllocationCounter::bytes.fetch_add(size, std::memory_order_relaxed);
+	if (void *pointer = std::malloc(size == 0 ? 1 : size))
+		return pointer;
+	throw std::bad_alloc();
+}
+
+void operator delete(void *pointer) noexcept { std::free(pointer); }
+
+void operator delete(void *pointer, std::size_t) noexcept
+{
+	std::free(pointer);
+}
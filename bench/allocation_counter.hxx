@@ -0,0 +1,20 @@
+#ifndef ALLOCATION_COUNTER_HXX_INCLUDED
+#define ALLOCATION_COUNTER_HXX_INCLUDED
+
+#include <atomic>
+#include <cstdint>
+
+// Allocations made by the whole process through operator new, which is
+// replaced by allocation_counter.cxx in each benchmark linking it.
+struct AllocationCounter {
+	static std::atomic<std::uint64_t> allocations;
+	static std::atomic<std::uint64_t> bytes;
+
+	static void reset()
+	{
+		allocations = 0;
+		bytes = 0;
+	}
+};
+
+#endif
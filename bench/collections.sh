@@ -0,0 +1,19 @@
+#!/bin/sh
+# Times the native List and Map against their emulation with instances.
+# Usage: bench/collections.sh [path/to/lox] [lox options...]
+
+LOX=${1:-build/lox}
+[ $# -gt 0 ] && shift
+DIR=$(dirname "$0")
+
+run() {
+	start=$(date +%s%N)
+	result=$("$LOX" "$@" | tr '\n' ' ') || exit 1
+	end=$(date +%s%N)
+	echo "$(( (end - start) / 1000000 )) ms, prints: $result"
+}
+
+for name in list map; do
+	echo "$name:          $(run "$@" "$DIR/$name.lox")"
+	echo "$name emulated: $(run "$@" "$DIR/${name}_emulated.lox")"
+done
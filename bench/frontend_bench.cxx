@@ -0,0 +1,575 @@
+// Measures the Scanner, the Parser and the Resolver each on their own, on a
+// generated source of the shape and size given, see print_usage.
+//
+// For each phase it reports the fastest of the runs, as tokens, megabytes of
+// source and AST nodes handled per second, and the allocations it made.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <format>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include "scanner.hxx"
+#include "parser.hxx"
+#include "resolver.hxx"
+#include "interpreter.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "allocation_counter.hxx"
+
+using std::string;
+using std::string_view;
+
+enum class Shape { Functions, Nesting, Strings, Classes, All };
+
+// Command line options
+struct Options {
+	Shape shape = Shape::All;
+	// Size of the source generated
+	std::size_t kib = 1024;
+	// Of each nested function for Shape::Nesting
+	unsigned depth = 32;
+	// Of each literal for Shape::Strings
+	unsigned string_length = 1024;
+	// Of each class for Shape::Classes
+	unsigned methods = 50;
+	unsigned runs = 5;
+	bool lazy_parse = false;
+};
+
+static Options options;
+
+// Source generation
+//---------------------------------------------------------
+
+// Many small functions with a bit of everything
+void add_function(string &source, unsigned id)
+{
+	source += std::format(
+		"fun f{0}(a, b) {{\n"
+		"\tvar c = a + b * 2;\n"
+		"\tif (c > 10 and a != nil) return c - 1;\n"
+		"\tfor (var i = 0; i < b; i = i + 1) c = c + i;\n"
+		"\treturn -c;\n"
+		"}}\n",
+		id
+	);
+}
+
+// A function with blocks and ifs nested options.depth deep
+void add_nesting(string &source, unsigned id)
+{
+	source += std::format("fun nest{}(x) {{\n", id);
+	string indent = "\t";
+	string previous = "x";
+	for (unsigned level = 1; level <= options.depth; ++level) {
+		source += std::format(
+			"{0}var v{1} = {2} - 1;\n{0}if (v{1} > 0) {{\n", indent, level,
+			previous
+		);
+		indent += '\t';
+		previous = std::format("v{}", level);
+	}
+	source += std::format("{}return {};\n", indent, previous);
+	for (unsigned level = options.depth; level > 0; --level) {
+		indent.pop_back();
+		source += indent + "}\n";
+	}
+	source += "\treturn x;\n}\n";
+}
+
+// Long string literals concatenated
+void add_strings(string &source, unsigned id)
+{
+	string text;
+	for (unsigned i = 0; i < options.string_length; ++i)
+		text += static_cast<char>('a' + (i + id) % 26);
+	source += std::format("var s{} = \"{}\" + \"{}\";\n", id, text, text);
+}
+
+// A subclass with options.methods methods using fields and super
+void add_class(string &source, unsigned id)
+{
+	source += std::format(
+		"class Base{0} {{\n"
+		"\tinit(a) {{ this.a = a; }}\n"
+		"\tget() {{ return this.a; }}\n"
+		"}}\n"
+		"class C{0} < Base{0} {{\n",
+		id
+	);
+	for (unsigned i = 0; i < options.methods; ++i) {
+		source += std::format(
+			"\tm{0}(x) {{ this.b = x; return super.get() + this.b * {0}; }}\n",
+			i
+		);
+	}
+	source += "}\n";
+}
+
+string generate_source()
+{
+	using Generator = void (*)(string &, unsigned);
+	std::vector<Generator> generators;
+	switch (options.shape) {
+	case Shape::Functions:
+		generators = {add_function};
+		break;
+	case Shape::Nesting:
+		generators = {add_nesting};
+		break;
+	case Shape::Strings:
+		generators = {add_strings};
+		break;
+	case Shape::Classes:
+		generators = {add_class};
+		break;
+	case Shape::All:
+		generators = {add_function, add_nesting, add_strings, add_class};
+		break;
+	}
+
+	string source;
+	auto size = options.kib * 1024;
+	for (unsigned id = 0; source.size() < size; ++id)
+		generators[id % generators.size()](source, id);
+	return source;
+}
+
+// AST node counting
+//---------------------------------------------------------
+
+// Counts the statements and expressions of a program
+class NodeCounter : private StmtVisitor, private ExprVisitor
+{
+public:
+	std::size_t count(const std::vector<StmtPtr> &statements)
+	{
+		nodes = 0;
+		add(statements);
+		return nodes;
+	}
+
+private:
+	void add(const std::vector<StmtPtr> &statements)
+	{
+		for (auto &stmt : statements)
+			add(stmt.get());
+	}
+
+	void add(const Stmt *stmt)
+	{
+		if (stmt != nullptr)
+			stmt->accept(*this);
+	}
+
+	void add(const Expr *expr)
+	{
+		if (expr != nullptr)
+			expr->accept(*this);
+	}
+
+	void add(const std::vector<ExprPtr> &exprs)
+	{
+		for (auto &expr : exprs)
+			add(expr.get());
+	}
+
+	// Statement methods
+	//-----------------------------------------------------
+	void visit_block_stmt(const Block &stmt) override
+	{
+		++nodes;
+		add(stmt.statements);
+	}
+
+	void visit_expr_stmt(const Expression &stmt) override
+	{
+		++nodes;
+		add(stmt.expression.get());
+	}
+
+	void visit_print_stmt(const Print &stmt) override
+	{
+		++nodes;
+		add(stmt.expression.get());
+	}
+
+	void visit_assert_stmt(const Assert &stmt) override
+	{
+		++nodes;
+		add(stmt.expression.get());
+	}
+
+	void visit_break_stmt(const Break &) override { ++nodes; }
+
+	void visit_continue_stmt(const Continue &) override { ++nodes; }
+
+	void visit_return_stmt(const Return &stmt) override
+	{
+		++nodes;
+		add(stmt.value.get());
+	}
+
+	void visit_if_stmt(const If &stmt) override
+	{
+		++nodes;
+		add(stmt.condition.get());
+		add(stmt.then_branch.get());
+		add(stmt.else_branch.get());
+	}
+
+	void visit_while_stmt(const While &stmt) override
+	{
+		++nodes;
+		add(stmt.condition.get());
+		add(stmt.body.get());
+		add(stmt.for_update.get());
+	}
+
+	void visit_var_stmt(const Var &stmt) override
+	{
+		++nodes;
+		add(stmt.initializer.get());
+	}
+
+	void visit_function_stmt(const Function &stmt) override
+	{
+		++nodes;
+		// Null for a body not parsed yet with --lazy
+		if (stmt.body != nullptr)
+			add(*stmt.body);
+	}
+
+	void visit_class_stmt(const Class &stmt) override
+	{
+		++nodes;
+		if (stmt.superclass)
+			++nodes;
+		for (auto &method : stmt.methods)
+			visit_function_stmt(method);
+	}
+
+	// Expression methods
+	//-----------------------------------------------------
+	Object visit_assign_expr(const Assign &expr) override
+	{
+		++nodes;
+		add(expr.expression.get());
+		return nullptr;
+	}
+
+	Object visit_ternary_expr(const Ternary &expr) override
+	{
+		++nodes;
+		add(expr.condition.get());
+		add(expr.true_expr.get());
+		add(expr.false_expr.get());
+		return nullptr;
+	}
+
+	Object visit_logical_expr(const Logical &expr) override
+	{
+		++nodes;
+		add(expr.left.get());
+		add(expr.right.get());
+		return nullptr;
+	}
+
+	Object visit_binary_expr(const Binary &expr) override
+	{
+		++nodes;
+		add(expr.left.get());
+		add(expr.right.get());
+		return nullptr;
+	}
+
+	Object visit_call_expr(const Call &expr) override
+	{
+		++nodes;
+		add(expr.callee.get());
+		add(expr.arguments);
+		return nullptr;
+	}
+
+	Object visit_get_expr(const Get &expr) override
+	{
+		++nodes;
+		add(expr.object.get());
+		return nullptr;
+	}
+
+	Object visit_set_expr(const Set &expr) override
+	{
+		++nodes;
+		add(expr.object.get());
+		add(expr.value.get());
+		return nullptr;
+	}
+
+	Object visit_super_expr(const Super &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_this_expr(const This &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_grouping_expr(const Grouping &expr) override
+	{
+		++nodes;
+		add(expr.expression.get());
+		return nullptr;
+	}
+
+	Object visit_literal_expr(const Literal &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_unary_expr(const Unary &expr) override
+	{
+		++nodes;
+		add(expr.right.get());
+		return nullptr;
+	}
+
+	Object visit_variable_expr(const Variable &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_list_literal_expr(const ListLiteral &expr) override
+	{
+		++nodes;
+		add(expr.elements);
+		return nullptr;
+	}
+
+	Object visit_map_literal_expr(const MapLiteral &expr) override
+	{
+		++nodes;
+		add(expr.keys);
+		add(expr.values);
+		return nullptr;
+	}
+
+	Object visit_subscript_expr(const Subscript &expr) override
+	{
+		++nodes;
+		add(expr.object.get());
+		add(expr.index.get());
+		return nullptr;
+	}
+
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override
+	{
+		++nodes;
+		add(expr.object.get());
+		add(expr.index.get());
+		add(expr.value.get());
+		return nullptr;
+	}
+
+	Object visit_yield_expr(const Yield &expr) override
+	{
+		++nodes;
+		add(expr.value.get());
+		return nullptr;
+	}
+
+	// The rest are only made by the Optimizer, which is not run
+	Object visit_inline_call_expr(const InlineCall &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_numeric_expr(const Numeric &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		++nodes;
+		return nullptr;
+	}
+
+	std::size_t nodes = 0;
+};
+
+// Measurement
+//---------------------------------------------------------
+
+struct Phase {
+	const char *name;
+	// Fastest of the runs
+	double seconds = 0;
+	// Made by the last run
+	std::uint64_t allocations = 0;
+	std::uint64_t allocated_bytes = 0;
+
+	void record(std::chrono::steady_clock::duration time, unsigned run)
+	{
+		double run_seconds = std::chrono::duration<double>(time).count();
+		seconds = run == 0 ? run_seconds : std::min(seconds, run_seconds);
+		allocations = AllocationCounter::allocations;
+		allocated_bytes = AllocationCounter::bytes;
+	}
+};
+
+// Discards everything written to it
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int ch) override { return traits_type::not_eof(ch); }
+	std::streamsize xsputn(const char *, std::streamsize count) override
+	{
+		return count;
+	}
+};
+
+[[noreturn]] void print_usage(const char *program)
+{
+	std::cout
+		<< "Usage: " << program << " [options]\n"
+		<< "Options:\n"
+		<< "  --shape=functions|nesting|strings|classes|all\n"
+		<< "            What the source is made of, all of them by default\n"
+		<< "  --kib=N   Size of the source, 1024 KiB by default\n"
+		<< "  --depth=N Nesting of each function for the nesting shape, 32\n"
+		<< "            by default\n"
+		<< "  --string-length=N\n"
+		<< "            Length of each literal for the strings shape, 1024\n"
+		<< "            by default\n"
+		<< "  --methods=N\n"
+		<< "            Methods of each class for the classes shape, 50\n"
+		<< "            by default\n"
+		<< "  --runs=N  Times each phase is run, 5 by default\n"
+		<< "  --lazy    Only pre-parse the function bodies, like lox --lazy\n";
+	std::exit(EXIT_FAILURE);
+}
+
+// Parses the number after '=' in an option like --name=N
+unsigned parse_count(string_view arg, const char *program)
+{
+	auto value = arg.substr(arg.find('=') + 1);
+	unsigned count = 0;
+	auto [end, error] =
+		std::from_chars(value.data(), value.data() + value.size(), count);
+	if (error != std::errc() || end != value.data() + value.size()
+		|| count == 0)
+		print_usage(program);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	for (int i = 1; i < argc; ++i) {
+		string_view arg = argv[i];
+		if (arg == "--shape=functions")
+			options.shape = Shape::Functions;
+		else if (arg == "--shape=nesting")
+			options.shape = Shape::Nesting;
+		else if (arg == "--shape=strings")
+			options.shape = Shape::Strings;
+		else if (arg == "--shape=classes")
+			options.shape = Shape::Classes;
+		else if (arg == "--shape=all")
+			options.shape = Shape::All;
+		else if (arg.starts_with("--kib="))
+			options.kib = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--depth="))
+			options.depth = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--string-length="))
+			options.string_length = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--methods="))
+			options.methods = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--runs="))
+			options.runs = parse_count(arg, argv[0]);
+		else if (arg == "--lazy")
+			options.lazy_parse = true;
+		else
+			print_usage(argv[0]);
+	}
+
+	auto source = generate_source();
+	NullBuffer null_buffer;
+	std::ostream null_stream(&null_buffer);
+
+	Phase scan{"scan"}, parse{"parse"}, resolve{"resolve"};
+	std::size_t tokens = 0;
+	std::size_t nodes = 0;
+
+	for (unsigned run = 0; run < options.runs; ++run) {
+		// Made before the clock starts, the Resolver stores into it
+		Interpreter interpreter(null_stream);
+		auto &errors = interpreter.error_reporter();
+
+		AllocationCounter::reset();
+		auto start = std::chrono::steady_clock::now();
+		Scanner scanner(source, errors);
+		auto token_list = scanner.scan_tokens();
+		scan.record(std::chrono::steady_clock::now() - start, run);
+		tokens = token_list.size();
+
+		AllocationCounter::reset();
+		start = std::chrono::steady_clock::now();
+		Parser parser(std::move(token_list), errors, options.lazy_parse);
+		auto statements = parser.parse();
+		parse.record(std::chrono::steady_clock::now() - start, run);
+
+		AllocationCounter::reset();
+		start = std::chrono::steady_clock::now();
+		Resolver resolver(interpreter, errors);
+		resolver.resolve(statements);
+		resolve.record(std::chrono::steady_clock::now() - start, run);
+
+		if (errors.had_error) {
+			std::clog << "The source generated has errors.\n";
+			return EXIT_FAILURE;
+		}
+		nodes = NodeCounter().count(statements);
+	}
+
+	std::cout << std::format(
+		"{} bytes, {} tokens, {} AST nodes\n"
+		"{:<10}{:>10}{:>12}{:>10}{:>12}{:>14}{:>12}\n",
+		source.size(), tokens, nodes, "phase", "ms", "Mtokens/s", "MB/s",
+		"Mnodes/s", "allocations", "alloc KiB"
+	);
+	for (auto *phase : {&scan, &parse, &resolve}) {
+		auto seconds = phase->seconds;
+		std::cout << std::format(
+			"{:<10}{:>10.2f}{:>12.2f}{:>10.2f}{:>12.2f}{:>14}{:>12}\n",
+			phase->name, seconds * 1e3, tokens / seconds / 1e6,
+			source.size() / seconds / 1e6, nodes / seconds / 1e6,
+			phase->allocations, phase->allocated_bytes / 1024
+		);
+	}
+
+	return 0;
+}
@@ -0,0 +1,25 @@
+#!/bin/sh
+# Runs N copies of jobs.lox with --jobs=N, for N from 1 to the number of
+# cores. With isolated interpreters the time should stay about the same.
+# Set CORES to try another number of cores.
+# Usage: bench/jobs_scaling.sh [path/to/lox] [lox options...]
+
+LOX=${1:-build/lox}
+[ $# -gt 0 ] && shift
+SCRIPT=$(dirname "$0")/jobs.lox
+CORES=${CORES:-$(nproc 2>/dev/null || echo 4)}
+
+base_ms=0
+for n in $(seq 1 "$CORES"); do
+	files=$(for i in $(seq 1 "$n"); do printf '%s ' "$SCRIPT"; done)
+	start=$(date +%s%N)
+	# shellcheck disable=SC2086
+	"$LOX" "$@" --jobs="$n" $files > /dev/null || exit 1
+	end=$(date +%s%N)
+
+	elapsed_ms=$(( (end - start) / 1000000 ))
+	[ "$elapsed_ms" -eq 0 ] && elapsed_ms=1
+	[ "$n" -eq 1 ] && base_ms=$elapsed_ms
+	speedup=$(awk "BEGIN { printf \"%.2f\", $n * $base_ms / $elapsed_ms }")
+	echo "$n jobs: ${elapsed_ms} ms, speedup ${speedup}x"
+done
@@ -0,0 +1,362 @@
+// Runs Lox programs a number of times each and reports how long they took,
+// their peak memory and their allocations, see print_usage.
+//
+// Each run is made in a child process of its own, so that the peak RSS
+// reported is that of the program alone and no run warms up the next one.
+// Only works on POSIX systems.
+
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <vector>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "liblox.hxx"
+#include "allocation_counter.hxx"
+
+using std::string;
+using std::string_view;
+
+// Command line options
+struct Options {
+	Lox::Options lox;
+	unsigned runs = 5;
+	// Where the results are written as JSON, if not empty
+	string json_path;
+};
+
+static Options options;
+
+// What the child process running a program sends back to the parent
+struct RunResult {
+	bool succeeded = false;
+	double milliseconds = 0;
+	std::uint64_t allocations = 0;
+	std::uint64_t allocated_bytes = 0;
+};
+
+// The runs of a program summarized
+struct Result {
+	string name;
+	string path;
+	bool succeeded = true;
+	double median_ms = 0;
+	double min_ms = 0;
+	double stddev_ms = 0;
+	// Greatest of all the runs, in KiB
+	long peak_rss_kib = 0;
+	// Those of the last run, they do not vary from one run to the next
+	std::uint64_t allocations = 0;
+	std::uint64_t allocated_bytes = 0;
+};
+
+// Discards everything written to it
+class NullBuffer : public std::streambuf
+{
+protected:
+	int overflow(int ch) override { return traits_type::not_eof(ch); }
+	std::streamsize xsputn(const char *, std::streamsize count) override
+	{
+		return count;
+	}
+};
+
+// Runs the source in a new Lox, it is called in the child process.
+// Reading the file and starting the process are not timed.
+RunResult run_once(const string &source)
+{
+	NullBuffer null_buffer;
+	std::ostream null_stream(&null_buffer);
+	RunResult result;
+
+	AllocationCounter::reset();
+	auto start = std::chrono::steady_clock::now();
+	{
+		Lox lox(options.lox, null_stream);
+		result.succeeded = lox.run(source);
+	}
+	auto end = std::chrono::steady_clock::now();
+
+	result.milliseconds =
+		std::chrono::duration<double, std::milli>(end - start).count();
+	result.allocations = AllocationCounter::allocations;
+	result.allocated_bytes = AllocationCounter::bytes;
+	return result;
+}
+
+// Runs the source in a child process, and stores its peak RSS in KiB.
+// Returns a failed result if the child could not be run or crashed.
+RunResult run_in_child(const string &source, long &peak_rss_kib)
+{
+	int fds[2];
+	if (pipe(fds) != 0)
+		return {};
+
+	pid_t pid = fork();
+	if (pid < 0) {
+		close(fds[0]);
+		close(fds[1]);
+		return {};
+	}
+
+	if (pid == 0) {
+		close(fds[0]);
+		auto result = run_once(source);
+		bool written =
+			write(fds[1], &result, sizeof(result)) == sizeof(result);
+		_exit(written ? EXIT_SUCCESS : EXIT_FAILURE);
+	}
+
+	close(fds[1]);
+	RunResult result;
+	bool received = read(fds[0], &result, sizeof(result)) == sizeof(result);
+	close(fds[0]);
+
+	int status = 0;
+	struct rusage usage = {};
+	if (wait4(pid, &status, 0, &usage) != pid || !WIFEXITED(status)
+		|| WEXITSTATUS(status) != EXIT_SUCCESS || !received)
+		return {};
+
+	// ru_maxrss is in KiB on Linux
+	peak_rss_kib = usage.ru_maxrss;
+	return result;
+}
+
+Result run_benchmark(const std::filesystem::path &path)
+{
+	Result result;
+	result.name = path.stem().string();
+	result.path = path.string();
+
+	std::ifstream infile(path);
+	if (!infile) {
+		std::clog << "Cannot open file: " << result.path << "\n";
+		result.succeeded = false;
+		return result;
+	}
+	string source(std::istreambuf_iterator<char>(infile), {});
+
+	std::vector<double> times;
+	for (unsigned i = 0; i < options.runs; ++i) {
+		long peak_rss_kib = 0;
+		auto run = run_in_child(source, peak_rss_kib);
+		if (!run.succeeded) {
+			std::clog << "Failed to run: " << result.path << "\n";
+			result.succeeded = false;
+			return result;
+		}
+
+		times.push_back(run.milliseconds);
+		result.peak_rss_kib = std::max(result.peak_rss_kib, peak_rss_kib);
+		result.allocations = run.allocations;
+		result.allocated_bytes = run.allocated_bytes;
+	}
+
+	std::sort(times.begin(), times.end());
+	auto middle = times.size() / 2;
+	result.median_ms = times.size() % 2 == 1
+						   ? times[middle]
+						   : (times[middle - 1] + times[middle]) / 2;
+	result.min_ms = times.front();
+
+	double mean = 0;
+	for (auto time : times)
+		mean += time;
+	mean /= times.size();
+	double variance = 0;
+	for (auto time : times)
+		variance += (time - mean) * (time - mean);
+	result.stddev_ms = std::sqrt(variance / times.size());
+
+	return result;
+}
+
+void print_table(std::ostream &out, const std::vector<Result> &results)
+{
+	out << std::format(
+		"{:<16}{:>12}{:>12}{:>12}{:>14}{:>14}\n", "program", "median ms",
+		"min ms", "stddev ms", "peak RSS KiB", "allocations"
+	);
+
+	for (auto &result : results) {
+		if (!result.succeeded) {
+			out << std::format("{:<16}{:>12}\n", result.name, "failed");
+			continue;
+		}
+		out << std::format(
+			"{:<16}{:>12.2f}{:>12.2f}{:>12.2f}{:>14}{:>14}\n", result.name,
+			result.median_ms, result.min_ms, result.stddev_ms,
+			result.peak_rss_kib, result.allocations
+		);
+	}
+}
+
+// Quotes a string for JSON, only paths and names are written
+string json_string(string_view text)
+{
+	string quoted = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\')
+			quoted += '\\';
+		if (static_cast<unsigned char>(c) < 0x20)
+			quoted += std::format("\\u{:04x}", static_cast<int>(c));
+		else
+			quoted += c;
+	}
+	return quoted + "\"";
+}
+
+void write_json(std::ostream &out, const std::vector<Result> &results)
+{
+	auto &lox = options.lox;
+	auto engine =
+		lox.engine == Interpreter::Engine::Closure ? "closure" : "tree";
+
+	out << "{\n"
+		<< "  \"options\": {\n"
+		<< "    \"engine\": " << json_string(engine) << ",\n"
+		<< std::format(
+			   "    \"optimize\": {},\n    \"lazy\": {},\n    \"jit\": {},\n"
+			   "    \"runs\": {}\n",
+			   lox.optimize, lox.lazy_parse, lox.jit, options.runs
+		   )
+		<< "  },\n"
+		<< "  \"benchmarks\": [";
+
+	for (std::size_t i = 0; i < results.size(); ++i) {
+		auto &result = results[i];
+		out << (i == 0 ? "\n" : ",\n") << "    {\n"
+			<< "      \"name\": " << json_string(result.name) << ",\n"
+			<< "      \"path\": " << json_string(result.path) << ",\n"
+			<< std::format(
+				   "      \"succeeded\": {},\n"
+				   "      \"median_ms\": {:.3f},\n"
+				   "      \"min_ms\": {:.3f},\n"
+				   "      \"stddev_ms\": {:.3f},\n"
+				   "      \"peak_rss_kib\": {},\n"
+				   "      \"allocations\": {},\n"
+				   "      \"allocated_bytes\": {}\n",
+				   result.succeeded, result.median_ms, result.min_ms,
+				   result.stddev_ms, result.peak_rss_kib, result.allocations,
+				   result.allocated_bytes
+			   )
+			<< "    }";
+	}
+
+	out << "\n  ]\n}\n";
+}
+
+[[noreturn]] void print_usage(const char *program)
+{
+	std::cout
+		<< "Usage: " << program << " [options] [filename...]\n"
+		<< "Runs each program, those in " LOX_BENCH_SUITE " by default.\n"
+		<< "Options:\n"
+		<< "  --runs=N  Times each program is run, 5 by default\n"
+		<< "  --json=FILE\n"
+		<< "            Also write the results to FILE as JSON, - for stdout\n"
+		<< "  --lazy, -O, --engine=tree|closure, --jit, --jit-threshold=N\n"
+		<< "            Run the programs like the lox executable does\n";
+	std::exit(EXIT_FAILURE);
+}
+
+// Parses the number after '=' in an option like --name=N
+unsigned parse_count(string_view arg, const char *program)
+{
+	auto value = arg.substr(arg.find('=') + 1);
+	unsigned count = 0;
+	auto [end, error] =
+		std::from_chars(value.data(), value.data() + value.size(), count);
+	if (error != std::errc() || end != value.data() + value.size()
+		|| count == 0)
+		print_usage(program);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<std::filesystem::path> files;
+	for (int i = 1; i < argc; ++i) {
+		string_view arg = argv[i];
+		if (arg.starts_with("--runs="))
+			options.runs = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--json="))
+			options.json_path = arg.substr(arg.find('=') + 1);
+		else if (arg == "--lazy")
+			options.lox.lazy_parse = true;
+		else if (arg == "-O")
+			options.lox.optimize = true;
+		else if (arg == "--engine=tree")
+			options.lox.engine = Interpreter::Engine::Tree;
+		else if (arg == "--engine=closure")
+			options.lox.engine = Interpreter::Engine::Closure;
+		else if (arg == "--jit")
+			options.lox.jit = true;
+		else if (arg.starts_with("--jit-threshold="))
+			options.lox.jit_threshold = parse_count(arg, argv[0]);
+		else if (arg.starts_with("-"))
+			print_usage(argv[0]);
+		else
+			files.emplace_back(arg);
+	}
+
+	if (files.empty()) {
+		std::error_code error;
+		for (auto &entry :
+			 std::filesystem::directory_iterator(LOX_BENCH_SUITE, error)) {
+			if (entry.path().extension() == ".lox")
+				files.push_back(entry.path());
+		}
+		std::sort(files.begin(), files.end());
+		if (files.empty()) {
+			std::clog << "No programs found in " LOX_BENCH_SUITE "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	// Buffered output would be written out by each child too
+	std::cout << std::flush;
+
+	std::vector<Result> results;
+	for (auto &path : files) {
+		results.push_back(run_benchmark(path));
+		std::clog << "." << std::flush;
+	}
+	std::clog << "\n";
+
+	// Keep the JSON alone on stdout
+	print_table(options.json_path == "-" ? std::clog : std::cout, results);
+
+	if (options.json_path == "-") {
+		write_json(std::cout, results);
+	} else if (!options.json_path.empty()) {
+		std::ofstream out(options.json_path);
+		write_json(out, results);
+		if (!out) {
+			std::clog << "Cannot write file: " << options.json_path << "\n";
+			return EXIT_FAILURE;
+		}
+	}
+
+	bool succeeded = std::all_of(results.begin(), results.end(), [](auto &r) {
+		return r.succeeded;
+	});
+	return succeeded ? EXIT_SUCCESS : EXIT_FAILURE;
+}
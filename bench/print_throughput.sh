@@ -0,0 +1,16 @@
+#!/bin/sh
+# Measures how many lines per second the print statement writes.
+# Usage: bench/print_throughput.sh [path/to/lox] [lox options...]
+
+LOX=${1:-build/lox}
+[ $# -gt 0 ] && shift
+SCRIPT=$(dirname "$0")/print.lox
+LINES=1000000
+
+start=$(date +%s%N)
+"$LOX" "$@" "$SCRIPT" > /dev/null || exit 1
+end=$(date +%s%N)
+
+elapsed_ms=$(( (end - start) / 1000000 ))
+[ "$elapsed_ms" -eq 0 ] && elapsed_ms=1
+echo "$LINES lines in ${elapsed_ms} ms, $(( LINES * 1000 / elapsed_ms )) lines/s"
@@ -0,0 +1,515 @@
+#include <algorithm>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "actor.hxx"
+#include "environment.hxx"
+#include "fiber.hxx"
+#include "interpreter.hxx"
+#include "runtime_error.hxx"
+#include "object/object.hxx"
+#include "object/lox_callable.hxx"
+#include "object/lox_channel.hxx"
+#include "object/lox_class.hxx"
+#include "object/lox_function.hxx"
+#include "object/lox_instance.hxx"
+#include "object/lox_list.hxx"
+#include "object/lox_map.hxx"
+#include "object/float64_array.hxx"
+#include "object/native.hxx"
+
+using std::get;
+using std::make_shared;
+
+// Actor methods
+//---------------------------------------------------------
+
+Actor::Actor(Interpreter &parent, const Object &function_, const Object &argument_)
+	: interpreter(parent, *this)
+	, fiber([this] { run(); })
+{
+	ValueCopier copier(parent, interpreter);
+	copier.copy_globals();
+	function = copier.copy(function_);
+	argument = copier.copy(argument_);
+	copier.link_classes();
+	copier.copy_resolution();
+}
+
+void Actor::run()
+{
+	try {
+		// Then the tasks it left, like at the end of a program
+		if (!interpreter.call_value(function, "spawn", {argument})
+			|| !interpreter.finish_tasks())
+			failed = true;
+	} catch (ActorCancelled) {
+	}
+
+	interpreter.output_sink().flush();
+}
+
+// ActorScheduler methods
+//---------------------------------------------------------
+
+ActorScheduler::ActorScheduler(unsigned thread_count)
+{
+	for (unsigned i = 0; i < thread_count; ++i)
+		workers.push_back(std::make_unique<ActorWorker>());
+
+	// All the workers exist before any can steal from the others
+	for (auto &worker : workers)
+		worker->thread = std::thread(&ActorScheduler::work, this, std::ref(*worker));
+}
+
+ActorScheduler::~ActorScheduler()
+{
+	wait();
+
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	work_ready.notify_all();
+
+	for (auto &worker : workers)
+		worker->thread.join();
+}
+
+void ActorScheduler::spawn(
+	Interpreter &parent, const Object &function, const Object &argument
+)
+{
+#ifndef LOX_FIBERS_SUPPORTED
+	throw NativeFnError("Actors are not supported on this platform.");
+#endif
+
+	bool is_callable = match_types<LoxCallablePtr>(function)
+		|| match_types<LoxClassPtr>(function);
+	if (!is_callable) {
+		throw NativeFnError("The first argument to 'spawn' must be a function.");
+	}
+
+	auto &callable = match_types<LoxCallablePtr>(function)
+		? static_cast<LoxCallable &>(*get<LoxCallablePtr>(function))
+		: static_cast<LoxCallable &>(*get<LoxClassPtr>(function));
+	if (callable.arity() != 1) {
+		throw NativeFnError(
+			"The function passed to 'spawn' must take one argument."
+		);
+	}
+
+	auto actor = std::make_unique<Actor>(parent, function, argument);
+	auto &actor_ref = *actor;
+	{
+		std::lock_guard lock(mutex);
+		actors[actor.get()] = std::move(actor);
+	}
+
+	// Run it by the same worker if spawned by an actor
+	auto spawner = parent.running_actor();
+	if (spawner != nullptr)
+		enqueue(*spawner->worker, actor_ref);
+	else
+		enqueue(*workers[next_worker++ % workers.size()], actor_ref);
+}
+
+bool ActorScheduler::wait()
+{
+	std::unique_lock lock(mutex);
+
+	while (true) {
+		actor_stopped.wait(lock, [this] {
+			return actors.empty() || idle_locked();
+		});
+		if (actors.empty())
+			break;
+
+		// All are waiting for messages which no one can send anymore
+		std::vector<Actor *> stuck;
+		for (auto &[address, actor] : actors) {
+			actor->cancelled = true;
+			stuck.push_back(address);
+		}
+
+		lock.unlock();
+		for (auto actor : stuck)
+			wake(*actor);
+		lock.lock();
+	}
+
+	return !std::exchange(failed, false);
+}
+
+bool ActorScheduler::idle()
+{
+	std::lock_guard lock(mutex);
+	return idle_locked();
+}
+
+bool ActorScheduler::idle_locked() const
+{
+	return queued == 0 && running == 0 && timers.empty() && waking == 0;
+}
+
+void ActorScheduler::sleep(Actor &actor, std::chrono::milliseconds time)
+{
+	actor.state = Actor::State::Parking;
+	{
+		std::lock_guard lock(mutex);
+		timers.push({std::chrono::steady_clock::now() + time, &actor});
+	}
+
+	// The workers waiting for a later timer have to wait less
+	work_ready.notify_all();
+	actor.fiber.suspend();
+}
+
+bool ActorScheduler::park(Actor &actor, std::unique_lock<std::mutex> &lock)
+{
+	actor.state = Actor::State::Parking;
+	lock.unlock();
+	actor.fiber.suspend();
+	lock.lock();
+
+	return !actor.cancelled;
+}
+
+void ActorScheduler::wake(Actor &actor)
+{
+	// If it is still parking, the worker running it queues it
+	if (actor.state.exchange(Actor::State::Woken) == Actor::State::Parked)
+		enqueue(*actor.worker, actor);
+}
+
+void ActorScheduler::work(ActorWorker &worker)
+{
+	while (auto actor = next_actor(worker))
+		run(worker, *actor);
+}
+
+Actor *ActorScheduler::next_actor(ActorWorker &worker)
+{
+	std::unique_lock lock(mutex, std::defer_lock);
+
+	while (true) {
+		if (auto actor = take_ready(worker))
+			return actor;
+
+		lock.lock();
+
+		auto now = std::chrono::steady_clock::now();
+		std::vector<Actor *> expired;
+		while (!timers.empty() && timers.top().deadline <= now) {
+			expired.push_back(timers.top().actor);
+			timers.pop();
+		}
+
+		if (!expired.empty()) {
+			waking += expired.size();
+			lock.unlock();
+			for (auto actor : expired)
+				wake(*actor);
+			lock.lock();
+			waking -= expired.size();
+			lock.unlock();
+			continue;
+		}
+
+		if (stopping)
+			return nullptr;
+
+		// Queued after it was looked for
+		if (queued == 0) {
+			if (timers.empty())
+				work_ready.wait(lock);
+			else
+				work_ready.wait_until(lock, timers.top().deadline);
+		}
+		lock.unlock();
+	}
+}
+
+Actor *ActorScheduler::take_ready(ActorWorker &worker)
+{
+	// Counted as running before it stops being queued, so that the
+	// scheduler does not look idle in between.
+	auto take = [this](ActorWorker &from, bool newest) -> Actor * {
+		std::lock_guard lock(from.mutex);
+		if (from.ready.empty())
+			return nullptr;
+
+		Actor *actor = nullptr;
+		if (newest) {
+			actor = from.ready.back();
+			from.ready.pop_back();
+		} else {
+			actor = from.ready.front();
+			from.ready.pop_front();
+		}
+		running++;
+		queued--;
+		return actor;
+	};
+
+	// Its own newest actor is the most likely to be in the cache,
+	// the oldest one of the others has waited the longest.
+	if (auto actor = take(worker, true))
+		return actor;
+
+	for (auto &other : workers) {
+		if (other.get() == &worker)
+			continue;
+		if (auto actor = take(*other, false))
+			return actor;
+	}
+	return nullptr;
+}
+
+void ActorScheduler::run(ActorWorker &worker, Actor &actor)
+{
+	actor.worker = &worker;
+	actor.state = Actor::State::Running;
+	actor.fiber.resume();
+
+	if (actor.fiber.finished()) {
+		finish(actor);
+	} else {
+		auto parking = Actor::State::Parking;
+		// Woken before it could be parked
+		if (!actor.state.compare_exchange_strong(parking, Actor::State::Parked))
+			enqueue(worker, actor);
+	}
+
+	if (--running == 0 && queued == 0) {
+		std::lock_guard lock(mutex);
+		actor_stopped.notify_all();
+	}
+}
+
+void ActorScheduler::enqueue(ActorWorker &worker, Actor &actor)
+{
+	{
+		std::lock_guard lock(worker.mutex);
+		worker.ready.push_back(&actor);
+	}
+	queued++;
+
+	// A worker looking at the counts holds the mutex until it waits
+	{ std::lock_guard lock(mutex); }
+	work_ready.notify_one();
+}
+
+void ActorScheduler::finish(Actor &actor)
+{
+	std::unique_ptr<Actor> finished;
+	{
+		std::lock_guard lock(mutex);
+		failed = failed || actor.failed;
+		auto result = actors.find(&actor);
+		finished = std::move(result->second);
+		actors.erase(result);
+	}
+	// Destroyed outside of the lock, it may free many objects
+}
+
+// ValueCopier methods
+//---------------------------------------------------------
+
+ValueCopier::ValueCopier(Interpreter &source_, Interpreter &target_)
+	: source(&source_)
+	, target(&target_)
+{
+	environments[source->globals.get()] = target->globals;
+}
+
+void ValueCopier::copy_globals()
+{
+	for (auto &[name, value] : source->globals->values)
+		target->globals->define(name, copy(value));
+}
+
+void ValueCopier::copy_resolution()
+{
+	target->locals = source->locals;
+}
+
+void ValueCopier::link_classes()
+{
+	auto depth = [](const LoxClass &klass) {
+		unsigned result = 0;
+		for (auto super = klass.superclass.get(); super != nullptr;
+			 super = super->superclass.get())
+			result++;
+		return result;
+	};
+
+	// Superclasses first, their tables are copied into the subclasses'
+	std::stable_sort(
+		classes.begin(), classes.end(),
+		[&](const LoxClassPtr &a, const LoxClassPtr &b) {
+			return depth(*a) < depth(*b);
+		}
+	);
+	for (auto &klass : classes)
+		klass->link_methods();
+	classes.clear();
+}
+
+Object ValueCopier::copy(const Object &value)
+{
+	if (auto list = get_if<LoxListPtr>(&value)) {
+		if (auto result = objects.find(list->get()); result != objects.end())
+			return result->second;
+
+		auto copied = make_shared<LoxList>();
+		objects[list->get()] = copied;
+		copied->elements.reserve((*list)->elements.size());
+		for (auto &element : (*list)->elements)
+			copied->elements.push_back(copy(element));
+		return copied;
+	}
+
+	if (auto map = get_if<LoxMapPtr>(&value)) {
+		if (auto result = objects.find(map->get()); result != objects.end())
+			return result->second;
+
+		auto copied = make_shared<LoxMap>();
+		objects[map->get()] = copied;
+		auto keys = (*map)->keys();
+		auto values = (*map)->values();
+		for (std::size_t i = 0; i < keys.size(); ++i)
+			copied->set(copy(keys[i]), copy(values[i]));
+		return copied;
+	}
+
+	if (auto array = get_if<LoxFloat64ArrayPtr>(&value)) {
+		if (auto result = objects.find(array->get()); result != objects.end())
+			return result->second;
+
+		auto copied = make_shared<LoxFloat64Array>((*array)->elements);
+		objects[array->get()] = copied;
+		return copied;
+	}
+
+	if (match_types<LoxChannelPtr>(value))
+		return value;
+
+	// Generators are suspended in the middle of their interpreter's code,
+	// the globals copied for spawn get nil instead.
+	if (match_types<LoxGeneratorPtr>(value)) {
+		if (target == nullptr)
+			throw NativeFnError("Generators can't be sent.");
+		return nullptr;
+	}
+
+	// Copied only for spawn
+	bool is_code = match_types<LoxCallablePtr>(value)
+		|| match_types<LoxClassPtr>(value)
+		|| match_types<LoxInstancePtr>(value);
+	if (is_code && target == nullptr) {
+		throw NativeFnError(
+			"Only nil, booleans, numbers, strings, lists, maps, "
+			"Float64Arrays and channels can be sent."
+		);
+	}
+
+	if (auto callable = get_if<LoxCallablePtr>(&value))
+		return copy(*callable);
+	if (auto klass = get_if<LoxClassPtr>(&value))
+		return copy(*klass);
+	if (auto instance = get_if<LoxInstancePtr>(&value))
+		return copy(*instance);
+
+	// nil, booleans, numbers and strings
+	return value;
+}
+
+EnvironmentPtr ValueCopier::copy(const EnvironmentPtr &environment)
+{
+	if (environment == nullptr)
+		return nullptr;
+	if (auto result = environments.find(environment.get());
+		result != environments.end())
+		return result->second;
+
+	auto copied = make_shared<Environment>();
+	environments[environment.get()] = copied;
+	copied->enclosing = copy(environment->enclosing);
+	for (auto &[name, value] : environment->values)
+		copied->values[name] = copy(value);
+	return copied;
+}
+
+LoxCallablePtr ValueCopier::copy(const LoxCallablePtr &callable)
+{
+	if (auto result = objects.find(callable.get()); result != objects.end())
+		return get<LoxCallablePtr>(result->second);
+
+	if (callable->kind == LoxCallable::Kind::Function) {
+		auto function = static_cast<LoxFunction *>(callable.get());
+		// Compiled by its interpreter, not concurrently by the copy
+		auto &declaration = function->declaration;
+		if (declaration.lazy_body && !declaration.lazy_body->compiled)
+			source->compile_lazy_body(declaration);
+
+		auto copied = make_shared<LoxFunction>(
+			declaration, nullptr, function->is_initializer
+		);
+		objects[callable.get()] = LoxCallablePtr(copied);
+		copied->closure = copy(function->closure);
+		return copied;
+	}
+
+	if (callable->kind == LoxCallable::Kind::BuiltinMethod) {
+		auto method = static_cast<BuiltinMethod *>(callable.get());
+		auto copied = make_shared<BuiltinMethod>(
+			method->name, method->method_arity, method->body, nullptr
+		);
+		objects[callable.get()] = LoxCallablePtr(copied);
+		copied->self = copy(method->self);
+		return copied;
+	}
+
+	// Native functions have no state to copy
+	return callable;
+}
+
+LoxClassPtr ValueCopier::copy(const LoxClassPtr &klass)
+{
+	if (auto result = objects.find(klass.get()); result != objects.end())
+		return get<LoxClassPtr>(result->second);
+
+	auto copied = make_shared<LoxClass>(klass->name, nullptr, ClassMethodMap());
+	copied->self_ptr = copied;
+	objects[klass.get()] = copied;
+
+	if (klass->superclass != nullptr)
+		copied->superclass = copy(klass->superclass);
+	for (auto &[name, method] : klass->methods) {
+		auto function = copy(LoxCallablePtr(method));
+		copied->methods[name] = std::static_pointer_cast<LoxFunction>(function);
+	}
+	classes.push_back(copied);
+	return copied;
+}
+
+LoxInstancePtr ValueCopier::copy(const LoxInstancePtr &instance)
+{
+	if (auto result = objects.find(instance.get()); result != objects.end())
+		return get<LoxInstancePtr>(result->second);
+
+	auto copied = make_shared<LoxInstance>(nullptr);
+	copied->self_ptr = copied;
+	objects[instance.get()] = copied;
+
+	copied->klass = copy(instance->klass);
+	for (auto &[name, value] : instance->fields)
+		copied->fields[name] = copy(value);
+	return copied;
+}
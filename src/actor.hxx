@@ -0,0 +1,181 @@
+#ifndef ACTOR_HXX_INCLUDED
+#define ACTOR_HXX_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+#include "environment.hxx"
+#include "fiber.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+
+class Actor;
+
+// A thread of the ActorScheduler and its queue of actors ready to run
+struct ActorWorker {
+	std::mutex mutex;
+	std::deque<Actor *> ready;
+	std::thread thread;
+};
+
+// Thrown out of a receive to unwind an actor which would wait forever.
+struct ActorCancelled {
+};
+
+// A Lox function started with spawn, running in an interpreter of its own.
+// Actors share no values with each other, only the channels sent to them.
+class Actor
+{
+	friend class ActorScheduler;
+
+public:
+	/// Copies the function and the globals of the parent.
+	Actor(Interpreter &parent, const Object &function, const Object &argument);
+
+	Interpreter interpreter;
+
+private:
+	enum class State { Running, Parking, Parked, Woken };
+
+	// The body of the fiber
+	void run();
+
+	Object function;
+	Object argument;
+	Fiber fiber;
+	// A fiber suspends itself before the worker running it can mark it as
+	// parked, so waking it in between leaves it to the worker to resume it.
+	std::atomic<State> state = State::Running;
+	bool cancelled = false;
+	bool failed = false;
+	// The worker running it or which ran it last
+	ActorWorker *worker = nullptr;
+};
+
+// Runs the actors spawned by a program on a fixed number of threads.
+//
+// Each thread has a queue of actors ready to run and takes from the queues
+// of the others when its own is empty. An actor runs until it finishes,
+// sleeps or waits for a message, the thread then runs another one.
+class ActorScheduler
+{
+public:
+	ActorScheduler(unsigned thread_count);
+	ActorScheduler(const ActorScheduler &) = delete;
+	ActorScheduler &operator=(const ActorScheduler &) = delete;
+	~ActorScheduler();
+
+	/// Runs function(argument) in a new actor, with a copy of the globals of
+	/// the interpreter calling spawn. Throws a NativeFnError if it can not.
+	void
+	spawn(Interpreter &parent, const Object &function, const Object &argument);
+
+	/// Waits for every actor to finish. The ones left waiting for a message
+	/// no one can send anymore are cancelled.
+	/// Returns false if any failed with a runtime error.
+	bool wait();
+
+	/// Whether no actor is running or can run again by itself, none is ready
+	/// to run or sleeping.
+	bool idle();
+
+	/// Suspends the running actor for the time given.
+	void sleep(Actor &actor, std::chrono::milliseconds time);
+
+	/// Suspends the running actor until wake is called for it, unlocking
+	/// the lock meanwhile. Returns false if it was cancelled instead.
+	bool park(Actor &actor, std::unique_lock<std::mutex> &lock);
+
+	/// Makes an actor suspended by park or sleep ready to run again.
+	void wake(Actor &actor);
+
+private:
+	struct Timer {
+		std::chrono::steady_clock::time_point deadline;
+		Actor *actor;
+
+		bool operator>(const Timer &other) const
+		{
+			return deadline > other.deadline;
+		}
+	};
+
+	void work(ActorWorker &worker);
+	// Waits for an actor to run, returns nullptr when stopping
+	Actor *next_actor(ActorWorker &worker);
+	Actor *take_ready(ActorWorker &worker);
+	void run(ActorWorker &worker, Actor &actor);
+	void enqueue(ActorWorker &worker, Actor &actor);
+	void finish(Actor &actor);
+	bool idle_locked() const;
+
+	std::vector<std::unique_ptr<ActorWorker>> workers;
+	// For the actors spawned by threads which are not workers
+	std::atomic<unsigned> next_worker = 0;
+	// Actors in the queues and being run
+	std::atomic<std::size_t> queued = 0;
+	std::atomic<std::size_t> running = 0;
+
+	// Guards the members below
+	std::mutex mutex;
+	std::condition_variable work_ready;
+	std::condition_variable actor_stopped;
+	std::map<Actor *, std::unique_ptr<Actor>> actors;
+	std::priority_queue<Timer, std::vector<Timer>, std::greater<>> timers;
+	// Timers expired, whose actors are being woken
+	std::size_t waking = 0;
+	bool stopping = false;
+	bool failed = false;
+};
+
+// Copies values from the heap of one interpreter to another, as actors do
+// not share them.
+class ValueCopier
+{
+public:
+	/// Copies only data: nil, booleans, numbers, strings, lists, maps and
+	/// Float64Arrays. Channels are shared. For messages.
+	ValueCopier() = default;
+
+	/// Copies everything, for spawn. The globals of source are copied to
+	/// the globals of target with copy_globals.
+	ValueCopier(Interpreter &source_, Interpreter &target_);
+
+	/// Throws a NativeFnError for a value which can not be copied.
+	Object copy(const Object &value);
+
+	void copy_globals();
+
+	/// Copies the variable resolution of the functions, after they are
+	/// copied, as that compiles their lazy bodies.
+	void copy_resolution();
+
+	/// Builds the method tables of the classes copied, once all of them
+	/// are: a superclass may still be being copied when its subclass is.
+	void link_classes();
+
+private:
+	EnvironmentPtr copy(const EnvironmentPtr &environment);
+	LoxCallablePtr copy(const LoxCallablePtr &callable);
+	LoxClassPtr copy(const LoxClassPtr &klass);
+	LoxInstancePtr copy(const LoxInstancePtr &instance);
+
+	Interpreter *source = nullptr;
+	Interpreter *target = nullptr;
+	// Copies made, so that shared and cyclic values stay that way
+	std::map<const void *, Object> objects;
+	std::map<const Environment *, EnvironmentPtr> environments;
+	std::vector<LoxClassPtr> classes;
+};
+
+#endif
@@ -0,0 +1,149 @@
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "allocation_profiler.hxx"
+
+// Sites listed, the ones creating the most bytes
+constexpr std::size_t TOP_COUNT = 30;
+
+static const char *const KIND_NAMES[] = {
+	"environment", "function", "class",         "instance",  "string",
+	"list",        "map",      "Float64Array", "generator",
+};
+
+AllocationProfiler::AllocationProfiler(unsigned sample_interval_)
+	: sample_interval(std::max(sample_interval_, 1u))
+{
+	// Objects created by the top level code
+	functions.push_back({"<script>", 0, nullptr});
+	countdown = next_countdown();
+}
+
+unsigned AllocationProfiler::function_id(const Function &function)
+{
+	// A lazy body is compiled into body on the first call, it stays the key
+	std::shared_ptr<const void> body = function.body;
+	if (function.lazy_body != nullptr)
+		body = function.lazy_body;
+
+	auto [entry, inserted] =
+		function_ids.try_emplace(body.get(), functions.size());
+	if (inserted) {
+		functions.push_back(
+			{function.name.lexeme, function.name.line, std::move(body)}
+		);
+	}
+	return entry->second;
+}
+
+void AllocationProfiler::add(Kind kind, std::size_t bytes, int line)
+{
+	std::uint64_t function = frames.empty() ? 0 : frames.back().function;
+	auto key = function << 32 | static_cast<std::uint32_t>(line);
+
+	auto &totals = sites[key][static_cast<std::size_t>(kind)];
+	totals.count += sample_interval;
+	totals.bytes += bytes * sample_interval;
+}
+
+std::uint64_t AllocationProfiler::next_countdown()
+{
+	if (sample_interval == 1)
+		return 1;
+
+	// xorshift64, the intervals are geometric so that they do not fall in
+	// step with a loop creating objects in a pattern
+	random_state ^= random_state << 13;
+	random_state ^= random_state >> 7;
+	random_state ^= random_state << 17;
+	double uniform = (random_state >> 11) * 0x1p-53;
+	return 1
+		   + static_cast<std::uint64_t>(
+			   std::log1p(-uniform) / std::log1p(-1.0 / sample_interval)
+		   );
+}
+
+std::string AllocationProfiler::function_name(unsigned id) const
+{
+	auto &function = functions[id];
+	if (id == 0)
+		return function.name;
+	return std::format("{}:{}", function.name, function.line);
+}
+
+void AllocationProfiler::report(std::ostream &out) const
+{
+	struct Row {
+		Totals totals;
+		unsigned function;
+		int line;
+		std::size_t kind;
+	};
+
+	std::vector<Row> rows;
+	std::array<Totals, KIND_COUNT> kinds;
+	Totals all;
+	for (auto &[key, totals] : sites) {
+		for (std::size_t kind = 0; kind < KIND_COUNT; ++kind) {
+			if (totals[kind].count == 0)
+				continue;
+			rows.push_back(
+				{totals[kind], static_cast<unsigned>(key >> 32),
+				 static_cast<int>(key & 0xffff'ffff), kind}
+			);
+			kinds[kind].count += totals[kind].count;
+			kinds[kind].bytes += totals[kind].bytes;
+			all.count += totals[kind].count;
+			all.bytes += totals[kind].bytes;
+		}
+	}
+
+	std::sort(rows.begin(), rows.end(), [](const Row &a, const Row &b) {
+		if (a.totals.bytes != b.totals.bytes)
+			return a.totals.bytes > b.totals.bytes;
+		if (a.function != b.function)
+			return a.function < b.function;
+		return a.line != b.line ? a.line < b.line : a.kind < b.kind;
+	});
+
+	auto percent = [&](std::uint64_t bytes) {
+		return bytes * 100.0 / std::max<std::uint64_t>(all.bytes, 1);
+	};
+
+	out << std::format(
+		"Allocations: {} objects, {} bytes", all.count, all.bytes
+	);
+	if (sample_interval != 1)
+		out << std::format(", sampled one in {}", sample_interval);
+	out << '\n';
+
+	for (std::size_t kind = 0; kind < KIND_COUNT; ++kind) {
+		if (kinds[kind].count == 0)
+			continue;
+		out << std::format(
+			"  {:<14}{:>12} objects{:>14} bytes{:>7.1f}%\n", KIND_NAMES[kind],
+			kinds[kind].count, kinds[kind].bytes, percent(kinds[kind].bytes)
+		);
+	}
+
+	out << std::format(
+		"  {:>14}{:>8}{:>12}  {:<14}{:>6}  {}\n", "bytes", "bytes", "objects",
+		"kind", "line", "function"
+	);
+	for (std::size_t i = 0; i < rows.size() && i < TOP_COUNT; ++i) {
+		auto &row = rows[i];
+		out << std::format(
+			"  {:>14}{:>7.1f}%{:>12}  {:<14}{:>6}  {}\n", row.totals.bytes,
+			percent(row.totals.bytes), row.totals.count, KIND_NAMES[row.kind],
+			row.line, function_name(row.function)
+		);
+	}
+	if (rows.size() > TOP_COUNT)
+		out << std::format("  {} more sites\n", rows.size() - TOP_COUNT);
+}
@@ -0,0 +1,155 @@
+#ifndef ALLOCATION_PROFILER_HXX_INCLUDED
+#define ALLOCATION_PROFILER_HXX_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "stmt.hxx"
+
+// Attributes the objects created by an interpreter, and their bytes, to the
+// source line and the Lox function creating them, enabled with
+// --alloc-profile. Like the Profiler, the actors are not profiled.
+//
+// The interpreter records each environment, function, class, instance,
+// list, map, array, generator and string concatenated as it creates it,
+// with its size then: what it grows to later is not counted. Recording one
+// in N of them, at random intervals averaging N, makes it cheap enough for
+// long runs. Each one recorded then counts for N.
+class AllocationProfiler
+{
+public:
+	enum class Kind {
+		Environment,
+		Function,
+		Class,
+		Instance,
+		String,
+		List,
+		Map,
+		Float64Array,
+		Generator,
+		COUNT,
+	};
+
+	/// Records one in sample_interval_ allocations on average, all of them
+	/// if it is 1.
+	AllocationProfiler(unsigned sample_interval_ = 1);
+	AllocationProfiler(const AllocationProfiler &) = delete;
+	AllocationProfiler &operator=(const AllocationProfiler &) = delete;
+
+	/// Records an object of bytes created by the function being run, at the
+	/// line or at the line of the last call made if it is 0.
+	void record(Kind kind, std::size_t bytes, int line = 0)
+	{
+		if (--countdown != 0)
+			return;
+		countdown = next_countdown();
+		add(kind, bytes, line != 0 ? line : current_line);
+	}
+
+	/// A call is made at the line, the objects created by the natives and
+	/// classes called are counted there.
+	void at_line(int line) { current_line = line; }
+
+	/// Writes the sites creating the most bytes first, and the totals of
+	/// each kind of object.
+	void report(std::ostream &out) const;
+
+	// Makes the function the one creating the objects while in scope
+	class Scope
+	{
+	public:
+		Scope(AllocationProfiler *profiler_, const Function &function)
+			: profiler(profiler_)
+		{
+			if (profiler != nullptr)
+				profiler->enter(function);
+		}
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		~Scope()
+		{
+			if (profiler != nullptr)
+				profiler->leave();
+		}
+
+		/// The objects are now created by a tail call of the function.
+		void replace(const Function &function)
+		{
+			if (profiler != nullptr)
+				profiler->replace(function);
+		}
+
+	private:
+		AllocationProfiler *profiler;
+	};
+
+private:
+	static constexpr auto KIND_COUNT = static_cast<std::size_t>(Kind::COUNT);
+
+	struct FunctionInfo {
+		std::string name;
+		int line;
+		// Keeps the key alive so that it names this function only
+		std::shared_ptr<const void> body;
+	};
+
+	struct Totals {
+		std::uint64_t count = 0;
+		std::uint64_t bytes = 0;
+	};
+
+	struct Frame {
+		unsigned function;
+		// Line of the caller, restored when leaving
+		int caller_line;
+	};
+
+	void enter(const Function &function)
+	{
+		frames.push_back({function_id(function), current_line});
+		current_line = function.name.line;
+	}
+
+	void leave()
+	{
+		current_line = frames.back().caller_line;
+		frames.pop_back();
+	}
+
+	void replace(const Function &function)
+	{
+		frames.back().function = function_id(function);
+		current_line = function.name.line;
+	}
+
+	// Identifies the function by its body, shared by all of its closures
+	unsigned function_id(const Function &function);
+	void add(Kind kind, std::size_t bytes, int line);
+	// Allocations until the next one recorded
+	std::uint64_t next_countdown();
+	// Name and line of the function, they may be declared more than once
+	std::string function_name(unsigned id) const;
+
+	std::vector<FunctionInfo> functions;
+	std::unordered_map<const void *, unsigned> function_ids;
+	// Objects created by each function on each line, keyed by both
+	std::unordered_map<std::uint64_t, std::array<Totals, KIND_COUNT>> sites;
+
+	std::vector<Frame> frames;
+	int current_line = 0;
+
+	unsigned sample_interval;
+	std::uint64_t countdown = 1;
+	std::uint64_t random_state = 0x9e3779b97f4a7c15;
+};
+
+#endif
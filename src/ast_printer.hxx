@@ -1,6 +1,7 @@
 #ifndef AST_PRINTER_HXX_INCLUDED
 #define AST_PRINTER_HXX_INCLUDED
 
+#include <cstddef>
 #include <initializer_list>
 #include <string>
 #include <variant>
@@ -78,6 +79,56 @@ struct AstPrinter : public ExprVisitor {
 		});
 	}
 
+	Object visit_list_literal_expr(const ListLiteral &expr) override
+	{
+		std::string elements;
+		for (auto &element : expr.elements)
+			elements += print(*element) + " ";
+		// Remove trailing space
+		elements = elements.substr(0, elements.size() - 1);
+
+		return parenthesize({"list", elements});
+	}
+
+	Object visit_map_literal_expr(const MapLiteral &expr) override
+	{
+		std::string entries;
+		for (std::size_t i = 0; i < expr.keys.size(); ++i) {
+			entries += print(*expr.keys[i]) + ": ";
+			entries += print(*expr.values[i]) + " ";
+		}
+		// Remove trailing space
+		entries = entries.substr(0, entries.size() - 1);
+
+		return parenthesize({"map", entries});
+	}
+
+	Object visit_subscript_expr(const Subscript &expr) override
+	{
+		return parenthesize({
+			"[]",
+			print(*expr.object),
+			print(*expr.index),
+		});
+	}
+
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override
+	{
+		return parenthesize({
+			"[]=",
+			print(*expr.object),
+			print(*expr.index),
+			print(*expr.value),
+		});
+	}
+
+	Object visit_yield_expr(const Yield &expr) override
+	{
+		if (expr.value == nullptr)
+			return "(yield)";
+		return parenthesize({"yield", print(*expr.value)});
+	}
+
 	Object visit_this_expr(const This &) override { return "this"; }
 
 	Object visit_super_expr(const Super &expr) override
@@ -120,6 +171,27 @@ struct AstPrinter : public ExprVisitor {
 		});
 	}
 
+	Object visit_inline_call_expr(const InlineCall &expr) override
+	{
+		return parenthesize({
+			"inline",
+			print(*expr.call),
+			print(*expr.body),
+		});
+	}
+
+	Object visit_inline_param_expr(const InlineParam &expr) override
+	{
+		return "param " + std::string(expr.name.lexeme);
+	}
+
+	Object visit_numeric_expr(const Numeric &) override { return "numeric"; }
+
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return "numeric-condition";
+	}
+
 private:
 	static std::string parenthesize(std::initializer_list<std::string> li)
 	{
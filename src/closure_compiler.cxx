@@ -0,0 +1,697 @@
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "runtime_error.hxx"
+#include "token_type.hxx"
+#include "token.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "numeric.hxx"
+#include "environment.hxx"
+#include "closure_compiler.hxx"
+#include "interpreter.hxx"
+#include "output.hxx"
+#include "value_stack.hxx"
+#include "object/object.hxx"
+#include "object/lox_callable.hxx"
+#include "object/lox_function.hxx"
+#include "object/lox_instance.hxx"
+#include "object/lox_list.hxx"
+#include "object/lox_map.hxx"
+
+using enum TokenType;
+using std::get;
+
+// Helper methods
+//---------------------------------------------------------
+
+template <typename Op>
+CompiledExpr ClosureCompiler::number_operation(
+	CompiledExpr left, CompiledExpr right, const Token &operat
+)
+{
+	return [left, right, operat]() -> Object {
+		auto left_value = left();
+		auto right_value = right();
+		if (match_types<double, double>(left_value, right_value))
+			return Op{}(get<double>(left_value), get<double>(right_value));
+		return Interpreter::binary_operation(operat, left_value, right_value);
+	};
+}
+
+CompiledExpr ClosureCompiler::compile_look_up(const Expr &expr, const Token &name)
+{
+	auto result = interpreter.locals.find(&expr);
+
+	if (result == interpreter.locals.end()) {
+		return [&interpreter = interpreter, &name] {
+			interpreter.count(&ExecutionStats::global_lookups);
+			return interpreter.globals->get(name);
+		};
+	}
+
+	return [&interpreter = interpreter, &name = name.lexeme,
+			distance = result->second] {
+		interpreter.count(&ExecutionStats::local_lookups);
+		return interpreter.environment->get_at(distance, name);
+	};
+}
+
+// ClosureCompiler interface methods
+//---------------------------------------------------------
+
+std::vector<CompiledStmt>
+ClosureCompiler::compile(const std::vector<StmtPtr> &statements)
+{
+	return compile_all(statements);
+}
+
+const std::vector<CompiledStmt> &
+ClosureCompiler::compile_body(const Function &function)
+{
+	auto &body = bodies[function.body.get()];
+	if (body.source.expired()) {
+		body.source = function.body;
+		body.code = compile_all(*function.body);
+	}
+
+	return body.code;
+}
+
+CompiledExpr ClosureCompiler::compile(const Expr &expr)
+{
+	expr.accept(*this);
+	return std::move(compiled_expr);
+}
+
+CompiledStmt ClosureCompiler::compile(const Stmt &stmt)
+{
+	stmt.accept(*this);
+	return std::move(compiled_stmt);
+}
+
+std::vector<CompiledStmt>
+ClosureCompiler::compile_all(const std::vector<StmtPtr> &statements)
+{
+	std::vector<CompiledStmt> result;
+	result.reserve(statements.size());
+	for (auto &stmt : statements)
+		result.push_back(compile(*stmt));
+	return result;
+}
+
+CompiledExpr ClosureCompiler::evaluated(const Expr &expr)
+{
+	return [&interpreter = interpreter, &expr] {
+		return interpreter.evaluate(expr);
+	};
+}
+
+CompiledStmt ClosureCompiler::executed(const Stmt &stmt)
+{
+	return [&interpreter = interpreter, &stmt] { interpreter.execute(stmt); };
+}
+
+CompiledStmt ClosureCompiler::compile_counted_loop(const While &stmt)
+{
+	auto &loop = *stmt.counted;
+	auto limit = compile(*loop.limit);
+	auto body = compile(*stmt.body);
+
+	// Like Interpreter::execute_counted_loop
+	return [&interpreter = interpreter, &loop, &stmt, limit, body] {
+		auto &variable =
+			interpreter.environment->at(loop.distance, loop.name.lexeme);
+		if (!match_types<double>(variable)) {
+			interpreter.execute_loop(stmt);
+			return;
+		}
+
+		double counter = get<double>(variable);
+		auto compare = [&](double limit_value) {
+			switch (loop.comparison.type) {
+			case LESS:
+				return counter < limit_value;
+			case LESS_EQUAL:
+				return counter <= limit_value;
+			case GREATER:
+				return counter > limit_value;
+			default:
+				return counter >= limit_value;
+			}
+		};
+
+		while (true) {
+			// The limit may read it as well
+			if (loop.observed)
+				variable = counter;
+
+			auto limit_value = limit();
+			if (!match_types<double>(limit_value)) {
+				throw RuntimeError(
+					loop.comparison,
+					"Operands must be two strings or two numbers."
+				);
+			}
+			if (!compare(get<double>(limit_value)))
+				break;
+
+			try {
+				body();
+			} catch (Interpreter::ControlBreak) {
+				break;
+			} catch (Interpreter::ControlContinue) {
+			}
+
+			counter += loop.step;
+		}
+
+		variable = counter;
+	};
+}
+
+// Statement visitor methods
+//-----------------------------------------------
+
+void ClosureCompiler::visit_block_stmt(const Block &stmt)
+{
+	auto statements = compile_all(stmt.statements);
+
+	if (!stmt.needs_environment) {
+		compiled_stmt = [statements] {
+			for (auto &statement : statements)
+				statement();
+		};
+		return;
+	}
+
+	compiled_stmt = [&interpreter = interpreter, statements, line = stmt.line] {
+		interpreter.count(&ExecutionStats::environments);
+		interpreter.count_allocation(
+			Interpreter::Allocation::Environment, sizeof(Environment), line
+		);
+		interpreter.execute_block(
+			statements, std::make_shared<Environment>(interpreter.environment)
+		);
+	};
+}
+
+void ClosureCompiler::visit_expr_stmt(const Expression &stmt)
+{
+	compiled_stmt = [expression = compile(*stmt.expression)] { expression(); };
+}
+
+void ClosureCompiler::visit_print_stmt(const Print &stmt)
+{
+	compiled_stmt = [&output = interpreter.output,
+					 expression = compile(*stmt.expression)] {
+		output.write_value(expression());
+		output.write('\n');
+	};
+}
+
+void ClosureCompiler::visit_assert_stmt(const Assert &stmt)
+{
+	compiled_stmt = [&stmt, expression = compile(*stmt.expression)] {
+		if (!is_truthy(expression()))
+			throw RuntimeError(stmt.token, "Assertion failed.");
+	};
+}
+
+void ClosureCompiler::visit_break_stmt(const Break &)
+{
+	compiled_stmt = [&interpreter = interpreter] {
+		interpreter.count(&ExecutionStats::breaks);
+		throw Interpreter::ControlBreak();
+	};
+}
+
+void ClosureCompiler::visit_continue_stmt(const Continue &)
+{
+	compiled_stmt = [&interpreter = interpreter] {
+		interpreter.count(&ExecutionStats::continues);
+		throw Interpreter::ControlContinue();
+	};
+}
+
+void ClosureCompiler::visit_return_stmt(const Return &stmt)
+{
+	if (stmt.value == nullptr) {
+		compiled_stmt = [&interpreter = interpreter] {
+			interpreter.count(&ExecutionStats::returns);
+			throw Interpreter::ControlReturn(nullptr);
+		};
+		return;
+	}
+
+	auto call = dynamic_cast<const Call *>(stmt.value.get());
+	if (!stmt.tail_call || call == nullptr) {
+		compiled_stmt = [&interpreter = interpreter,
+						 value = compile(*stmt.value)] {
+			auto result = value();
+			interpreter.count(&ExecutionStats::returns);
+			throw Interpreter::ControlReturn(std::move(result));
+		};
+		return;
+	}
+
+	// Like Interpreter::tail_call
+	auto callee = compile(*call->callee);
+	std::vector<CompiledExpr> arguments;
+	for (auto &arg : call->arguments)
+		arguments.push_back(compile(*arg));
+
+	compiled_stmt = [&interpreter = interpreter, call, callee, arguments] {
+		ValueStack::Frame frame(interpreter.value_stack, arguments.size() + 1);
+		auto &callee_value = frame.values()[0];
+		callee_value = callee();
+		auto values = frame.values().subspan(1);
+		for (std::size_t i = 0; i < values.size(); ++i)
+			values[i] = arguments[i]();
+
+		auto function = Interpreter::check_call(callee_value, call->paren, values);
+		interpreter.count_call_line(call->paren.line);
+		if (function->kind != LoxCallable::Kind::Function) {
+			auto result = function->call(interpreter, values);
+			interpreter.count(&ExecutionStats::returns);
+			throw Interpreter::ControlReturn(std::move(result));
+		}
+
+		interpreter.count(&ExecutionStats::tail_calls);
+		interpreter.value_stack.hold_tail_call(std::move(function), values);
+		throw Interpreter::ControlTailCall();
+	};
+}
+
+void ClosureCompiler::visit_if_stmt(const If &stmt)
+{
+	auto condition = compile(*stmt.condition);
+	auto then_branch = compile(*stmt.then_branch);
+
+	if (stmt.else_branch == nullptr) {
+		compiled_stmt = [condition, then_branch] {
+			if (is_truthy(condition()))
+				then_branch();
+		};
+		return;
+	}
+
+	compiled_stmt = [condition, then_branch,
+					 else_branch = compile(*stmt.else_branch)] {
+		if (is_truthy(condition()))
+			then_branch();
+		else
+			else_branch();
+	};
+}
+
+void ClosureCompiler::visit_while_stmt(const While &stmt)
+{
+	if (stmt.counted && stmt.counted->enabled) {
+		compiled_stmt = compile_counted_loop(stmt);
+		return;
+	}
+
+	auto condition = compile(*stmt.condition);
+	auto body = compile(*stmt.body);
+	CompiledExpr update = nullptr;
+	if (stmt.for_update)
+		update = compile(*stmt.for_update);
+
+	compiled_stmt = [condition, body, update] {
+		while (is_truthy(condition())) {
+			try {
+				body();
+			} catch (Interpreter::ControlBreak) {
+				break;
+			} catch (Interpreter::ControlContinue) {
+			}
+
+			if (update)
+				update();
+		}
+	};
+}
+
+void ClosureCompiler::visit_var_stmt(const Var &stmt)
+{
+	compiled_stmt = [&interpreter = interpreter, &name = stmt.name.lexeme,
+					 initializer = compile(*stmt.initializer)] {
+		interpreter.environment->define(name, initializer());
+	};
+}
+
+void ClosureCompiler::visit_function_stmt(const Function &stmt)
+{
+	compiled_stmt = executed(stmt);
+}
+
+void ClosureCompiler::visit_class_stmt(const Class &stmt)
+{
+	compiled_stmt = executed(stmt);
+}
+
+// Expression visitor methods
+//-----------------------------------------------
+
+Object ClosureCompiler::visit_assign_expr(const Assign &expr)
+{
+	auto value = compile(*expr.expression);
+	auto result = interpreter.locals.find(&expr);
+
+	if (result == interpreter.locals.end()) {
+		compiled_expr = [&interpreter = interpreter, &name = expr.name, value] {
+			auto result_value = value();
+			interpreter.globals->assign(name, result_value);
+			return result_value;
+		};
+		return nullptr;
+	}
+
+	compiled_expr = [&interpreter = interpreter, &name = expr.name,
+					 distance = result->second, value] {
+		auto result_value = value();
+		interpreter.environment->assign_at(distance, name, result_value);
+		return result_value;
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_ternary_expr(const Ternary &expr)
+{
+	compiled_expr = [condition = compile(*expr.condition),
+					 true_expr = compile(*expr.true_expr),
+					 false_expr = compile(*expr.false_expr)] {
+		return is_truthy(condition()) ? true_expr() : false_expr();
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_logical_expr(const Logical &expr)
+{
+	auto left = compile(*expr.left);
+	auto right = compile(*expr.right);
+
+	if (expr.operat.type == OR) {
+		compiled_expr = [left, right] {
+			auto left_value = left();
+			return is_truthy(left_value) ? left_value : right();
+		};
+	} else {
+		compiled_expr = [left, right] {
+			auto left_value = left();
+			return !is_truthy(left_value) ? left_value : right();
+		};
+	}
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_binary_expr(const Binary &expr)
+{
+	auto left = compile(*expr.left);
+	auto right = compile(*expr.right);
+	auto &operat = expr.operat;
+
+	switch (operat.type) {
+	case PLUS:
+		compiled_expr = number_operation<std::plus<double>>(left, right, operat);
+		break;
+	case MINUS:
+		compiled_expr = number_operation<std::minus<double>>(left, right, operat);
+		break;
+	case STAR:
+		compiled_expr =
+			number_operation<std::multiplies<double>>(left, right, operat);
+		break;
+	case SLASH:
+		compiled_expr =
+			number_operation<std::divides<double>>(left, right, operat);
+		break;
+	case GREATER:
+		compiled_expr =
+			number_operation<std::greater<double>>(left, right, operat);
+		break;
+	case GREATER_EQUAL:
+		compiled_expr =
+			number_operation<std::greater_equal<double>>(left, right, operat);
+		break;
+	case LESS:
+		compiled_expr = number_operation<std::less<double>>(left, right, operat);
+		break;
+	case LESS_EQUAL:
+		compiled_expr =
+			number_operation<std::less_equal<double>>(left, right, operat);
+		break;
+	case EQUAL_EQUAL:
+		compiled_expr = [left, right] {
+			auto left_value = left();
+			return Object(left_value == right());
+		};
+		break;
+	case BANG_EQUAL:
+		compiled_expr = [left, right] {
+			auto left_value = left();
+			return Object(left_value != right());
+		};
+		break;
+
+	default:
+		compiled_expr = evaluated(expr);
+		break;
+	}
+
+	// Only checked for the strings concatenated if they are profiled
+	if (operat.type == PLUS && interpreter.allocation_profiler() != nullptr) {
+		compiled_expr = [&interpreter = interpreter, &operat,
+						 add = std::move(compiled_expr)] {
+			auto result = add();
+			if (match_types<std::string>(result)) {
+				interpreter.count_allocation(
+					Interpreter::Allocation::String,
+					get<std::string>(result).size() + 1, operat.line
+				);
+			}
+			return result;
+		};
+	}
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_call_expr(const Call &expr)
+{
+	auto callee = compile(*expr.callee);
+	std::vector<CompiledExpr> arguments;
+	for (auto &arg : expr.arguments)
+		arguments.push_back(compile(*arg));
+
+	compiled_expr = [&interpreter = interpreter, &paren = expr.paren, callee,
+					 arguments] {
+		// Like Interpreter::call
+		ValueStack::Frame frame(interpreter.value_stack, arguments.size() + 1);
+		auto &callee_value = frame.values()[0];
+		callee_value = callee();
+		auto values = frame.values().subspan(1);
+		for (std::size_t i = 0; i < values.size(); ++i)
+			values[i] = arguments[i]();
+
+		auto function = Interpreter::check_call(callee_value, paren, values);
+		interpreter.count_call_line(paren.line);
+		return function->call(interpreter, values);
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_get_expr(const Get &expr)
+{
+	compiled_expr = [&interpreter = interpreter, &name = expr.name,
+					 object = compile(*expr.object)] {
+		auto object_value = object();
+		auto property = Interpreter::get_property(object_value, name);
+		if (interpreter.allocation_profiler() != nullptr)
+			interpreter.count_binding(object_value, name);
+		return property;
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_set_expr(const Set &expr)
+{
+	compiled_expr = [&name = expr.name, object = compile(*expr.object),
+					 value = compile(*expr.value)] {
+		auto object_value = object();
+		if (!match_types<LoxInstancePtr>(object_value))
+			throw RuntimeError(name, "Only instances have fields.");
+
+		auto result = value();
+		get<LoxInstancePtr>(object_value)->set(name, result);
+		return result;
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_list_literal_expr(const ListLiteral &expr)
+{
+	std::vector<CompiledExpr> elements;
+	for (auto &element : expr.elements)
+		elements.push_back(compile(*element));
+
+	compiled_expr = [&interpreter = interpreter, &bracket = expr.bracket,
+					 elements = std::move(elements)] {
+		// Like Interpreter::visit_list_literal_expr
+		ValueStack::Frame frame(interpreter.value_stack, 1);
+		auto list = std::make_shared<LoxList>();
+		frame.values()[0] = list;
+		auto &values = list->elements;
+		values.reserve(elements.size());
+		for (auto &element : elements)
+			values.push_back(element());
+		interpreter.count_allocation(
+			Interpreter::Allocation::List,
+			sizeof(LoxList) + values.capacity() * sizeof(Object), bracket.line
+		);
+		return Object(std::move(list));
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_map_literal_expr(const MapLiteral &expr)
+{
+	std::vector<std::pair<CompiledExpr, CompiledExpr>> entries;
+	for (std::size_t i = 0; i < expr.keys.size(); ++i)
+		entries.emplace_back(compile(*expr.keys[i]), compile(*expr.values[i]));
+
+	compiled_expr = [&interpreter = interpreter, &brace = expr.brace,
+					 entries = std::move(entries)] {
+		interpreter.count_allocation(
+			Interpreter::Allocation::Map,
+			sizeof(LoxMap) + entries.size() * 2 * sizeof(Object), brace.line
+		);
+		// Like Interpreter::visit_map_literal_expr
+		ValueStack::Frame frame(interpreter.value_stack, 2);
+		auto map = std::make_shared<LoxMap>();
+		frame.values()[0] = map;
+		auto &key_value = frame.values()[1];
+		for (auto &[key, value] : entries) {
+			key_value = key();
+			map->set(key_value, value());
+		}
+		return Object(std::move(map));
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_subscript_expr(const Subscript &expr)
+{
+	compiled_expr = [&bracket = expr.bracket, object = compile(*expr.object),
+					 index = compile(*expr.index)] {
+		auto object_value = object();
+		return Interpreter::subscript(object_value, index(), bracket);
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_subscript_set_expr(const SubscriptSet &expr)
+{
+	compiled_expr = [&bracket = expr.bracket, object = compile(*expr.object),
+					 index = compile(*expr.index), value = compile(*expr.value)] {
+		auto object_value = object();
+		auto index_value = index();
+		auto result = value();
+		Interpreter::subscript_set(object_value, index_value, result, bracket);
+		return result;
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_super_expr(const Super &expr)
+{
+	compiled_expr = evaluated(expr);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_this_expr(const This &expr)
+{
+	compiled_expr = compile_look_up(expr, expr.keyword);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_grouping_expr(const Grouping &expr)
+{
+	compiled_expr = compile(*expr.expression);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_literal_expr(const Literal &expr)
+{
+	compiled_expr = [value = expr.value] { return value; };
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_unary_expr(const Unary &expr)
+{
+	auto right = compile(*expr.right);
+	auto &operat = expr.operat;
+
+	if (operat.type == MINUS) {
+		compiled_expr = [right, operat]() -> Object {
+			auto right_value = right();
+			if (match_types<double>(right_value))
+				return -get<double>(right_value);
+			return Interpreter::unary_operation(operat, right_value);
+		};
+	} else if (operat.type == BANG) {
+		compiled_expr = [right] { return Object(!is_truthy(right())); };
+	} else {
+		compiled_expr = [right, operat] {
+			return Interpreter::unary_operation(operat, right());
+		};
+	}
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_variable_expr(const Variable &expr)
+{
+	compiled_expr = compile_look_up(expr, expr.name);
+	return nullptr;
+}
+
+// Generator bodies are run by LoxGenerator, on the tree engine.
+Object ClosureCompiler::visit_yield_expr(const Yield &expr)
+{
+	compiled_expr = evaluated(expr);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_inline_call_expr(const InlineCall &expr)
+{
+	compiled_expr = evaluated(expr);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_inline_param_expr(const InlineParam &expr)
+{
+	compiled_expr = evaluated(expr);
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_numeric_expr(const Numeric &expr)
+{
+	compiled_expr = [&interpreter = interpreter, &expr] {
+		return Object(expr.expression->evaluate(*interpreter.environment));
+	};
+	return nullptr;
+}
+
+Object ClosureCompiler::visit_numeric_condition_expr(
+	const NumericCondition &expr
+)
+{
+	compiled_expr = [&interpreter = interpreter, &expr] {
+		return Object(expr.condition->evaluate(*interpreter.environment));
+	};
+	return nullptr;
+}
@@ -0,0 +1,111 @@
+#ifndef CLOSURE_COMPILER_HXX_INCLUDED
+#define CLOSURE_COMPILER_HXX_INCLUDED
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <vector>
+
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "object/object.hxx"
+
+class Interpreter;
+
+using CompiledExpr = std::function<Object()>;
+using CompiledStmt = std::function<void()>;
+
+// Compiles the resolved AST into a tree of C++ closures, run by the
+// Interpreter when selected with --engine=closure.
+//
+// Each node becomes a closure with its operands, variable distance and
+// operator already picked, so running it needs neither the visitor's double
+// dispatch, nor the switch on the operator, nor the lookup in the locals
+// side table. Rare nodes are compiled to a closure calling the Interpreter.
+class ClosureCompiler : private StmtVisitor, private ExprVisitor
+{
+public:
+	ClosureCompiler(Interpreter &interpreter_)
+		: interpreter(interpreter_)
+	{
+	}
+
+	/// Compiles a program, the top-level statements.
+	std::vector<CompiledStmt> compile(const std::vector<StmtPtr> &statements);
+
+	/// Returns the compiled body of a function, compiled on its first call.
+	const std::vector<CompiledStmt> &compile_body(const Function &function);
+
+	void visit_block_stmt(const Block &stmt) override;
+	void visit_expr_stmt(const Expression &stmt) override;
+	void visit_print_stmt(const Print &stmt) override;
+	void visit_assert_stmt(const Assert &stmt) override;
+	void visit_break_stmt(const Break &stmt) override;
+	void visit_continue_stmt(const Continue &stmt) override;
+	void visit_return_stmt(const Return &stmt) override;
+	void visit_if_stmt(const If &stmt) override;
+	void visit_while_stmt(const While &stmt) override;
+	void visit_var_stmt(const Var &stmt) override;
+	void visit_function_stmt(const Function &stmt) override;
+	void visit_class_stmt(const Class &stmt) override;
+
+	Object visit_assign_expr(const Assign &expr) override;
+	Object visit_ternary_expr(const Ternary &expr) override;
+	Object visit_logical_expr(const Logical &expr) override;
+	Object visit_binary_expr(const Binary &expr) override;
+	Object visit_call_expr(const Call &expr) override;
+	Object visit_get_expr(const Get &expr) override;
+	Object visit_set_expr(const Set &expr) override;
+	Object visit_super_expr(const Super &expr) override;
+	Object visit_this_expr(const This &expr) override;
+	Object visit_grouping_expr(const Grouping &expr) override;
+	Object visit_literal_expr(const Literal &expr) override;
+	Object visit_unary_expr(const Unary &expr) override;
+	Object visit_variable_expr(const Variable &expr) override;
+	Object visit_list_literal_expr(const ListLiteral &expr) override;
+	Object visit_map_literal_expr(const MapLiteral &expr) override;
+	Object visit_subscript_expr(const Subscript &expr) override;
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override;
+	Object visit_yield_expr(const Yield &expr) override;
+	Object visit_inline_call_expr(const InlineCall &expr) override;
+	Object visit_inline_param_expr(const InlineParam &expr) override;
+	Object visit_numeric_expr(const Numeric &expr) override;
+	Object visit_numeric_condition_expr(const NumericCondition &expr) override;
+
+private:
+	CompiledExpr compile(const Expr &expr);
+	CompiledStmt compile(const Stmt &stmt);
+	std::vector<CompiledStmt> compile_all(const std::vector<StmtPtr> &statements);
+
+	// For the nodes left to the Interpreter
+	CompiledExpr evaluated(const Expr &expr);
+	CompiledStmt executed(const Stmt &stmt);
+
+	CompiledStmt compile_counted_loop(const While &stmt);
+	// Reads a variable, 'this' included
+	CompiledExpr compile_look_up(const Expr &expr, const Token &name);
+
+	// Closure for a binary operator, computing the result right away if both
+	// operands are numbers and leaving the rest to the Interpreter.
+	// Op is one of the function objects like std::plus<double>.
+	template <typename Op>
+	static CompiledExpr number_operation(
+		CompiledExpr left, CompiledExpr right, const Token &operat
+	);
+
+	Interpreter &interpreter;
+
+	// Set by the visitor methods to the closure for the node visited
+	CompiledExpr compiled_expr;
+	CompiledStmt compiled_stmt;
+
+	// Compiled function bodies. The body they were compiled from is only
+	// weakly held, as an address may be reused after the body is freed.
+	struct CompiledBody {
+		std::weak_ptr<const std::vector<StmtPtr>> source;
+		std::vector<CompiledStmt> code;
+	};
+	std::map<const std::vector<StmtPtr> *, CompiledBody> bodies;
+};
+
+#endif
@@ -6,6 +6,7 @@
 #include <map>
 #include <memory>
 #include <string>
+#include <utility>
 
 #include "runtime_error.hxx"
 #include "token.hxx"
@@ -17,6 +18,7 @@ using EnvironmentPtr = std::shared_ptr<Environment>;
 class Environment
 {
 	friend class GarbageCollector; // values
+	friend class ValueCopier;      // values
 
 public:
 	Environment(EnvironmentPtr encolsing_env = nullptr)
@@ -24,9 +26,9 @@ public:
 	{
 	}
 
-	void define(const std::string &name, const Object &value)
+	void define(const std::string &name, Object value)
 	{
-		values[name] = value;
+		values[name] = std::move(value);
 	}
 
 	void assign(const Token &name, const Object &value)
@@ -61,6 +63,13 @@ public:
 		);
 	}
 
+	// Returns the object stored in this scope, or nullptr if there is none.
+	Object *find(const std::string &name)
+	{
+		auto result = values.find(name);
+		return result != values.end() ? &result->second : nullptr;
+	}
+
 	// Returns the object stored in the distance number of enclosing scopes away.
 	// The variable being accesed must exist in the scope,
 	// so only access using the data from the side-table generated by Resolver
@@ -69,6 +78,12 @@ public:
 		return ancestor(*this, distance).values.at(name);
 	}
 
+	// Same as get_at, but returns a reference to the object stored.
+	Object &at(int distance, const std::string &name)
+	{
+		return ancestor(*this, distance).values.at(name);
+	}
+
 	// Assigns the object stored in the distance number of enclosing scopes away.
 	// The variable being assigned must exist in the scope,
 	// so only access using the data from the side-table generated by Resolver
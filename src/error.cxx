@@ -1,3 +1,40 @@
-bool lox_had_error = false;
-bool lox_had_runtime_error = false;
+#include <format>
+#include <string_view>
 
+#include "error.hxx"
+#include "token.hxx"
+#include "token_type.hxx"
+#include "runtime_error.hxx"
+
+void ErrorReporter::print_error(
+	int line, std::string_view message, std::string_view where
+)
+{
+	had_error = true;
+
+	output.write(std::format("[line {}] Error {}: {}\n", line, where, message));
+	output.flush();
+}
+
+void ErrorReporter::print_error(const Token &token, std::string_view message)
+{
+	if (token.type == TokenType::END_OF_FILE) {
+		print_error(token.line, message, "at end");
+	} else {
+		print_error(token.line, message, std::format("at '{}'", token.lexeme));
+	}
+}
+
+void ErrorReporter::print_runtime_error(const RuntimeError &err)
+{
+	output.write(std::format("{}\n[line {}]\n", err.what(), err.token.line));
+	output.flush();
+	had_runtime_error = true;
+}
+
+void ErrorReporter::print_nativefn_error(const NativeFnError &err)
+{
+	output.write(std::format("Error in native function: {}\n", err.what()));
+	output.flush();
+	had_runtime_error = true;
+}
@@ -0,0 +1,81 @@
+#include <algorithm>
+#include <chrono>
+#include <functional>
+#include <thread>
+#include <utility>
+#include <variant>
+
+#include "event_loop.hxx"
+#include "actor.hxx"
+#include "interpreter.hxx"
+#include "runtime_error.hxx"
+#include "object/object.hxx"
+#include "object/lox_generator.hxx"
+
+void EventLoop::run(Interpreter &interpreter)
+{
+	if (running)
+		throw NativeFnError("Tasks are already being run.");
+	running = true;
+
+	try {
+		while (!empty()) {
+			// Nothing to do until the first sleeper wakes
+			auto wait = ready.empty() ? timers.front().deadline - Clock::now()
+									  : Clock::duration::zero();
+			if (wait > Clock::duration::zero()) {
+				// Actors leave the thread to the others meanwhile
+				auto time = std::chrono::ceil<std::chrono::milliseconds>(wait);
+				if (auto actor = interpreter.running_actor())
+					interpreter.actor_scheduler().sleep(*actor, time);
+				else
+					std::this_thread::sleep_for(wait);
+			}
+
+			auto now = Clock::now();
+			while (!timers.empty() && timers.front().deadline <= now) {
+				std::pop_heap(timers.begin(), timers.end(), std::greater<>());
+				ready.push_back(std::move(timers.back().task));
+				timers.pop_back();
+			}
+
+			// The tasks put back by this turn run on the next one
+			for (auto count = ready.size(); count > 0; --count) {
+				auto task = std::move(ready.front());
+				ready.pop_front();
+				step(interpreter, std::move(task));
+			}
+		}
+	} catch (...) {
+		ready.clear();
+		timers.clear();
+		running = false;
+		throw;
+	}
+
+	running = false;
+}
+
+void EventLoop::step(Interpreter &interpreter, LoxGeneratorPtr task)
+{
+	auto value = task->resume(interpreter, nullptr);
+	if (task->done())
+		return;
+
+	if (match_types<std::nullptr_t>(value)) {
+		ready.push_back(std::move(task));
+		return;
+	}
+
+	if (!match_types<double>(value) || std::get<double>(value) < 0) {
+		throw NativeFnError(
+			"A task can only yield nil or a non-negative number of seconds."
+		);
+	}
+
+	std::chrono::duration<double> seconds(std::get<double>(value));
+	auto deadline =
+		Clock::now() + std::chrono::duration_cast<Clock::duration>(seconds);
+	timers.push_back({deadline, timers_added++, std::move(task)});
+	std::push_heap(timers.begin(), timers.end(), std::greater<>());
+}
@@ -0,0 +1,68 @@
+#ifndef EVENT_LOOP_HXX_INCLUDED
+#define EVENT_LOOP_HXX_INCLUDED
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <vector>
+
+#include "object/object.hxx"
+
+// Runs generators as tasks taking turns in one thread, each interpreter has
+// its own. A task yields nil to let the others run, or a number of seconds
+// to sleep for. Sleeping tasks wait in a heap ordered by their wake-up time,
+// so any number of them cost nothing more than their memory.
+//
+// The tasks added by task() are run by run_tasks(), and at the end of
+// the program by Interpreter::interpret.
+class EventLoop
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	/// Adds a task, to be started on the next turn.
+	void add(LoxGeneratorPtr task) { ready.push_back(std::move(task)); }
+
+	/// Runs the tasks until all of them are done. If one fails the error is
+	/// thrown and the rest are dropped.
+	void run(Interpreter &interpreter);
+
+	bool empty() const { return ready.empty() && timers.empty(); }
+
+	/// Calls function with each task waiting, for the GarbageCollector.
+	template <typename Function>
+	void for_each_task(Function function) const
+	{
+		for (auto &task : ready)
+			function(*task);
+		for (auto &timer : timers)
+			function(*timer.task);
+	}
+
+private:
+	struct Timer {
+		Clock::time_point deadline;
+		// Tasks with the same deadline wake in the order they slept
+		std::uint64_t order;
+		LoxGeneratorPtr task;
+
+		bool operator>(const Timer &other) const
+		{
+			if (deadline != other.deadline)
+				return deadline > other.deadline;
+			return order > other.order;
+		}
+	};
+
+	// Runs a task until it yields and puts it back into the loop
+	void step(Interpreter &interpreter, LoxGeneratorPtr task);
+
+	std::deque<LoxGeneratorPtr> ready;
+	// Min-heap of the sleeping tasks
+	std::vector<Timer> timers;
+	std::uint64_t timers_added = 0;
+	bool running = false;
+};
+
+#endif
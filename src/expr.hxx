@@ -23,8 +23,20 @@ struct Grouping;
 struct Literal;
 struct Unary;
 struct Variable;
+struct ListLiteral;
+struct MapLiteral;
+struct Subscript;
+struct SubscriptSet;
+struct Yield;
+struct InlineCall;
+struct InlineParam;
+struct Numeric;
+struct NumericCondition;
 
 using ExprPtr = std::unique_ptr<Expr>;
+// For InlineCall
+struct Stmt;
+using StmtPtr = std::unique_ptr<Stmt>;
 
 struct ExprVisitor {
 	virtual Object visit_assign_expr(const Assign &expr) = 0;
@@ -40,6 +52,16 @@ struct ExprVisitor {
 	virtual Object visit_literal_expr(const Literal &expr) = 0;
 	virtual Object visit_unary_expr(const Unary &expr) = 0;
 	virtual Object visit_variable_expr(const Variable &expr) = 0;
+	virtual Object visit_list_literal_expr(const ListLiteral &expr) = 0;
+	virtual Object visit_map_literal_expr(const MapLiteral &expr) = 0;
+	virtual Object visit_subscript_expr(const Subscript &expr) = 0;
+	virtual Object visit_subscript_set_expr(const SubscriptSet &expr) = 0;
+	virtual Object visit_yield_expr(const Yield &expr) = 0;
+	virtual Object visit_inline_call_expr(const InlineCall &expr) = 0;
+	virtual Object visit_inline_param_expr(const InlineParam &expr) = 0;
+	virtual Object visit_numeric_expr(const Numeric &expr) = 0;
+	virtual Object
+	visit_numeric_condition_expr(const NumericCondition &expr) = 0;
 	virtual ~ExprVisitor() = default;
 };
 
@@ -77,9 +99,9 @@ struct Ternary : public Expr {
 		return visitor.visit_ternary_expr(*this);
 	}
 
-	const ExprPtr condition;
-	const ExprPtr true_expr;
-	const ExprPtr false_expr;
+	ExprPtr condition;
+	ExprPtr true_expr;
+	ExprPtr false_expr;
 };
 
 struct Logical : public Expr {
@@ -113,9 +135,9 @@ struct Binary : public Expr {
 		return visitor.visit_binary_expr(*this);
 	}
 
-	const ExprPtr left;
+	ExprPtr left;
 	const Token operat;
-	const ExprPtr right;
+	ExprPtr right;
 };
 
 struct Call : public Expr {
@@ -211,7 +233,7 @@ struct Grouping : public Expr {
 		return visitor.visit_grouping_expr(*this);
 	}
 
-	const ExprPtr expression;
+	ExprPtr expression;
 };
 
 struct Literal : public Expr {
@@ -241,7 +263,7 @@ struct Unary : public Expr {
 	}
 
 	const Token operat;
-	const ExprPtr right;
+	ExprPtr right;
 };
 
 struct Variable : public Expr {
@@ -258,4 +280,155 @@ struct Variable : public Expr {
 	Token name;
 };
 
+// List literal, like: [a, b, c]
+struct ListLiteral : public Expr {
+	ListLiteral(const Token &bracket_, std::vector<ExprPtr> elements_)
+		: bracket(bracket_)
+		, elements(std::move(elements_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_list_literal_expr(*this);
+	}
+
+	Token bracket;
+	std::vector<ExprPtr> elements;
+};
+
+// Map literal, like: {key: value, ...}
+// The nth key is paired with the nth value.
+struct MapLiteral : public Expr {
+	MapLiteral(
+		const Token &brace_, std::vector<ExprPtr> keys_,
+		std::vector<ExprPtr> values_
+	)
+		: brace(brace_)
+		, keys(std::move(keys_))
+		, values(std::move(values_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_map_literal_expr(*this);
+	}
+
+	Token brace;
+	std::vector<ExprPtr> keys;
+	std::vector<ExprPtr> values;
+};
+
+// Element of a list or map, like: object[index]
+struct Subscript : public Expr {
+	Subscript(ExprPtr object_, const Token &bracket_, ExprPtr index_)
+		: object(std::move(object_))
+		, bracket(bracket_)
+		, index(std::move(index_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_subscript_expr(*this);
+	}
+
+	ExprPtr object;
+	Token bracket;
+	ExprPtr index;
+};
+
+struct SubscriptSet : public Expr {
+	SubscriptSet(
+		ExprPtr object_, const Token &bracket_, ExprPtr index_, ExprPtr value_
+	)
+		: object(std::move(object_))
+		, bracket(bracket_)
+		, index(std::move(index_))
+		, value(std::move(value_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_subscript_set_expr(*this);
+	}
+
+	ExprPtr object;
+	Token bracket;
+	ExprPtr index;
+	ExprPtr value;
+};
+
+// Suspends the generator running the function, like: yield value
+// Only allowed as a statement, a variable's initializer or the value of an
+// assignment to a variable, where the value passed to send() is stored.
+// See LoxGenerator.
+struct Yield : public Expr {
+	Yield(const Token &keyword_, ExprPtr value_)
+		: keyword(keyword_)
+		, value(std::move(value_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_yield_expr(*this);
+	}
+
+	Token keyword;
+	// Null if it yields nil
+	ExprPtr value;
+};
+
+// Maximum number of parameters of an inlined function
+constexpr unsigned MAX_INLINE_PARAMS = 8;
+
+// A call of a small global function replaced by the function's return value
+// expression. Made by the Optimizer. If at runtime the global no longer refers
+// to the inlined function then the original call is evaluated instead.
+struct InlineCall : public Expr {
+	InlineCall(
+		std::unique_ptr<Call> call_,
+		std::shared_ptr<const std::vector<StmtPtr>> function_body_,
+		ExprPtr body_
+	)
+		: call(std::move(call_))
+		, function_body(std::move(function_body_))
+		, body(std::move(body_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_inline_call_expr(*this);
+	}
+
+	// The original call
+	std::unique_ptr<Call> call;
+	// Identifies the function inlined, also keeps it alive for the check.
+	std::shared_ptr<const std::vector<StmtPtr>> function_body;
+	// Return value expression, its parameters replaced by InlineParam
+	ExprPtr body;
+};
+
+// Parameter of an inlined function, refers to the argument at index of the
+// innermost InlineCall being evaluated.
+struct InlineParam : public Expr {
+	InlineParam(const Token &name_, unsigned index_)
+		: name(name_)
+		, index(index_)
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_inline_param_expr(*this);
+	}
+
+	Token name;
+	unsigned index;
+};
+
 #endif
@@ -0,0 +1,160 @@
+#include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <cstdint>
+#include <system_error>
+#include <utility>
+
+#include "fiber.hxx"
+
+#ifdef LOX_FIBERS_SUPPORTED
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(__SANITIZE_ADDRESS__)
+#define LOX_ASAN 1
+#elif defined(__has_feature)
+#if __has_feature(address_sanitizer)
+#define LOX_ASAN 1
+#endif
+#endif
+
+#if defined(__SANITIZE_THREAD__)
+#define LOX_TSAN 1
+#elif defined(__has_feature)
+#if __has_feature(thread_sanitizer)
+#define LOX_TSAN 1
+#endif
+#endif
+
+#ifdef LOX_ASAN
+#include <sanitizer/common_interface_defs.h>
+#endif
+#ifdef LOX_TSAN
+#include <sanitizer/tsan_interface.h>
+#endif
+
+// The sanitizers keep track of the stack in use, tell them about each switch.
+//---------------------------------------------------------
+
+[[maybe_unused]] static void
+start_switch(void **fake_stack, const void *bottom, std::size_t size)
+{
+#ifdef LOX_ASAN
+	__sanitizer_start_switch_fiber(fake_stack, bottom, size);
+#else
+	(void)fake_stack, (void)bottom, (void)size;
+#endif
+}
+
+[[maybe_unused]] static void
+finish_switch(void *fake_stack, const void **bottom, std::size_t *size)
+{
+#ifdef LOX_ASAN
+	__sanitizer_finish_switch_fiber(fake_stack, bottom, size);
+#else
+	(void)fake_stack, (void)bottom, (void)size;
+#endif
+}
+
+// Fiber methods
+//---------------------------------------------------------
+
+Fiber::Fiber(Body body_)
+	: body(std::move(body_))
+{
+	// The lowest page is left inaccessible to catch stack overflows
+	auto page_size = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+	stack = mmap(
+		nullptr, STACK_SIZE, PROT_READ | PROT_WRITE,
+		MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0
+	);
+	if (stack == MAP_FAILED)
+		throw std::system_error(errno, std::generic_category());
+	mprotect(stack, page_size, PROT_NONE);
+
+	getcontext(&context);
+	context.uc_stack.ss_sp = stack;
+	context.uc_stack.ss_size = STACK_SIZE;
+	context.uc_link = nullptr;
+
+	// makecontext only passes int arguments, split the pointer in two
+	auto address = reinterpret_cast<std::uintptr_t>(this);
+	makecontext(
+		&context, reinterpret_cast<void (*)()>(&Fiber::start), 2,
+		static_cast<unsigned>(address), static_cast<unsigned>(address >> 32)
+	);
+
+#ifdef LOX_TSAN
+	tsan_fiber = __tsan_create_fiber(0);
+#endif
+}
+
+Fiber::~Fiber()
+{
+#ifdef LOX_TSAN
+	__tsan_destroy_fiber(tsan_fiber);
+#endif
+	munmap(stack, STACK_SIZE);
+}
+
+void Fiber::resume()
+{
+	assert(!done);
+
+#ifdef LOX_TSAN
+	tsan_caller = __tsan_get_current_fiber();
+	__tsan_switch_to_fiber(tsan_fiber, 0);
+#endif
+	void *caller_fake_stack = nullptr;
+	start_switch(&caller_fake_stack, stack, STACK_SIZE);
+	swapcontext(&caller, &context);
+	finish_switch(caller_fake_stack, nullptr, nullptr);
+}
+
+void Fiber::suspend()
+{
+#ifdef LOX_TSAN
+	__tsan_switch_to_fiber(tsan_caller, 0);
+#endif
+	start_switch(&fake_stack, caller_stack, caller_stack_size);
+	swapcontext(&context, &caller);
+	// Possibly resumed by another thread, with another stack
+	finish_switch(fake_stack, &caller_stack, &caller_stack_size);
+}
+
+void Fiber::start(unsigned low_bits, unsigned high_bits)
+{
+	auto address = static_cast<std::uintptr_t>(high_bits) << 32 | low_bits;
+	auto &fiber = *reinterpret_cast<Fiber *>(address);
+
+	finish_switch(nullptr, &fiber.caller_stack, &fiber.caller_stack_size);
+	fiber.body();
+	fiber.exit();
+}
+
+void Fiber::exit()
+{
+	done = true;
+	// Nothing is left on this stack, its fake stack can be freed
+#ifdef LOX_TSAN
+	__tsan_switch_to_fiber(tsan_caller, 0);
+#endif
+	start_switch(nullptr, caller_stack, caller_stack_size);
+	setcontext(&caller);
+	__builtin_unreachable();
+}
+
+#else
+
+// Actors are not spawned without fibers
+Fiber::Fiber(Body) { assert(!"Fibers are not supported"); }
+
+Fiber::~Fiber() = default;
+
+void Fiber::resume() { assert(!"Fibers are not supported"); }
+
+void Fiber::suspend() { assert(!"Fibers are not supported"); }
+
+#endif
@@ -0,0 +1,65 @@
+#ifndef FIBER_HXX_INCLUDED
+#define FIBER_HXX_INCLUDED
+
+#include <cstddef>
+#include <functional>
+
+#if defined(__unix__) && __has_include(<ucontext.h>)
+#include <ucontext.h>
+#define LOX_FIBERS_SUPPORTED 1
+#endif
+
+// A function running on a stack of its own, which can suspend itself and be
+// resumed later from where it left off, by any thread. Used for actors, so
+// that waiting for a message or sleeping does not block a worker thread.
+//
+// The body must not let an exception escape and must not suspend while
+// handling one, as the exception state belongs to the thread.
+class Fiber
+{
+public:
+	using Body = std::function<void()>;
+
+	// Only the pages used are backed by memory
+	static constexpr std::size_t STACK_SIZE = 8 * 1024 * 1024;
+
+	Fiber(Body body_);
+	Fiber(const Fiber &) = delete;
+	Fiber &operator=(const Fiber &) = delete;
+	/// The fiber must have finished or never have been started.
+	~Fiber();
+
+	/// Runs the fiber until it suspends itself or finishes.
+	void resume();
+
+	/// Returns to the resume call running the fiber, called by the fiber.
+	void suspend();
+
+	bool finished() const { return done; }
+
+#ifdef LOX_FIBERS_SUPPORTED
+private:
+	static void start(unsigned low_bits, unsigned high_bits);
+	// Switches away from the fiber for the last time
+	[[noreturn]] void exit();
+
+	Body body;
+	void *stack = nullptr;
+	ucontext_t context;
+	// Where resume was called from
+	ucontext_t caller;
+	bool done = false;
+
+	// State of the sanitizers, which have to be told about stack switches
+	void *fake_stack = nullptr;
+	const void *caller_stack = nullptr;
+	std::size_t caller_stack_size = 0;
+	void *tsan_fiber = nullptr;
+	void *tsan_caller = nullptr;
+#else
+private:
+	bool done = false;
+#endif
+};
+
+#endif
@@ -7,13 +7,28 @@
 #include "object/object.hxx"
 #include "object/lox_function.hxx"
 #include "object/lox_instance.hxx"
+#include "object/lox_class.hxx"
+#include "object/lox_list.hxx"
+#include "object/lox_map.hxx"
+#include "object/lox_generator.hxx"
+#include "object/native.hxx"
 
 void GarbageCollector::collect_impl()
 {
+	// Zero is the mark of new lists and maps, skip it when wrapping around.
+	if (++mark_epoch == 0)
+		mark_epoch = 1;
+
 	// Follow the chain from directly-reachable environments
 	// and mark all which are reachable
 	for (auto &env : directly_reachable)
 		mark_reachable(env);
+	event_loop.for_each_task([this](LoxGenerator &task) {
+		mark_reachable(task);
+	});
+	arguments.for_each([this](const Object &value) {
+		mark_reachable_from_object(value);
+	});
 
 	auto swap_remove = [](auto &vec, unsigned remove_at) {
 		using std::swap;
@@ -68,22 +83,89 @@ void GarbageCollector::mark_reachable(
 		mark_reachable_from_object(object);
 }
 
-void GarbageCollector::mark_reachable_from_object(Object &object)
+void GarbageCollector::mark_reachable_from_object(const Object &object)
 {
 	// Function objects have environments
 	if (match_types<LoxCallablePtr>(object)) {
 		auto &callable = *std::get<LoxCallablePtr>(object);
-		if (typeid(callable) != typeid(LoxFunction))
-			return;
-
-		auto env = dynamic_cast<LoxFunction &>(callable).closure;
-		mark_reachable(env);
+		switch (callable.kind) {
+		case LoxCallable::Kind::Function: {
+			auto env = static_cast<LoxFunction &>(callable).closure;
+			mark_reachable(env);
+			break;
+		}
+		// Methods of lists and maps hold on to them
+		case LoxCallable::Kind::BuiltinMethod:
+			mark_reachable_from_object(
+				static_cast<BuiltinMethod &>(callable).self
+			);
+			break;
+		default:
+			break;
+		}
 	}
 
 	// FIXME Causes infinite recursion for self referential instances.
 	// An instance fields can have function objects which have environments
 	else if (match_types<LoxInstancePtr>(object)) {
-		for (auto &[name, obj] : std::get<LoxInstancePtr>(object)->fields)
+		auto &instance = *std::get<LoxInstancePtr>(object);
+		mark_reachable(*instance.klass);
+		for (auto &[name, obj] : instance.fields)
 			mark_reachable_from_object(obj);
 	}
+
+	// Methods of classes declared in functions enclose their environments
+	else if (match_types<LoxClassPtr>(object)) {
+		mark_reachable(*std::get<LoxClassPtr>(object));
+	}
+
+	else if (match_types<LoxListPtr>(object)) {
+		auto &list = *std::get<LoxListPtr>(object);
+		if (!mark_visited(list))
+			return;
+
+		for (auto &element : list.elements)
+			mark_reachable_from_object(element);
+	}
+
+	else if (match_types<LoxMapPtr>(object)) {
+		auto &map = *std::get<LoxMapPtr>(object);
+		if (!mark_visited(map))
+			return;
+
+		for (auto &slot : map.slots) {
+			mark_reachable_from_object(slot.key);
+			mark_reachable_from_object(slot.value);
+		}
+	}
+
+	else if (match_types<LoxGeneratorPtr>(object)) {
+		mark_reachable(*std::get<LoxGeneratorPtr>(object));
+	}
+}
+
+void GarbageCollector::mark_reachable(LoxClass &klass)
+{
+	if (!mark_visited(klass))
+		return;
+
+	// The table has the inherited methods too. Those of subclasses enclose
+	// the environment defining 'super', which is not tracked and so stays
+	// marked: the environment around it is marked from here as well.
+	for (auto &method : klass.method_table) {
+		mark_reachable(method->closure);
+		if (method->closure->enclosing != nullptr)
+			mark_reachable(method->closure->enclosing);
+	}
+}
+
+void GarbageCollector::mark_reachable(LoxGenerator &generator)
+{
+	if (!mark_visited(generator))
+		return;
+
+	// The enclosing frames share the environments or enclose them
+	if (!generator.frames.empty())
+		mark_reachable(generator.frames.back().environment);
+	mark_reachable_from_object(generator.yielded);
 }
\ No newline at end of file
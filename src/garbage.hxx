@@ -8,12 +8,22 @@
 #include <utility>
 
 #include "environment.hxx"
+#include "event_loop.hxx"
+#include "tracer.hxx"
+#include "value_stack.hxx"
 #include "object/object.hxx"
 
 class GarbageCollector
 {
 public:
-	GarbageCollector(EnvironmentPtr initial_env)
+	/// The tasks waiting in the event loop and the arguments of the calls
+	/// being made are reachable too.
+	GarbageCollector(
+		EnvironmentPtr initial_env, const EventLoop &event_loop_,
+		const ValueStack &arguments_
+	)
+		: event_loop(event_loop_)
+		, arguments(arguments_)
 	{
 		environments.push_back(initial_env);
 		directly_reachable.push_back(initial_env);
@@ -34,19 +44,49 @@ public:
 
 	void pop_environment() { directly_reachable.pop_back(); }
 
+	/// Tracks an environment, without it being directly reachable.
+	/// For the environments of generators, see LoxGenerator.
+	void track_environment(const EnvironmentPtr &environment)
+	{
+		environments.push_back(environment);
+	}
+
+	/// Makes an already tracked environment directly reachable, until it
+	/// is popped by pop_environment.
+	void push_reachable(const EnvironmentPtr &environment)
+	{
+		directly_reachable.push_back(environment);
+	}
+
 	void collect()
 	{
 		// The timer was removed, because it caused a lot of page faults,
 		// IDK why :|
+		Tracer::Span span(tracer, "gc", "GarbageCollector::collect");
 		collect_impl();
 	}
 
+	/// Records each collection into the tracer, if it is not null.
+	void set_tracer(Tracer *tracer_) { tracer = tracer_; }
+
 	//~GarbageCollector() { collect_impl(); }
 
 private:
 	void collect_impl();
 	void mark_reachable(const std::weak_ptr<Environment> &environment);
-	void mark_reachable_from_object(Object &object);
+	void mark_reachable_from_object(const Object &object);
+	void mark_reachable(LoxGenerator &generator);
+	void mark_reachable(LoxClass &klass);
+	// Marks a list or map as visited in this collection, returns false if
+	// it was already, so that cycles through them are only followed once.
+	template <typename T>
+	bool mark_visited(T &collection)
+	{
+		if (collection.gc_mark == mark_epoch)
+			return false;
+		collection.gc_mark = mark_epoch;
+		return true;
+	}
 
 	// Maps environment to whether are they reachable or not
 	std::vector<std::weak_ptr<Environment>> environments;
@@ -54,6 +94,12 @@ private:
 	// they are direclty reachable because they can be found via
 	// traversing the environment chain or in the interpreter.
 	std::vector<std::weak_ptr<Environment>> directly_reachable;
+	// Number of the current collection, lists and maps store the last one
+	// in which they were marked.
+	unsigned mark_epoch = 0;
+	const EventLoop &event_loop;
+	const ValueStack &arguments;
+	Tracer *tracer = nullptr;
 };
 
 #endif
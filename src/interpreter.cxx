@@ -1,9 +1,12 @@
+#include <algorithm>
 #include <cassert>
+#include <cmath>
 #include <cstddef>
 #include <format>
-#include <iostream>
 #include <map>
 #include <string>
+#include <thread>
+#include <type_traits>
 #include <utility>
 #include <variant>
 
@@ -13,13 +16,22 @@
 #include "expr.hxx"
 #include "stmt.hxx"
 #include "environment.hxx"
+#include "numeric.hxx"
+#include "parser.hxx"
+#include "resolver.hxx"
+#include "optimizer.hxx"
+#include "output.hxx"
 #include "interpreter.hxx"
+#include "actor.hxx"
 #include "object/object.hxx"
 #include "object/native.hxx"
 #include "object/lox_callable.hxx"
 #include "object/lox_function.hxx"
 #include "object/lox_class.hxx"
 #include "object/lox_instance.hxx"
+#include "object/lox_list.hxx"
+#include "object/lox_map.hxx"
+#include "object/float64_array.hxx"
 
 using enum TokenType;
 using std::get;
@@ -30,6 +42,24 @@ using std::string;
 // Helper functions and macros
 //---------------------------------------------------------
 
+// Comparison of a counted loop's counter with the limit
+static bool compare_numbers(TokenType type, double left, double right)
+{
+	switch (type) {
+	case LESS:
+		return left < right;
+	case LESS_EQUAL:
+		return left <= right;
+	case GREATER:
+		return left > right;
+	case GREATER_EQUAL:
+		return left >= right;
+	default:
+		assert(!"Unreachable code");
+		return false;
+	}
+}
+
 // Calculates and returns the result, both operands should be numbers.
 #define RETURN_NUMBER_BINOP(left, right, op_token)                    \
 	do {                                                              \
@@ -48,17 +78,6 @@ using std::string;
 		}                                                                 \
 	} while (0)
 
-static bool is_truthy(const Object &lit)
-{
-	if (match_types<std::nullptr_t>(lit))
-		return false;
-
-	if (match_types<bool>(lit))
-		return std::get<bool>(lit);
-
-	return true;
-}
-
 static void check_number_operand(const Token &op, const Object &right)
 {
 	if (match_types<double>(right))
@@ -79,24 +98,119 @@ check_number_operands(const Token &op, const Object &left, const Object &right)
 // Interpreter interface methods
 //---------------------------------------------------------
 
-Interpreter::Interpreter()
+// Checks that the index is an integer within an array of the size,
+// returns it.
+static std::size_t
+array_index(std::size_t size, const Object &index, const Token &bracket)
+{
+	auto number = std::get_if<double>(&index);
+	if (number == nullptr || std::trunc(*number) != *number)
+		throw RuntimeError(bracket, "Index must be an integer.");
+
+	if (*number < 0 || *number >= size) {
+		throw RuntimeError(
+			bracket, std::format("Index {} is out of range.", *number)
+		);
+	}
+
+	return static_cast<std::size_t>(*number);
+}
+
+Interpreter::Interpreter(std::ostream &out)
+	: output(out)
+{
+	define_native_functions(*globals);
+}
+
+Interpreter::Interpreter(Interpreter &parent, Actor &actor_)
+	: output(parent.output)
+	, optimizer_enabled(parent.optimizer_enabled)
+	, engine(parent.engine)
+	, jit_enabled(parent.jit_enabled)
+	, actor(&actor_)
+	, scheduler(parent.scheduler)
 {
-	globals->define("clock", make_shared<ClockFn>());
-	globals->define("sleep", make_shared<SleepFn>());
-	globals->define("string", make_shared<StringFn>());
-	globals->define("instance_of", make_shared<InstanceOfFn>());
+	jit.threshold = parent.jit.threshold;
+	jit.dump = parent.jit.dump;
+	event_tracer = parent.event_tracer;
+	garbage_collector.set_tracer(event_tracer);
 }
 
-void Interpreter::interpret(std::vector<StmtPtr> statements)
+Interpreter::~Interpreter() = default;
+
+ActorScheduler &Interpreter::actor_scheduler()
 {
+	if (scheduler == nullptr) {
+		auto threads = actor_threads;
+		if (threads == 0)
+			threads = std::max(std::thread::hardware_concurrency(), 1u);
+		own_scheduler = std::make_unique<ActorScheduler>(threads);
+		scheduler = own_scheduler.get();
+	}
+
+	return *scheduler;
+}
+
+void Interpreter::interpret(const std::vector<StmtPtr> &statements)
+{
+	Tracer::Span span(event_tracer, "run", "Interpreter::interpret");
+	// The program may declare the globals of pure functions again
+	if (memo_cache != nullptr)
+		memo_cache->clear();
+
 	try {
-		for (auto &stmt : statements)
-			execute(*stmt);
+		if (engine == Engine::Closure) {
+			for (auto &stmt : closure_compiler.compile(statements))
+				stmt();
+		} else {
+			for (auto &stmt : statements)
+				execute(*stmt);
+		}
+
+		// Then the tasks it left
+		if (!tasks.empty())
+			tasks.run(*this);
 	} catch (RuntimeError err) {
-		print_runtime_error(err);
+		errors.print_runtime_error(err);
 	} catch (NativeFnError err) {
-		print_nativefn_error(err);
+		errors.print_nativefn_error(err);
 	}
+
+	// The program is done once the actors it spawned are
+	if (own_scheduler != nullptr && !own_scheduler->wait())
+		errors.had_runtime_error = true;
+}
+
+bool Interpreter::finish_tasks()
+{
+	try {
+		tasks.run(*this);
+		return true;
+	} catch (const RuntimeError &err) {
+		errors.print_runtime_error(err);
+	} catch (const NativeFnError &err) {
+		errors.print_nativefn_error(err);
+	}
+
+	return false;
+}
+
+std::optional<Object> Interpreter::call_value(
+	const Object &callee, const std::string &name,
+	std::vector<Object> arguments
+)
+{
+	Token token(IDENTIFIER, name, nullptr, 0);
+
+	try {
+		return check_call(callee, token, arguments)->call(*this, arguments);
+	} catch (const RuntimeError &err) {
+		errors.print_runtime_error(err);
+	} catch (const NativeFnError &err) {
+		errors.print_nativefn_error(err);
+	}
+
+	return std::nullopt;
 }
 
 // Statement visitor methods
@@ -104,42 +218,74 @@ void Interpreter::interpret(std::vector<StmtPtr> statements)
 
 void Interpreter::visit_assert_stmt(const Assert &stmt)
 {
+	count_node(Node::Assert, stmt.token.line);
 	if (!is_truthy(evaluate(*stmt.expression)))
 		throw RuntimeError(stmt.token, "Assertion failed.");
 }
 
 void Interpreter::visit_print_stmt(const Print &stmt)
 {
+	count_node(Node::Print);
 	auto value = evaluate(*stmt.expression);
-	std::cout << to_string(value) << '\n';
+	output.write_value(value);
+	output.write('\n');
 }
 
-void Interpreter::visit_break_stmt(const Break &) { throw ControlBreak(); }
+void Interpreter::visit_break_stmt(const Break &stmt)
+{
+	count_node(Node::Break, stmt.keyword.line);
+	count(&ExecutionStats::breaks);
+	throw ControlBreak();
+}
 
-void Interpreter::visit_continue_stmt(const Continue &)
+void Interpreter::visit_continue_stmt(const Continue &stmt)
 {
+	count_node(Node::Continue, stmt.keyword.line);
+	count(&ExecutionStats::continues);
 	throw ControlContinue();
 }
 
 void Interpreter::visit_return_stmt(const Return &stmt)
 {
-	if (stmt.value == nullptr)
+	count_node(Node::Return, stmt.keyword.line);
+	if (stmt.value == nullptr) {
+		count(&ExecutionStats::returns);
 		throw ControlReturn(Object(nullptr));
-	throw ControlReturn(evaluate(*stmt.value));
+	}
+
+	// The Optimizer may have replaced the call since it was resolved
+	if (stmt.tail_call) {
+		if (auto call = dynamic_cast<const Call *>(stmt.value.get()))
+			tail_call(*call);
+	}
+	auto value = evaluate(*stmt.value);
+	count(&ExecutionStats::returns);
+	throw ControlReturn(std::move(value));
 }
 
 void Interpreter::visit_expr_stmt(const Expression &stmt)
 {
+	count_node(Node::Expression);
 	evaluate(*stmt.expression);
 }
 
 void Interpreter::visit_block_stmt(const Block &stmt)
 {
+	count_node(Node::Block);
+	if (!stmt.needs_environment) {
+		for (auto &statement : stmt.statements)
+			execute(*statement);
+		return;
+	}
+
+	count(&ExecutionStats::environments);
+	count_allocation(Allocation::Environment, sizeof(Environment), stmt.line);
 	execute_block(stmt.statements, make_shared<Environment>(environment));
 }
 
 void Interpreter::visit_if_stmt(const If &stmt)
 {
+	count_node(Node::If);
 	if (is_truthy(evaluate(*stmt.condition)))
 		execute(*stmt.then_branch);
 	else if (stmt.else_branch != nullptr)
@@ -147,6 +293,15 @@ void Interpreter::visit_if_stmt(const If &stmt)
 }
 
 void Interpreter::visit_while_stmt(const While &stmt)
+{
+	count_node(Node::While);
+	if (stmt.counted && stmt.counted->enabled)
+		execute_counted_loop(stmt);
+	else
+		execute_loop(stmt);
+}
+
+void Interpreter::execute_loop(const While &stmt)
 {
 	while (is_truthy(evaluate(*stmt.condition))) {
 		try {
@@ -170,6 +325,7 @@ void Interpreter::visit_while_stmt(const While &stmt)
 
 void Interpreter::visit_var_stmt(const Var &stmt)
 {
+	count_node(Node::Var, stmt.name.line);
 	auto value = evaluate(*stmt.initializer);
 	auto klass = make_shared<Variable>(stmt.name);
 	environment->define(stmt.name.lexeme, value);
@@ -177,12 +333,15 @@ void Interpreter::visit_var_stmt(const Var &stmt)
 
 void Interpreter::visit_function_stmt(const Function &stmt)
 {
+	count_node(Node::Function, stmt.name.line);
+	count_allocation(Allocation::Function, sizeof(LoxFunction), stmt.name.line);
 	LoxCallablePtr function = make_shared<LoxFunction>(stmt, environment);
 	environment->define(stmt.name.lexeme, std::move(function));
 }
 
 void Interpreter::visit_class_stmt(const Class &stmt)
 {
+	count_node(Node::Class, stmt.name.line);
 	environment->define(stmt.name.lexeme, nullptr);
 
 	// If a superclass name exists and it is an Object of type LoxClass
@@ -202,6 +361,10 @@ void Interpreter::visit_class_stmt(const Class &stmt)
 	// the same because it is only used to access methods and methods remain
 	// the same for every instance of a class, unlike data-fields.
 	if (stmt.superclass) {
+		count(&ExecutionStats::environments);
+		count_allocation(
+			Allocation::Environment, sizeof(Environment), stmt.name.line
+		);
 		environment = make_shared<Environment>(environment);
 		environment->define("super", superclass);
 	}
@@ -213,12 +376,16 @@ void Interpreter::visit_class_stmt(const Class &stmt)
 	ClassMethodMap methods;
 	for (auto &method : stmt.methods) {
 		bool is_init = method.name.lexeme == "init";
+		count_allocation(
+			Allocation::Function, sizeof(LoxFunction), method.name.line
+		);
 		methods.insert({
 			method.name.lexeme,
 			make_shared<LoxFunction>(method, environment, is_init),
 		});
 	}
 
+	count_allocation(Allocation::Class, sizeof(LoxClass), stmt.name.line);
 	auto klass = make_shared<LoxClass>(
 		stmt.name.lexeme, std::move(superclass), std::move(methods)
 	);
@@ -236,52 +403,119 @@ void Interpreter::visit_class_stmt(const Class &stmt)
 
 Object Interpreter::visit_literal_expr(const Literal &expr)
 {
+	count_node(Node::Literal);
 	return expr.value;
 }
 
 Object Interpreter::visit_grouping_expr(const Grouping &expr)
 {
+	count_node(Node::Grouping);
 	return evaluate(*expr.expression);
 }
 
 Object Interpreter::visit_call_expr(const Call &expr)
 {
-	auto callee = evaluate(*expr.callee);
+	count_node(Node::Call, expr.paren.line);
+	return call(evaluate(*expr.callee), expr);
+}
 
-	std::vector<Object> arguments;
-	for (auto &arg : expr.arguments)
-		arguments.push_back(evaluate(*arg));
+Object Interpreter::call(Object callee, const Call &expr)
+{
+	// The callee is kept on the stack too, evaluating the arguments may
+	// run the garbage collector
+	ValueStack::Frame frame(value_stack, expr.arguments.size() + 1);
+	frame.values()[0] = std::move(callee);
+	auto arguments = frame.values().subspan(1);
+	for (std::size_t i = 0; i < arguments.size(); ++i)
+		arguments[i] = evaluate(*expr.arguments[i]);
+
+	auto function = check_call(frame.values()[0], expr.paren, arguments);
+	count_call_line(expr.paren.line);
+	return function->call(*this, arguments);
+}
+
+void Interpreter::tail_call(const Call &expr)
+{
+	// The callee is kept on the stack too, evaluating the arguments may
+	// run the garbage collector
+	ValueStack::Frame frame(value_stack, expr.arguments.size() + 1);
+	auto &callee = frame.values()[0];
+	callee = evaluate(*expr.callee);
+	auto arguments = frame.values().subspan(1);
+	for (std::size_t i = 0; i < arguments.size(); ++i)
+		arguments[i] = evaluate(*expr.arguments[i]);
+	auto function = check_call(callee, expr.paren, arguments);
+	count_call_line(expr.paren.line);
+
+	// Natives and classes are called right away
+	if (function->kind != LoxCallable::Kind::Function) {
+		auto value = function->call(*this, arguments);
+		count(&ExecutionStats::returns);
+		throw ControlReturn(std::move(value));
+	}
+
+	count(&ExecutionStats::tail_calls);
+	value_stack.hold_tail_call(std::move(function), arguments);
+	throw ControlTailCall();
+}
 
+LoxCallablePtr Interpreter::check_call(
+	const Object &callee, const Token &paren,
+	std::span<const Object> arguments
+)
+{
 	LoxCallablePtr function = nullptr;
 	if (match_types<LoxCallablePtr>(callee))
 		function = get<LoxCallablePtr>(callee);
 	else if (match_types<LoxClassPtr>(callee))
 		function = get<LoxClassPtr>(callee);
 	else
-		throw RuntimeError(expr.paren, "Can only call functions and classes.");
+		throw RuntimeError(paren, "Can only call functions and classes.");
 
 	if (arguments.size() != function->arity()) {
 		auto err_msg = std::format(
 			"Expected {} arguments but got {} arguments.", function->arity(),
 			arguments.size()
 		);
-		throw RuntimeError(expr.paren, err_msg);
+		throw RuntimeError(paren, err_msg);
 	}
 
-	return function->call(*this, arguments);
+	return function;
 }
 
 Object Interpreter::visit_get_expr(const Get &expr)
 {
+	count_node(Node::Get, expr.name.line);
 	auto object = evaluate(*expr.object);
+	auto property = get_property(object, expr.name);
+	if (allocations != nullptr)
+		count_binding(object, expr.name);
+	return property;
+}
+
+Object Interpreter::get_property(const Object &object, const Token &name)
+{
+	if (match_types<LoxInstancePtr>(object))
+		return get<LoxInstancePtr>(object)->get(name);
+
+	return get_builtin_method(object, name);
+}
+
+void Interpreter::count_binding(const Object &object, const Token &name)
+{
 	if (!match_types<LoxInstancePtr>(object))
-		throw RuntimeError(expr.name, "Only instances have properties.");
+		return;
+	// Fields are got as they are, methods are bound, see LoxFunction::bind
+	if (get<LoxInstancePtr>(object)->has_field(name.lexeme))
+		return;
 
-	return get<LoxInstancePtr>(object)->get(expr.name);
+	count_allocation(Allocation::Environment, sizeof(Environment), name.line);
+	count_allocation(Allocation::Function, sizeof(LoxFunction), name.line);
 }
 
 Object Interpreter::visit_set_expr(const Set &expr)
 {
+	count_node(Node::Set, expr.name.line);
 	auto object = evaluate(*expr.object);
 	if (!match_types<LoxInstancePtr>(object))
 		throw RuntimeError(expr.name, "Only instances have fields.");
@@ -291,8 +525,122 @@ Object Interpreter::visit_set_expr(const Set &expr)
 	return value;
 }
 
+Object Interpreter::visit_list_literal_expr(const ListLiteral &expr)
+{
+	count_node(Node::ListLiteral, expr.bracket.line);
+	// On the stack while it is filled, the garbage collector finds the
+	// elements evaluated through it. Unlike arguments, there may be more
+	// of them than a chunk of the stack holds.
+	ValueStack::Frame frame(value_stack, 1);
+	auto list = make_shared<LoxList>();
+	frame.values()[0] = list;
+	auto &elements = list->elements;
+	elements.reserve(expr.elements.size());
+	for (auto &element : expr.elements)
+		elements.push_back(evaluate(*element));
+
+	count_allocation(
+		Allocation::List,
+		sizeof(LoxList) + elements.capacity() * sizeof(Object),
+		expr.bracket.line
+	);
+	return list;
+}
+
+Object Interpreter::visit_map_literal_expr(const MapLiteral &expr)
+{
+	count_node(Node::MapLiteral, expr.brace.line);
+	count_allocation(
+		Allocation::Map,
+		sizeof(LoxMap) + expr.keys.size() * 2 * sizeof(Object),
+		expr.brace.line
+	);
+	// The map and the key being set are on the stack, like the list above
+	ValueStack::Frame frame(value_stack, 2);
+	auto map = make_shared<LoxMap>();
+	frame.values()[0] = map;
+	auto &key = frame.values()[1];
+	for (std::size_t i = 0; i < expr.keys.size(); ++i) {
+		key = evaluate(*expr.keys[i]);
+		map->set(key, evaluate(*expr.values[i]));
+	}
+
+	return map;
+}
+
+Object Interpreter::visit_subscript_expr(const Subscript &expr)
+{
+	count_node(Node::Subscript, expr.bracket.line);
+	auto object = evaluate(*expr.object);
+	return subscript(object, evaluate(*expr.index), expr.bracket);
+}
+
+Object Interpreter::visit_subscript_set_expr(const SubscriptSet &expr)
+{
+	count_node(Node::SubscriptSet, expr.bracket.line);
+	auto object = evaluate(*expr.object);
+	auto index = evaluate(*expr.index);
+	auto value = evaluate(*expr.value);
+	subscript_set(object, index, value, expr.bracket);
+	return value;
+}
+
+Object Interpreter::visit_yield_expr(const Yield &expr)
+{
+	count_node(Node::Yield, expr.keyword.line);
+	// The Resolver only allows the ones LoxGenerator takes care of
+	throw RuntimeError(expr.keyword, "Can't yield outside of a generator.");
+}
+
+Object Interpreter::subscript(
+	const Object &object, const Object &index, const Token &bracket
+)
+{
+	if (match_types<LoxListPtr>(object)) {
+		auto &list = get<LoxListPtr>(object)->elements;
+		return list[array_index(list.size(), index, bracket)];
+	}
+
+	if (match_types<LoxFloat64ArrayPtr>(object)) {
+		auto &array = get<LoxFloat64ArrayPtr>(object)->elements;
+		return array[array_index(array.size(), index, bracket)];
+	}
+
+	if (match_types<LoxMapPtr>(object)) {
+		if (auto value = get<LoxMapPtr>(object)->find(index))
+			return *value;
+		throw RuntimeError(
+			bracket, std::format("Key {} not found.", to_element_string(index))
+		);
+	}
+
+	throw RuntimeError(bracket, "Only collections can be subscripted.");
+}
+
+void Interpreter::subscript_set(
+	const Object &object, const Object &index, const Object &value,
+	const Token &bracket
+)
+{
+	if (match_types<LoxListPtr>(object)) {
+		auto &list = get<LoxListPtr>(object)->elements;
+		list[array_index(list.size(), index, bracket)] = value;
+	} else if (match_types<LoxFloat64ArrayPtr>(object)) {
+		auto &array = get<LoxFloat64ArrayPtr>(object)->elements;
+		auto position = array_index(array.size(), index, bracket);
+		if (!match_types<double>(value))
+			throw RuntimeError(bracket, "Float64Array elements must be numbers.");
+		array[position] = get<double>(value);
+	} else if (match_types<LoxMapPtr>(object)) {
+		get<LoxMapPtr>(object)->set(index, value);
+	} else {
+		throw RuntimeError(bracket, "Only collections can be subscripted.");
+	}
+}
+
 Object Interpreter::visit_super_expr(const Super &expr)
 {
+	count_node(Node::Super, expr.keyword.line);
 	auto distance = locals.at(&expr);
 	auto superclass = get<LoxClassPtr>(environment->get_at(distance, "super"));
 	// 'this' resides in the scope which is nested inside the scope
@@ -308,26 +656,52 @@ Object Interpreter::visit_super_expr(const Super &expr)
 		);
 	}
 
+	count_allocation(
+		Allocation::Environment, sizeof(Environment), expr.keyword.line
+	);
+	count_allocation(
+		Allocation::Function, sizeof(LoxFunction), expr.keyword.line
+	);
 	return method->bind(std::move(object));
 }
 
 Object Interpreter::visit_this_expr(const This &expr)
 {
+	count_node(Node::This, expr.keyword.line);
 	return look_up_variable(expr.keyword, expr);
 }
 
 Object Interpreter::visit_unary_expr(const Unary &expr)
 {
+	count_node(Node::Unary, expr.operat.line);
+	return unary_operation(expr.operat, evaluate(*expr.right));
+}
+
+Object Interpreter::visit_binary_expr(const Binary &expr)
+{
+	count_node(Node::Binary, expr.operat.line);
+	auto left = evaluate(*expr.left);
 	auto right = evaluate(*expr.right);
+	auto result = binary_operation(expr.operat, left, right);
+	if (allocations != nullptr && match_types<string>(result)) {
+		count_allocation(
+			Allocation::String, get<string>(result).size() + 1,
+			expr.operat.line
+		);
+	}
+	return result;
+}
 
-	switch (expr.operat.type) {
+Object Interpreter::unary_operation(const Token &operat, const Object &right)
+{
+	switch (operat.type) {
 	case BANG:
 		return Object(!is_truthy(right));
 	case PLUS:
-		check_number_operand(expr.operat, right);
+		check_number_operand(operat, right);
 		return Object(get<double>(right));
 	case MINUS:
-		check_number_operand(expr.operat, right);
+		check_number_operand(operat, right);
 		return Object(-get<double>(right));
 
 	default:
@@ -338,29 +712,28 @@ Object Interpreter::visit_unary_expr(const Unary &expr)
 	return nullptr;
 }
 
-Object Interpreter::visit_binary_expr(const Binary &expr)
+Object Interpreter::binary_operation(
+	const Token &operat, const Object &left, const Object &right
+)
 {
 	const auto STRING_OR_NUMBER_EXPECTED = RuntimeError(
-		expr.operat, "Operands must be two strings or two numbers."
+		operat, "Operands must be two strings or two numbers."
 	);
 
-	auto left = evaluate(*expr.left);
-	auto right = evaluate(*expr.right);
-
-	switch (expr.operat.type) {
+	switch (operat.type) {
 	case PLUS:
 		RETURN_NUMBER_OR_STRING_BINOP(left, right, +);
 		throw STRING_OR_NUMBER_EXPECTED;
 		break;
 
 	case MINUS:
-		check_number_operands(expr.operat, left, right);
+		check_number_operands(operat, left, right);
 		RETURN_NUMBER_BINOP(left, right, -);
 	case STAR:
-		check_number_operands(expr.operat, left, right);
+		check_number_operands(operat, left, right);
 		RETURN_NUMBER_BINOP(left, right, *);
 	case SLASH:
-		check_number_operands(expr.operat, left, right);
+		check_number_operands(operat, left, right);
 		RETURN_NUMBER_BINOP(left, right, /);
 
 	case EQUAL_EQUAL:
@@ -391,6 +764,7 @@ Object Interpreter::visit_binary_expr(const Binary &expr)
 
 Object Interpreter::visit_logical_expr(const Logical &expr)
 {
+	count_node(Node::Logical, expr.operat.line);
 	auto left = evaluate(*expr.left);
 
 	if (expr.operat.type == OR) {
@@ -406,32 +780,149 @@ Object Interpreter::visit_logical_expr(const Logical &expr)
 
 Object Interpreter::visit_ternary_expr(const Ternary &expr)
 {
+	count_node(Node::Ternary);
 	bool res = is_truthy(evaluate(*expr.condition));
 	return evaluate(*(res ? expr.true_expr : expr.false_expr));
 }
 
 Object Interpreter::visit_variable_expr(const Variable &expr)
 {
+	count_node(Node::Variable, expr.name.line);
 	return look_up_variable(expr.name, expr);
 }
 
 Object Interpreter::visit_assign_expr(const Assign &expr)
 {
+	count_node(Node::Assign, expr.name.line);
 	auto value = evaluate(*expr.expression);
-	auto result = locals.find(&expr);
-	if (result != locals.end()) {
-		auto distance = result->second;
-		environment->assign_at(distance, expr.name, value);
-	} else {
-		globals->assign(expr.name, value);
+	assign_variable(expr, value);
+	return value;
+}
+
+Object Interpreter::visit_inline_call_expr(const InlineCall &expr)
+{
+	count_node(Node::InlineCall, expr.call->paren.line);
+	auto &call_expr = *expr.call;
+	auto callee = evaluate(*call_expr.callee);
+
+	// Guard: the global may have been bound to something else at runtime.
+	LoxFunction *function = nullptr;
+	if (match_types<LoxCallablePtr>(callee)) {
+		auto &callable = *get<LoxCallablePtr>(callee);
+		if (callable.kind == LoxCallable::Kind::Function)
+			function = static_cast<LoxFunction *>(&callable);
 	}
 
-	return value;
+	if (function == nullptr || !function->is_declared_by(*expr.function_body)) {
+		stats.inline_fallbacks++;
+		return call(callee, call_expr);
+	}
+
+	// On the stack like those of calls, for the garbage collector
+	ValueStack::Frame frame(value_stack, call_expr.arguments.size());
+	auto arguments = frame.values();
+	for (std::size_t i = 0; i < arguments.size(); ++i)
+		arguments[i] = evaluate(*call_expr.arguments[i]);
+
+	// Inlined bodies have no calls, so they cannot nest.
+	inline_arguments = arguments.data();
+	auto result = evaluate(*expr.body);
+	inline_arguments = nullptr;
+
+	stats.inlined_calls++;
+	return result;
+}
+
+Object Interpreter::visit_inline_param_expr(const InlineParam &expr)
+{
+	count_node(Node::InlineParam, expr.name.line);
+	return inline_arguments[expr.index];
+}
+
+Object Interpreter::visit_numeric_expr(const Numeric &expr)
+{
+	count_node(Node::Numeric);
+	return expr.expression->evaluate(*environment);
+}
+
+Object Interpreter::visit_numeric_condition_expr(const NumericCondition &expr)
+{
+	count_node(Node::NumericCondition);
+	return expr.condition->evaluate(*environment);
+}
+
+void Interpreter::execute_counted_loop(const While &stmt)
+{
+	auto &loop = *stmt.counted;
+	// Map entries stay where they are, keep a reference to the counter.
+	auto &variable = environment->at(loop.distance, loop.name.lexeme);
+
+	// Let the generic loop deal with anything other than numbers.
+	if (!match_types<double>(variable)) {
+		execute_loop(stmt);
+		return;
+	}
+
+	double counter = get<double>(variable);
+
+	while (true) {
+		// The limit may read it as well
+		if (loop.observed)
+			variable = counter;
+
+		auto limit = evaluate(*loop.limit);
+		if (!match_types<double>(limit)) {
+			throw RuntimeError(
+				loop.comparison, "Operands must be two strings or two numbers."
+			);
+		}
+		if (!compare_numbers(loop.comparison.type, counter, get<double>(limit)))
+			break;
+
+		try {
+			execute(*stmt.body);
+		} catch (ControlBreak) {
+			break;
+		} catch (ControlContinue) {
+		}
+
+		counter += loop.step;
+	}
+
+	variable = counter;
 }
 
 void Interpreter::execute_block(
 	const std::vector<StmtPtr> &statements, EnvironmentPtr block_environ
 )
+{
+	execute_statements(statements, std::move(block_environ));
+}
+
+void Interpreter::execute_block(
+	const std::vector<CompiledStmt> &statements, EnvironmentPtr block_environ
+)
+{
+	execute_statements(statements, std::move(block_environ));
+}
+
+void Interpreter::execute_body(
+	const Function &function, EnvironmentPtr function_environ
+)
+{
+	if (engine == Engine::Closure) {
+		execute_block(
+			closure_compiler.compile_body(function), std::move(function_environ)
+		);
+	} else {
+		execute_block(*function.body, std::move(function_environ));
+	}
+}
+
+template <typename Statements>
+void Interpreter::execute_statements(
+	const Statements &statements, EnvironmentPtr block_environ
+)
 {
 	auto previous = std::move(environment);
 
@@ -458,8 +949,12 @@ void Interpreter::execute_block(
 	try {
 		environment = std::move(block_environ);
 
-		for (const auto &stmt : statements)
-			execute(*stmt);
+		for (const auto &stmt : statements) {
+			if constexpr (std::is_same_v<Statements, std::vector<StmtPtr>>)
+				execute(*stmt);
+			else
+				stmt();
+		}
 	} catch (RuntimeError err) {
 		environment = previous;
 		throw err;
@@ -472,7 +967,45 @@ void Interpreter::execute_block(
 	} catch (ControlReturn err) {
 		restore_environment();
 		throw err;
+	} catch (ControlTailCall &err) {
+		restore_environment();
+		throw;
 	}
 
 	restore_environment();
 }
+
+void Interpreter::compile_lazy_body(const Function &function)
+{
+	// Errors in the body are reported now, do not mix them with earlier ones
+	bool had_error = std::exchange(errors.had_error, false);
+
+	// The body may assign to the globals of pure functions
+	if (memo_cache != nullptr)
+		memo_cache->clear();
+
+	auto &lazy_body = *function.lazy_body;
+	*function.body = Parser::parse_lazy_body(lazy_body, errors);
+	if (!errors.had_error) {
+		lazy_body.compiled = true;
+		Resolver resolver(*this, errors);
+		resolver.resolve_lazy_body(function);
+	}
+
+	if (!errors.had_error && optimizer_enabled) {
+		Optimizer optimizer(*this);
+		optimizer.optimize_body(function);
+	}
+
+	if (errors.had_error) {
+		// Keep it uncompiled, so that every call reports the error.
+		lazy_body.compiled = false;
+		function.body->clear();
+		throw RuntimeError(
+			function.name,
+			std::format("Invalid body of function '{}'.", function.name.lexeme)
+		);
+	}
+
+	errors.had_error = had_error;
+}
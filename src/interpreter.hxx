@@ -1,8 +1,14 @@
 #ifndef INTERPRETER_HXX_INCLUDED
 #define INTERPRETER_HXX_INCLUDED
 
+#include <cstddef>
+#include <cstdint>
+#include <chrono>
+#include <iostream>
 #include <map>
 #include <memory>
+#include <optional>
+#include <span>
 #include <string>
 #include <variant>
 #include <vector>
@@ -13,19 +19,166 @@
 #include "stmt.hxx"
 #include "environment.hxx"
 #include "garbage.hxx"
+#include "event_loop.hxx"
+#include "stats.hxx"
+#include "output.hxx"
+#include "closure_compiler.hxx"
+#include "jit.hxx"
+#include "profiler.hxx"
+#include "tracer.hxx"
+#include "value_stack.hxx"
+#include "allocation_profiler.hxx"
+#include "memoizer.hxx"
 #include "object/object.hxx"
+#include "object/lox_function.hxx"
+
+class Actor;
+class ActorScheduler;
 
 class Interpreter : private ExprVisitor, private StmtVisitor
 {
-	friend class LoxFunction; // execute_block and ControlReturn.
+	friend class LoxFunction; // execute_block, ControlReturn and counters.
+	friend class Optimizer;     // evaluate for constant folding.
+	friend class TypeInference; // locals for variable distances.
+	friend class ClosureCompiler; // Nearly everything, it runs the code too.
+	friend class ValueCopier; // globals, locals and compile_lazy_body.
+	friend class LoxGenerator; // Runs the statements of generator bodies.
+	friend class PurityAnalysis; // locals for telling globals apart.
+	friend class Memoizer;       // globals and global_writes.
 
 public:
-	Interpreter();
-	void interpret(std::vector<StmtPtr> statements);
+	// How the code is run
+	enum class Engine { Tree, Closure };
+
+	/// Print statements and errors write to out.
+	Interpreter(std::ostream &out = std::cout);
+	/// The interpreter of an actor spawned by parent, with the same output
+	/// and settings. Its globals are copied by the Actor.
+	Interpreter(Interpreter &parent, Actor &actor_);
+	~Interpreter();
+
+	/// Runs a resolved program, reporting a runtime error if one happens.
+	void interpret(const std::vector<StmtPtr> &statements);
+
+	/// Calls a callable value from C++, reporting a runtime error like
+	/// interpret does. Returns nothing if there is one.
+	/// @param name Used in the error messages.
+	std::optional<Object> call_value(
+		const Object &callee, const std::string &name,
+		std::vector<Object> arguments
+	);
+
+	void define_global(const std::string &name, const Object &value)
+	{
+		globals->define(name, value);
+		if (memo_cache != nullptr)
+			memo_cache->clear();
+	}
+
+	/// Returns nullptr if there is no such global.
+	const Object *find_global(const std::string &name)
+	{
+		return globals->find(name);
+	}
+
+	OutputSink &output_sink() { return output; }
+	ErrorReporter &error_reporter() { return errors; }
+
+	/// Also run the Optimizer on lazily compiled function bodies.
+	void enable_optimizer(bool enable) { optimizer_enabled = enable; }
+
+	/// Selects between walking the AST and running it compiled to closures.
+	void use_engine(Engine engine_) { engine = engine_; }
+
+	/// Compiles functions called at least threshold times to machine code,
+	/// if they can be, see Jit. Reports them to std::cerr if dump is set.
+	void enable_jit(unsigned threshold, bool dump)
+	{
+		jit_enabled = true;
+		jit.threshold = threshold;
+		jit.dump = dump;
+	}
 
 	/// Puts info in name resolution side table for locals. For Resolver.
 	void resolve(const Expr &expr, int depth) { locals[&expr] = depth; }
 
+	/// Marks a variable as global. For Resolver.
+	void resolve_global(const Expr &expr) { locals.erase(&expr); }
+
+	/// Counts a declaration of or assignment to a global. For Resolver.
+	void resolve_global_write(const Token &name) { global_writes[name.lexeme]++; }
+
+	const Stats &statistics() const { return stats; }
+
+	/// Samples the Lox call stack rate times a second, see Profiler.
+	void enable_profiler(unsigned rate)
+	{
+		sampling_profiler = std::make_unique<Profiler>(rate);
+	}
+
+	/// nullptr unless enable_profiler was called.
+	Profiler *profiler() { return sampling_profiler.get(); }
+
+	/// Records the run, the garbage collections and the calls from the top
+	/// level lasting at least call_threshold into a Tracer, see Tracer.
+	void enable_tracer(std::chrono::microseconds call_threshold)
+	{
+		own_tracer = std::make_unique<Tracer>(call_threshold);
+		event_tracer = own_tracer.get();
+		garbage_collector.set_tracer(event_tracer);
+	}
+
+	/// nullptr unless enable_tracer was called, by this interpreter or by
+	/// the one which spawned its actor.
+	Tracer *tracer() { return event_tracer; }
+
+	/// Attributes the objects created to the lines and functions creating
+	/// them, see AllocationProfiler.
+	void enable_allocation_profiler(unsigned sample_interval)
+	{
+		allocations = std::make_unique<AllocationProfiler>(sample_interval);
+	}
+
+	/// nullptr unless enable_allocation_profiler was called.
+	AllocationProfiler *allocation_profiler() { return allocations.get(); }
+
+	/// Caches up to capacity results of the calls of pure functions, see
+	/// Memoizer.
+	void enable_memoizer(std::size_t capacity)
+	{
+		memo_cache = std::make_unique<Memoizer>(*this, stats, capacity);
+	}
+
+	/// nullptr unless enable_memoizer was called.
+	Memoizer *memoizer() { return memo_cache.get(); }
+
+	/// Records an object created for the AllocationProfiler, if enabled.
+	/// At the line of the last call made if line is 0.
+	void count_allocation(
+		AllocationProfiler::Kind kind, std::size_t bytes, int line = 0
+	)
+	{
+		if (allocations != nullptr)
+			allocations->record(kind, bytes, line);
+	}
+
+	/// Threads running the actors spawned, the number of cores if 0.
+	void set_actor_threads(unsigned count) { actor_threads = count; }
+
+	/// Runs the actors spawned, created on the first spawn. Shared with the
+	/// interpreters of the actors.
+	ActorScheduler &actor_scheduler();
+	bool has_actor_scheduler() const { return scheduler != nullptr; }
+
+	/// The actor run by this interpreter, nullptr if it is not one.
+	Actor *running_actor() const { return actor; }
+
+	/// Runs the tasks added by task(), see EventLoop.
+	EventLoop &event_loop() { return tasks; }
+	/// Runs the tasks left, reporting a runtime error like interpret does.
+	/// Returns false if there is one.
+	bool finish_tasks();
+
 	void visit_assert_stmt(const Assert &stmt) override;
 	void visit_print_stmt(const Print &stmt) override;
 	void visit_break_stmt(const Break &stmt) override;
@@ -52,6 +205,15 @@ public:
 	Object visit_ternary_expr(const Ternary &expr) override;
 	Object visit_variable_expr(const Variable &expr) override;
 	Object visit_assign_expr(const Assign &expr) override;
+	Object visit_list_literal_expr(const ListLiteral &expr) override;
+	Object visit_map_literal_expr(const MapLiteral &expr) override;
+	Object visit_subscript_expr(const Subscript &expr) override;
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override;
+	Object visit_yield_expr(const Yield &expr) override;
+	Object visit_inline_call_expr(const InlineCall &expr) override;
+	Object visit_inline_param_expr(const InlineParam &expr) override;
+	Object visit_numeric_expr(const Numeric &expr) override;
+	Object visit_numeric_condition_expr(const NumericCondition &expr) override;
 
 private:
 	// Control-flow exceptions.
@@ -64,14 +226,67 @@ private:
 	struct ControlReturn {
 		Object value;
 	};
+	// Thrown instead of a ControlReturn for a tail call of a LoxFunction,
+	// the function being returned from makes the call instead. The value
+	// stack holds the callee and the arguments meanwhile, so that the
+	// garbage collector finds them while the blocks are left.
+	struct ControlTailCall {
+	};
+
+	using Node = ExecutionStats::Node;
+	using Allocation = AllocationProfiler::Kind;
+
+	/// Counts a node run for --stats, only in a build with EXECUTION_STATS.
+	void count_node(Node node, int line = 0)
+	{
+		if constexpr (EXECUTION_STATS)
+			stats.execution.count_node(node, line);
+	}
+
+	/// Increments one of the ExecutionStats, if they are counted.
+	void count(std::uint64_t ExecutionStats::*counter)
+	{
+		if constexpr (EXECUTION_STATS)
+			(stats.execution.*counter)++;
+	}
+
+	void count_call(const std::string &name)
+	{
+		if constexpr (EXECUTION_STATS)
+			stats.execution.calls[name]++;
+	}
+
+	/// A call is made at the line, for the AllocationProfiler.
+	void count_call_line(int line)
+	{
+		if (allocations != nullptr)
+			allocations->at_line(line);
+	}
+
+	/// Records the objects of a method bound to an instance, if getting
+	/// the property of the object binds one. Only if allocations are
+	/// profiled.
+	void count_binding(const Object &object, const Token &name);
+
+	/// Assigns the value to the variable of an assignment expression.
+	void assign_variable(const Assign &expr, const Object &value)
+	{
+		auto result = locals.find(&expr);
+		if (result != locals.end())
+			environment->assign_at(result->second, expr.name, value);
+		else
+			globals->assign(expr.name, value);
+	}
 
 	Object look_up_variable(const Token &name, const Expr &expr)
 	{
 		auto result = locals.find(&expr);
 		if (result != locals.end()) {
+			count(&ExecutionStats::local_lookups);
 			auto distance = result->second;
 			return environment->get_at(distance, name.lexeme);
 		} else {
+			count(&ExecutionStats::global_lookups);
 			return globals->get(name);
 		}
 	}
@@ -80,12 +295,72 @@ private:
 
 	inline Object evaluate(const Expr &expr) { return expr.accept(*this); }
 
+	/// Puts the callee and the arguments of a call expression, evaluated,
+	/// on the value stack and calls the callee.
+	Object call(Object callee, const Call &expr);
+	/// Checks that the callee can be called with the arguments.
+	/// Returns the callee as a LoxCallable.
+	static LoxCallablePtr check_call(
+		const Object &callee, const Token &paren,
+		std::span<const Object> arguments
+	);
+	/// Makes a call in the tail position of a function, always throws.
+	[[noreturn]] void tail_call(const Call &expr);
+
+	/// Runs a while loop, evaluating the condition and update clauses.
+	void execute_loop(const While &stmt);
+	/// Runs a counted loop with a native counter, see CountedLoop.
+	void execute_counted_loop(const While &stmt);
+
 	/// Execute a statement block with the provided environment.
 	/// @param statements List of statements
 	/// @param block_environ The environment for it
 	void execute_block(
 		const std::vector<StmtPtr> &statements, EnvironmentPtr block_environ
 	);
+	/// Same as above, for statements compiled by the ClosureCompiler.
+	void execute_block(
+		const std::vector<CompiledStmt> &statements, EnvironmentPtr block_environ
+	);
+	template <typename Statements>
+	void execute_statements(
+		const Statements &statements, EnvironmentPtr block_environ
+	);
+
+	/// Runs a function body with the engine selected.
+	void
+	execute_body(const Function &function, EnvironmentPtr function_environ);
+	/// Runs a function call with the JIT, if it is compiled by it.
+	std::optional<Object>
+	jit_call(const Function &function, std::span<const Object> arguments)
+	{
+		if (!jit_enabled)
+			return std::nullopt;
+		return jit.call(function, arguments, stats);
+	}
+
+	/// Operators shared by both engines, the operands are evaluated already.
+	static Object unary_operation(const Token &operat, const Object &right);
+	static Object binary_operation(
+		const Token &operat, const Object &left, const Object &right
+	);
+	/// Property of an instance, or a method of a collection.
+	static Object get_property(const Object &object, const Token &name);
+	/// Element of a list, map or Float64Array.
+	static Object
+	subscript(const Object &object, const Object &index, const Token &bracket);
+	static void subscript_set(
+		const Object &object, const Object &index, const Object &value,
+		const Token &bracket
+	);
+
+	/// Parses and resolves a function body skipped by the pre-parser.
+	/// Throws a RuntimeError if the body has any errors.
+	void compile_lazy_body(const Function &function);
+
+	// Output of print statements and errors
+	OutputSink output;
+	ErrorReporter errors{output};
 
 	EnvironmentPtr globals = std::make_shared<Environment>();
 	EnvironmentPtr environment = globals;
@@ -108,7 +383,42 @@ private:
 	// The information stores is pointer representing the variable and its
 	// scope distance from current use point to its closest defnition.
 	std::map<const Expr *, int> locals;
-	GarbageCollector garbage_collector{globals};
+	// Number of declarations of and assignments to each global.
+	std::map<std::string, int> global_writes;
+
+	// Small global functions which can be inlined, kept for the bodies
+	// optimized later. For Optimizer.
+	struct InlineCandidate {
+		std::shared_ptr<const std::vector<StmtPtr>> body;
+		std::vector<Token> params;
+	};
+	std::map<std::string, InlineCandidate> inline_candidates;
+	// Arguments of the InlineCall being evaluated
+	const Object *inline_arguments = nullptr;
+
+	EventLoop tasks;
+	ValueStack value_stack;
+	GarbageCollector garbage_collector{globals, tasks, value_stack};
+	bool optimizer_enabled = false;
+	Engine engine = Engine::Tree;
+	ClosureCompiler closure_compiler{*this};
+	bool jit_enabled = false;
+	Jit jit;
+	Stats stats;
+	std::unique_ptr<Profiler> sampling_profiler;
+	std::unique_ptr<Tracer> own_tracer;
+	std::unique_ptr<AllocationProfiler> allocations;
+	std::unique_ptr<Memoizer> memo_cache;
+	Tracer *event_tracer = nullptr;
+	// Lox function calls being made, for Tracer::CallSpan
+	unsigned traced_call_depth = 0;
+
+	unsigned actor_threads = 0;
+	Actor *actor = nullptr;
+	ActorScheduler *scheduler = nullptr;
+	// Set for the interpreter which spawned the first actor, destroyed
+	// first so that the actors are done before anything else is.
+	std::unique_ptr<ActorScheduler> own_scheduler;
 };
 
 #endif
@@ -0,0 +1,719 @@
+#include <bit>
+#include <cstdint>
+#include <cstring>
+#include <format>
+#include <functional>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <variant>
+#include <vector>
+
+#if defined(__x86_64__) && defined(__linux__)
+#define LOX_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#endif
+
+#include "token_type.hxx"
+#include "token.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "numeric.hxx"
+#include "stats.hxx"
+#include "jit.hxx"
+#include "object/object.hxx"
+
+using enum TokenType;
+using std::uint8_t;
+
+// Assembler
+//---------------------------------------------------------
+
+// Emits the few x86-64 instructions the JIT needs. The value being computed
+// is always in xmm0, the left operand of a binary operation is pushed on the
+// machine stack while the right one is computed. rdi points to the slots
+// and rsi to the status.
+class Assembler
+{
+public:
+	// Jump target, the jumps to it are patched when it is bound
+	struct Label {
+		std::optional<std::size_t> position;
+		std::vector<std::size_t> uses;
+	};
+
+	// Condition codes of the jcc instructions, after ucomisd.
+	// Unordered operands (NaN) set ZF, PF and CF.
+	enum Condition : uint8_t {
+		Below = 0x82,
+		AboveEqual = 0x83,
+		Equal = 0x84,
+		NotEqual = 0x85,
+		BelowEqual = 0x86,
+		Above = 0x87,
+		Parity = 0x8a,
+	};
+
+	// movsd xmm0, [rdi + 8 * slot]
+	void load(unsigned slot) { emit_slot({0xf2, 0x0f, 0x10, 0x87}, slot); }
+
+	// movsd [rdi + 8 * slot], xmm0
+	void store(unsigned slot) { emit_slot({0xf2, 0x0f, 0x11, 0x87}, slot); }
+
+	void load_constant(double value)
+	{
+		// mov rax, imm64
+		emit({0x48, 0xb8});
+		emit_u64(std::bit_cast<std::uint64_t>(value));
+		// movq xmm0, rax
+		emit({0x66, 0x48, 0x0f, 0x6e, 0xc0});
+	}
+
+	void push()
+	{
+		// sub rsp, 8; movsd [rsp], xmm0
+		emit({0x48, 0x83, 0xec, 0x08});
+		emit({0xf2, 0x0f, 0x11, 0x04, 0x24});
+	}
+
+	// Moves the right operand to xmm1 and pops the left one into xmm0
+	void pop_left()
+	{
+		// movapd xmm1, xmm0; movsd xmm0, [rsp]; add rsp, 8
+		emit({0x66, 0x0f, 0x28, 0xc8});
+		emit({0xf2, 0x0f, 0x10, 0x04, 0x24});
+		emit({0x48, 0x83, 0xc4, 0x08});
+	}
+
+	// xmm0 = xmm0 op xmm1
+	void arithmetic(TokenType type)
+	{
+		static const std::map<TokenType, uint8_t> opcodes = {
+			{PLUS, 0x58},
+			{MINUS, 0x5c},
+			{STAR, 0x59},
+			{SLASH, 0x5e},
+		};
+		emit({0xf2, 0x0f, opcodes.at(type), 0xc1});
+	}
+
+	void negate()
+	{
+		// mov rax, sign bit; movq xmm1, rax; xorpd xmm0, xmm1
+		emit({0x48, 0xb8});
+		emit_u64(std::uint64_t(1) << 63);
+		emit({0x66, 0x48, 0x0f, 0x6e, 0xc8});
+		emit({0x66, 0x0f, 0x57, 0xc1});
+	}
+
+	// ucomisd xmm0, xmm1 or ucomisd xmm1, xmm0 if swapped
+	void compare(bool swapped)
+	{
+		emit({0x66, 0x0f, 0x2e, uint8_t(swapped ? 0xc8 : 0xc1)});
+	}
+
+	void jump(Label &label)
+	{
+		emit({0xe9});
+		emit_target(label);
+	}
+
+	void jump_if(Condition condition, Label &label)
+	{
+		emit({0x0f, condition});
+		emit_target(label);
+	}
+
+	void bind(Label &label)
+	{
+		label.position = code.size();
+		for (auto use : label.uses)
+			patch(use, *label.position);
+		label.uses.clear();
+	}
+
+	// mov dword [rsi], status; ret
+	void return_with(std::int32_t status)
+	{
+		emit({0xc7, 0x06});
+		emit_u32(status);
+		emit({0xc3});
+	}
+
+	std::vector<uint8_t> code;
+
+private:
+	void emit(std::initializer_list<uint8_t> bytes)
+	{
+		code.insert(code.end(), bytes);
+	}
+
+	void emit_u32(std::uint32_t value)
+	{
+		for (int i = 0; i < 4; ++i)
+			code.push_back(value >> (8 * i));
+	}
+
+	void emit_u64(std::uint64_t value)
+	{
+		for (int i = 0; i < 8; ++i)
+			code.push_back(value >> (8 * i));
+	}
+
+	void emit_slot(std::initializer_list<uint8_t> opcode, unsigned slot)
+	{
+		emit(opcode);
+		emit_u32(8 * slot);
+	}
+
+	// Emits a rel32 jump offset to the label
+	void emit_target(Label &label)
+	{
+		auto use = code.size();
+		emit_u32(0);
+		if (label.position)
+			patch(use, *label.position);
+		else
+			label.uses.push_back(use);
+	}
+
+	void patch(std::size_t use, std::size_t target)
+	{
+		std::uint32_t offset = target - (use + 4);
+		std::memcpy(&code[use], &offset, sizeof(offset));
+	}
+};
+
+// Compiler
+//---------------------------------------------------------
+
+// Thrown for code which the JIT cannot compile
+struct Unsupported {
+	std::string reason;
+};
+
+class JitCompiler : private StmtVisitor, private ExprVisitor
+{
+public:
+	// Throws Unsupported if the function cannot be compiled.
+	std::unique_ptr<JitCode> compile(const Function &function)
+	{
+		scopes.emplace_back();
+		for (auto &param : function.params)
+			declare(param.lexeme);
+
+		for (auto &stmt : *function.body)
+			stmt->accept(*this);
+		// Falling off the end returns nil
+		assembler.return_with(1);
+
+		return std::make_unique<JitCode>(assembler.code, slot_count);
+	}
+
+	void visit_block_stmt(const Block &stmt) override
+	{
+		scopes.emplace_back();
+		for (auto &statement : stmt.statements)
+			statement->accept(*this);
+		scopes.pop_back();
+	}
+
+	void visit_expr_stmt(const Expression &stmt) override
+	{
+		number(*stmt.expression);
+	}
+
+	void visit_print_stmt(const Print &) override { unsupported("print"); }
+
+	void visit_assert_stmt(const Assert &) override { unsupported("assert"); }
+
+	void visit_break_stmt(const Break &) override
+	{
+		assembler.jump(*loops.back().end);
+	}
+
+	void visit_continue_stmt(const Continue &) override
+	{
+		assembler.jump(*loops.back().next);
+	}
+
+	void visit_return_stmt(const Return &stmt) override
+	{
+		if (stmt.value == nullptr) {
+			assembler.return_with(1);
+			return;
+		}
+
+		number(*stmt.value);
+		assembler.return_with(0);
+	}
+
+	void visit_if_stmt(const If &stmt) override
+	{
+		Assembler::Label else_branch, end;
+
+		branch(*stmt.condition, false, else_branch);
+		stmt.then_branch->accept(*this);
+		if (stmt.else_branch != nullptr)
+			assembler.jump(end);
+
+		assembler.bind(else_branch);
+		if (stmt.else_branch != nullptr)
+			stmt.else_branch->accept(*this);
+		assembler.bind(end);
+	}
+
+	void visit_while_stmt(const While &stmt) override
+	{
+		Assembler::Label start, next, end;
+
+		assembler.bind(start);
+		branch(*stmt.condition, false, end);
+
+		loops.push_back({&next, &end});
+		stmt.body->accept(*this);
+		loops.pop_back();
+
+		assembler.bind(next);
+		if (stmt.for_update != nullptr)
+			number(*stmt.for_update);
+		assembler.jump(start);
+		assembler.bind(end);
+	}
+
+	void visit_var_stmt(const Var &stmt) override
+	{
+		number(*stmt.initializer);
+		assembler.store(declare(stmt.name.lexeme));
+	}
+
+	void visit_function_stmt(const Function &) override
+	{
+		unsupported("nested function");
+	}
+
+	void visit_class_stmt(const Class &) override { unsupported("class"); }
+
+	Object visit_assign_expr(const Assign &expr) override
+	{
+		number(*expr.expression);
+		assembler.store(find(expr.name.lexeme));
+		return nullptr;
+	}
+
+	Object visit_ternary_expr(const Ternary &) override
+	{
+		return unsupported("ternary");
+	}
+
+	Object visit_logical_expr(const Logical &) override
+	{
+		return unsupported("logical operator outside a condition");
+	}
+
+	Object visit_binary_expr(const Binary &expr) override
+	{
+		switch (expr.operat.type) {
+		case PLUS:
+		case MINUS:
+		case STAR:
+		case SLASH:
+			break;
+		default:
+			return unsupported("comparison outside a condition");
+		}
+
+		number(*expr.left);
+		assembler.push();
+		number(*expr.right);
+		assembler.pop_left();
+		assembler.arithmetic(expr.operat.type);
+		return nullptr;
+	}
+
+	Object visit_call_expr(const Call &) override { return unsupported("call"); }
+
+	Object visit_get_expr(const Get &) override
+	{
+		return unsupported("property");
+	}
+
+	Object visit_set_expr(const Set &) override
+	{
+		return unsupported("property");
+	}
+
+	Object visit_list_literal_expr(const ListLiteral &) override
+	{
+		return unsupported("list");
+	}
+
+	Object visit_map_literal_expr(const MapLiteral &) override
+	{
+		return unsupported("map");
+	}
+
+	Object visit_subscript_expr(const Subscript &) override
+	{
+		return unsupported("subscript");
+	}
+
+	Object visit_subscript_set_expr(const SubscriptSet &) override
+	{
+		return unsupported("subscript");
+	}
+
+	Object visit_yield_expr(const Yield &) override
+	{
+		return unsupported("yield");
+	}
+
+	Object visit_super_expr(const Super &) override
+	{
+		return unsupported("super");
+	}
+
+	Object visit_this_expr(const This &) override
+	{
+		return unsupported("this");
+	}
+
+	Object visit_grouping_expr(const Grouping &expr) override
+	{
+		number(*expr.expression);
+		return nullptr;
+	}
+
+	Object visit_literal_expr(const Literal &expr) override
+	{
+		if (!match_types<double>(expr.value))
+			return unsupported("literal which is not a number");
+
+		assembler.load_constant(std::get<double>(expr.value));
+		return nullptr;
+	}
+
+	Object visit_unary_expr(const Unary &expr) override
+	{
+		if (expr.operat.type == BANG)
+			return unsupported("'!'");
+
+		number(*expr.right);
+		if (expr.operat.type == MINUS)
+			assembler.negate();
+		return nullptr;
+	}
+
+	Object visit_variable_expr(const Variable &expr) override
+	{
+		assembler.load(find(expr.name.lexeme));
+		return nullptr;
+	}
+
+	Object visit_inline_call_expr(const InlineCall &) override
+	{
+		return unsupported("call");
+	}
+
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		return unsupported("call");
+	}
+
+	Object visit_numeric_expr(const Numeric &expr) override
+	{
+		number(*expr.expression);
+		return nullptr;
+	}
+
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return unsupported("comparison outside a condition");
+	}
+
+private:
+	struct Loop {
+		Assembler::Label *next;
+		Assembler::Label *end;
+	};
+
+	[[noreturn]] Object unsupported(std::string_view what)
+	{
+		throw Unsupported(std::format("uses {}", what));
+	}
+
+	unsigned declare(const std::string &name)
+	{
+		scopes.back()[name] = slot_count;
+		return slot_count++;
+	}
+
+	unsigned find(const std::string &name)
+	{
+		for (auto iter = scopes.crbegin(); iter != scopes.crend(); ++iter) {
+			if (auto result = iter->find(name); result != iter->end())
+				return result->second;
+		}
+
+		throw Unsupported(std::format("uses the non-local '{}'", name));
+	}
+
+	// Computes a number into xmm0
+	void number(const Expr &expr) { expr.accept(*this); }
+
+	// Same for the trees made by TypeInference
+	void number(const NumberExpr &expr)
+	{
+		if (auto literal = dynamic_cast<const NumberLiteral *>(&expr)) {
+			assembler.load_constant(literal->value);
+		} else if (auto variable = dynamic_cast<const NumberVariable *>(&expr)) {
+			assembler.load(find(variable->name));
+		} else if (auto assign = dynamic_cast<const NumberAssign *>(&expr)) {
+			number(*assign->value);
+			assembler.store(find(assign->name.lexeme));
+		} else if (auto negate = dynamic_cast<const NumberNegate *>(&expr)) {
+			number(*negate->right);
+			assembler.negate();
+		} else if (!number_binary<std::plus<double>>(expr, PLUS)
+				   && !number_binary<std::minus<double>>(expr, MINUS)
+				   && !number_binary<std::multiplies<double>>(expr, STAR)
+				   && !number_binary<std::divides<double>>(expr, SLASH)) {
+			unsupported("unknown numeric expression");
+		}
+	}
+
+	template <typename Op>
+	bool number_binary(const NumberExpr &expr, TokenType type)
+	{
+		auto binary = dynamic_cast<const NumberBinary<Op> *>(&expr);
+		if (binary == nullptr)
+			return false;
+
+		number(*binary->left);
+		assembler.push();
+		number(*binary->right);
+		assembler.pop_left();
+		assembler.arithmetic(type);
+		return true;
+	}
+
+	// Jumps to the label if the condition is equal to 'when'
+	void branch(const Expr &expr, bool when, Assembler::Label &label)
+	{
+		if (auto grouping = dynamic_cast<const Grouping *>(&expr)) {
+			branch(*grouping->expression, when, label);
+			return;
+		}
+
+		if (auto literal = dynamic_cast<const Literal *>(&expr)) {
+			if (!match_types<bool>(literal->value))
+				unsupported("condition which is not a comparison");
+			if (std::get<bool>(literal->value) == when)
+				assembler.jump(label);
+			return;
+		}
+
+		if (auto logical = dynamic_cast<const Logical *>(&expr)) {
+			// Short circuits when the left operand is equal to this
+			bool deciding = logical->operat.type == OR;
+			if (deciding == when) {
+				branch(*logical->left, when, label);
+				branch(*logical->right, when, label);
+			} else {
+				Assembler::Label skip;
+				branch(*logical->left, deciding, skip);
+				branch(*logical->right, when, label);
+				assembler.bind(skip);
+			}
+			return;
+		}
+
+		if (auto binary = dynamic_cast<const Binary *>(&expr)) {
+			number(*binary->left);
+			assembler.push();
+			number(*binary->right);
+			assembler.pop_left();
+			compare(binary->operat.type, when, label);
+			return;
+		}
+
+		if (auto numeric = dynamic_cast<const NumericCondition *>(&expr)) {
+			if (number_comparison<std::greater<double>>(*numeric, GREATER, when, label)
+				|| number_comparison<std::greater_equal<double>>(*numeric, GREATER_EQUAL, when, label)
+				|| number_comparison<std::less<double>>(*numeric, LESS, when, label)
+				|| number_comparison<std::less_equal<double>>(*numeric, LESS_EQUAL, when, label)
+				|| number_comparison<std::equal_to<double>>(*numeric, EQUAL_EQUAL, when, label)
+				|| number_comparison<std::not_equal_to<double>>(*numeric, BANG_EQUAL, when, label))
+				return;
+		}
+
+		unsupported("condition which is not a comparison");
+	}
+
+	template <typename Op>
+	bool number_comparison(
+		const NumericCondition &expr, TokenType type, bool when,
+		Assembler::Label &label
+	)
+	{
+		auto comparison =
+			dynamic_cast<const NumberComparison<Op> *>(expr.condition.get());
+		if (comparison == nullptr)
+			return false;
+
+		number(*comparison->left);
+		assembler.push();
+		number(*comparison->right);
+		assembler.pop_left();
+		compare(type, when, label);
+		return true;
+	}
+
+	// Compares xmm0 with xmm1 and jumps to the label if the result is 'when'.
+	// Comparisons with NaN are false, except for '!='.
+	void compare(TokenType type, bool when, Assembler::Label &label)
+	{
+		using enum Assembler::Condition;
+
+		switch (type) {
+		case LESS:
+			assembler.compare(true);
+			assembler.jump_if(when ? Above : BelowEqual, label);
+			break;
+		case LESS_EQUAL:
+			assembler.compare(true);
+			assembler.jump_if(when ? AboveEqual : Below, label);
+			break;
+		case GREATER:
+			assembler.compare(false);
+			assembler.jump_if(when ? Above : BelowEqual, label);
+			break;
+		case GREATER_EQUAL:
+			assembler.compare(false);
+			assembler.jump_if(when ? AboveEqual : Below, label);
+			break;
+
+		case EQUAL_EQUAL:
+		case BANG_EQUAL: {
+			assembler.compare(false);
+			// Equal is ZF set and PF clear
+			if ((type == EQUAL_EQUAL) == when) {
+				Assembler::Label skip;
+				assembler.jump_if(Parity, skip);
+				assembler.jump_if(Equal, label);
+				assembler.bind(skip);
+			} else {
+				assembler.jump_if(NotEqual, label);
+				assembler.jump_if(Parity, label);
+			}
+			break;
+		}
+
+		default:
+			unsupported("condition which is not a comparison");
+		}
+	}
+
+	Assembler assembler;
+	std::vector<std::map<std::string, unsigned>> scopes;
+	std::vector<Loop> loops;
+	unsigned slot_count = 0;
+};
+
+// JitCode methods
+//---------------------------------------------------------
+
+JitCode::JitCode(const std::vector<uint8_t> &code, unsigned slot_count_)
+	: size(code.size())
+	, slot_count(slot_count_)
+{
+#ifdef LOX_JIT_SUPPORTED
+	// Written first, then made executable, never both at once
+	memory = mmap(
+		nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0
+	);
+	if (memory == MAP_FAILED)
+		throw Unsupported("cannot allocate executable memory");
+
+	std::memcpy(memory, code.data(), size);
+	if (mprotect(memory, size, PROT_READ | PROT_EXEC) != 0) {
+		munmap(memory, size);
+		throw Unsupported("cannot allocate executable memory");
+	}
+#else
+	throw Unsupported("not supported on this platform");
+#endif
+}
+
+JitCode::~JitCode()
+{
+#ifdef LOX_JIT_SUPPORTED
+	munmap(memory, size);
+#endif
+}
+
+Object JitCode::run(std::vector<double> &slots) const
+{
+	using Code = double (*)(double *, int *);
+
+	int status = 0;
+	double result = reinterpret_cast<Code>(memory)(slots.data(), &status);
+	if (status != 0)
+		return nullptr;
+	return result;
+}
+
+// Jit interface methods
+//---------------------------------------------------------
+
+std::optional<Object> Jit::call(
+	const Function &function, std::span<const Object> arguments,
+	Stats &stats
+)
+{
+	auto &entry = entries[function.body.get()];
+	if (entry.source.expired()) {
+		entry = {};
+		entry.source = function.body;
+	}
+
+	if (++entry.calls == threshold) {
+		try {
+			entry.code = JitCompiler().compile(function);
+			stats.jit_compiled++;
+			if (dump) {
+				std::cerr << std::format(
+					"jit: compiled '{}', {} bytes, {} slots\n",
+					function.name.lexeme, entry.code->size,
+					entry.code->slot_count
+				);
+			}
+		} catch (Unsupported &err) {
+			if (dump) {
+				std::cerr << std::format(
+					"jit: not compiled '{}', {}\n", function.name.lexeme,
+					err.reason
+				);
+			}
+		}
+	}
+
+	if (entry.code == nullptr)
+		return std::nullopt;
+
+	// Guard: the compiled code only works on numbers
+	slots.resize(entry.code->slot_count);
+	for (std::size_t i = 0; i < arguments.size(); ++i) {
+		auto number = std::get_if<double>(&arguments[i]);
+		if (number == nullptr) {
+			stats.jit_guard_fallbacks++;
+			return std::nullopt;
+		}
+		slots[i] = *number;
+	}
+
+	stats.jit_calls++;
+	return entry.code->run(slots);
+}
@@ -0,0 +1,76 @@
+#ifndef JIT_HXX_INCLUDED
+#define JIT_HXX_INCLUDED
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <optional>
+#include <span>
+#include <vector>
+
+#include "stmt.hxx"
+#include "stats.hxx"
+#include "object/object.hxx"
+
+// Machine code of a compiled function in executable memory.
+// It is called as: double code(double *slots, int *status)
+// The parameters are passed in the first slots, the rest are for the locals.
+// Status is set to 0 if a number is returned and to 1 if nil is returned.
+class JitCode
+{
+public:
+	JitCode(const std::vector<std::uint8_t> &code, unsigned slot_count_);
+	JitCode(const JitCode &) = delete;
+	JitCode &operator=(const JitCode &) = delete;
+	~JitCode();
+
+	Object run(std::vector<double> &slots) const;
+
+	const std::size_t size;
+	const unsigned slot_count;
+
+private:
+	void *memory = nullptr;
+};
+
+// Baseline JIT compiling hot numeric functions to x86-64 machine code,
+// only available on x86-64 Linux.
+//
+// Only self-contained numeric functions are compiled: their parameters and
+// local variables only ever hold numbers and their body uses nothing but
+// number literals, arithmetic, comparisons and 'and'/'or' in conditions,
+// 'var', assignments, 'if', loops, 'break', 'continue' and 'return'.
+// No calls, globals, closures or values of other types. Code like that can
+// not fail once the arguments are numbers, which is checked for each call;
+// the Interpreter runs the call if they are not.
+class Jit
+{
+public:
+	/// Compile a function after this many calls
+	unsigned threshold = 100;
+	/// Report each function compiled, or why it was not, to std::cerr
+	bool dump = false;
+
+	/// Counts a call of the function and compiles it if it gets hot.
+	/// Runs it and returns the result if it is compiled and the arguments
+	/// are numbers, otherwise returns nothing.
+	std::optional<Object> call(
+		const Function &function, std::span<const Object> arguments,
+		Stats &stats
+	);
+
+private:
+	struct Entry {
+		// Only weakly held, as an address may be reused after it is freed
+		std::weak_ptr<const std::vector<StmtPtr>> source;
+		unsigned calls = 0;
+		std::unique_ptr<JitCode> code;
+	};
+
+	std::map<const std::vector<StmtPtr> *, Entry> entries;
+	// Reused for every call, compiled code never calls back into Lox.
+	std::vector<double> slots;
+};
+
+#endif
@@ -0,0 +1,135 @@
+#include <cassert>
+#include <chrono>
+#include <format>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "liblox.hxx"
+#include "runtime_error.hxx"
+#include "token.hxx"
+#include "token_type.hxx"
+#include "scanner.hxx"
+#include "parser.hxx"
+#include "resolver.hxx"
+#include "optimizer.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+#include "object/native.hxx"
+
+Lox::Lox(const Options &options_, std::ostream &out)
+	: options(options_)
+	, interpreter(out)
+	, errors(interpreter.error_reporter())
+{
+	interpreter.output_sink().set_capacity(options.output_buffer);
+	interpreter.set_actor_threads(options.actor_threads);
+	if (options.profile_rate != 0)
+		interpreter.enable_profiler(options.profile_rate);
+	if (options.trace) {
+		interpreter.enable_tracer(
+			std::chrono::microseconds(options.trace_call_threshold)
+		);
+	}
+	if (options.allocation_sample != 0)
+		interpreter.enable_allocation_profiler(options.allocation_sample);
+	interpreter.enable_optimizer(options.optimize);
+	interpreter.use_engine(options.engine);
+	if (options.jit)
+		interpreter.enable_jit(options.jit_threshold, options.jit_dump);
+	if (options.memoize_capacity != 0)
+		interpreter.enable_memoizer(options.memoize_capacity);
+}
+
+ScriptPtr Lox::compile(std::string_view source)
+{
+	// Only report the errors of this source
+	bool had_error = std::exchange(errors.had_error, false);
+
+	auto tracer = interpreter.tracer();
+
+	std::vector<Token> tokens;
+	{
+		Tracer::Span span(tracer, "compile", "Scanner::scan_tokens");
+		Scanner scanner(source, errors);
+		tokens = scanner.scan_tokens();
+	}
+
+	std::vector<StmtPtr> statements;
+	{
+		Tracer::Span span(tracer, "compile", "Parser::parse");
+		Parser parser(std::move(tokens), errors, options.lazy_parse);
+		statements = parser.parse();
+	}
+
+	if (!errors.had_error) {
+		Tracer::Span span(tracer, "compile", "Resolver::resolve");
+		Resolver resolver(interpreter, errors);
+		resolver.resolve(statements);
+	}
+
+	if (!errors.had_error && options.optimize) {
+		Tracer::Span span(tracer, "compile", "Optimizer::optimize_program");
+		Optimizer optimizer(interpreter);
+		optimizer.optimize_program(statements);
+	}
+
+	if (errors.had_error)
+		return nullptr;
+
+	errors.had_error = had_error;
+	return ScriptPtr(new Script(*this, std::move(statements)));
+}
+
+bool Lox::run(const Script &script)
+{
+	assert(&script.owner == this);
+
+	// Only check for the errors of this run
+	bool had_runtime_error = std::exchange(errors.had_runtime_error, false);
+	interpreter.interpret(script.statements);
+
+	bool failed = errors.had_runtime_error;
+	errors.had_runtime_error = had_runtime_error || failed;
+	return !failed;
+}
+
+bool Lox::run(std::string_view source)
+{
+	auto script = compile(source);
+	return script != nullptr && run(*script);
+}
+
+void Lox::define_native(
+	const std::string &name, unsigned arity, HostFunction::Body function
+)
+{
+	interpreter.define_global(
+		name, std::make_shared<HostFunction>(name, arity, std::move(function))
+	);
+}
+
+std::optional<Object> Lox::get_global(const std::string &name)
+{
+	if (auto value = interpreter.find_global(name))
+		return *value;
+	return std::nullopt;
+}
+
+std::optional<Object>
+Lox::call(const std::string &name, std::vector<Object> arguments)
+{
+	auto callee = interpreter.find_global(name);
+	if (callee == nullptr) {
+		errors.print_runtime_error(RuntimeError(
+			Token(TokenType::IDENTIFIER, name, nullptr, 0),
+			std::format("Undefined variable '{}'.", name)
+		));
+		return std::nullopt;
+	}
+
+	return interpreter.call_value(*callee, name, std::move(arguments));
+}
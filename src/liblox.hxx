@@ -0,0 +1,154 @@
+#ifndef LIBLOX_HXX_INCLUDED
+#define LIBLOX_HXX_INCLUDED
+
+#include <cstddef>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "stmt.hxx"
+#include "stats.hxx"
+#include "profiler.hxx"
+#include "tracer.hxx"
+#include "output.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+#include "object/native.hxx"
+
+class Lox;
+
+// A program compiled by Lox::compile, it can be run any number of times by
+// the Lox which compiled it.
+class Script
+{
+	friend class Lox;
+
+public:
+	Script(const Script &) = delete;
+	Script &operator=(const Script &) = delete;
+
+private:
+	Script(const Lox &owner_, std::vector<StmtPtr> statements_)
+		: owner(owner_)
+		, statements(std::move(statements_))
+	{
+	}
+
+	const Lox &owner;
+	std::vector<StmtPtr> statements;
+};
+
+using ScriptPtr = std::shared_ptr<const Script>;
+
+// The embedding API, built as the liblox library.
+//
+// Each Lox is an interpreter with its own globals, output and errors. Errors
+// are written to its output, like the lox executable does, and remembered
+// until reset_errors is called.
+//
+// Values returned to the host are not roots for the garbage collector:
+// a function is only kept working while it is reachable from the globals.
+class Lox
+{
+public:
+	struct Options {
+		// Pre-parse function bodies and compile them on the first call
+		bool lazy_parse = false;
+		// Run the AST optimizer after resolving
+		bool optimize = false;
+		Interpreter::Engine engine = Interpreter::Engine::Tree;
+		// Compile hot numeric functions to machine code
+		bool jit = false;
+		unsigned jit_threshold = 100;
+		bool jit_dump = false;
+		// Bytes of output buffered before writing it out
+		std::size_t output_buffer = OutputSink::DEFAULT_CAPACITY;
+		// Threads running the actors spawned, the number of cores if 0
+		unsigned actor_threads = 0;
+		// Samples per second of the Profiler, 0 to not profile
+		unsigned profile_rate = 0;
+		// Record the compiler phases, the run and the garbage collections
+		bool trace = false;
+		// Also record the calls from the top level lasting this long, in
+		// microseconds, if not 0
+		unsigned trace_call_threshold = 0;
+		// Record one in this many objects created on average, see
+		// AllocationProfiler, 0 to not profile them
+		unsigned allocation_sample = 0;
+		// Results of the calls of pure functions cached, see Memoizer, 0
+		// to not memoize
+		std::size_t memoize_capacity = 0;
+	};
+
+	/// Print statements and errors write to out.
+	Lox(const Options &options_, std::ostream &out = std::cout);
+	Lox()
+		: Lox(Options())
+	{
+	}
+
+	Lox(const Lox &) = delete;
+	Lox &operator=(const Lox &) = delete;
+	~Lox() { flush(); }
+
+	/// Scans, parses, resolves and optimizes the source.
+	/// Returns nullptr if it has errors.
+	ScriptPtr compile(std::string_view source);
+
+	/// Runs a script compiled by this Lox, returns false on a runtime error.
+	bool run(const Script &script);
+
+	/// Compiles and runs the source, returns false if it has any errors.
+	bool run(std::string_view source);
+
+	/// Defines a global native function. It can report a runtime error by
+	/// throwing a NativeFnError.
+	void define_native(
+		const std::string &name, unsigned arity, HostFunction::Body function
+	);
+
+	void define_global(const std::string &name, const Object &value)
+	{
+		interpreter.define_global(name, value);
+	}
+
+	/// Returns nothing if there is no such global.
+	std::optional<Object> get_global(const std::string &name);
+
+	/// Calls the function or class stored in the global.
+	/// Returns nothing if it fails with a runtime error.
+	std::optional<Object>
+	call(const std::string &name, std::vector<Object> arguments = {});
+
+	/// Whether any errors were reported since the last reset_errors.
+	bool had_error() const { return errors.had_error; }
+	bool had_runtime_error() const { return errors.had_runtime_error; }
+	void reset_errors() { errors.reset(); }
+
+	/// Writes out the output buffered.
+	void flush() { interpreter.output_sink().flush(); }
+
+	const Stats &statistics() const { return interpreter.statistics(); }
+
+	/// nullptr unless Options::profile_rate is set.
+	Profiler *profiler() { return interpreter.profiler(); }
+
+	/// nullptr unless Options::trace is set.
+	Tracer *tracer() { return interpreter.tracer(); }
+
+	/// nullptr unless Options::allocation_sample is set.
+	AllocationProfiler *allocation_profiler()
+	{
+		return interpreter.allocation_profiler();
+	}
+
+private:
+	Options options;
+	Interpreter interpreter;
+	ErrorReporter &errors;
+};
+
+#endif
@@ -1,55 +1,76 @@
+#include <charconv>
 #include <cstdlib>
 #include <iostream>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <sstream>
 #include <string>
 #include <string_view>
+#include <system_error>
 #include <vector>
 #include <utility>
 
-#include "error.hxx"
-#include "ast_printer.hxx"
-#include "scanner.hxx"
-#include "parser.hxx"
-#include "resolver.hxx"
+#include "liblox.hxx"
 #include "interpreter.hxx"
+#include "thread_pool.hxx"
 
 using std::cout;
 using std::string;
 using std::string_view;
 
-// Preserve the interpreter state, throughout the session
-static Interpreter interpreter;
+// Command line options
+struct Options {
+	Lox::Options lox;
+	// Print statistics at exit
+	bool stats = false;
+	// Threads running the files when several are given
+	unsigned jobs = 1;
+	// Where --profile writes the folded stacks, empty if not profiling
+	string profile_path;
+	unsigned profile_rate = 1000;
+	// Where --trace writes the events, empty if not tracing
+	string trace_path;
+};
 
-// Interpreter entry: Runs the lox-script!
-void run_lox_interpreter(string_view source)
-{
-	Scanner scanner(source);
-	Parser parser(scanner.scan_tokens());
+static Options options;
 
-	auto statements = parser.parse();
+// bool is_expression_only(string_view line)
+// {
+// 	Scanner scanner(line);
+// 	auto tokens = scanner.scan_tokens();
+// }
 
-	// Is parsing errors
-	if (lox_had_error)
+// Reports the time spent in each function and writes the folded stacks
+void report_profile(Lox &lox)
+{
+	auto profiler = lox.profiler();
+	if (profiler == nullptr)
 		return;
 
-	Resolver resolver(interpreter);
-	resolver.resolve(statements);
+	profiler->stop();
+	profiler->report(std::cerr);
 
-	// If resolution errorsa
-	if (lox_had_error)
+	std::ofstream outfile(options.profile_path);
+	profiler->write_folded(outfile);
+	if (!outfile)
+		std::clog << "Cannot write file: " << options.profile_path << "\n";
+}
+
+// Writes the events traced
+void write_trace(Lox &lox)
+{
+	auto tracer = lox.tracer();
+	if (tracer == nullptr)
 		return;
 
-	interpreter.interpret(std::move(statements));
+	std::ofstream outfile(options.trace_path);
+	tracer->write_json(outfile);
+	if (!outfile)
+		std::clog << "Cannot write file: " << options.trace_path << "\n";
 }
 
-// bool is_expression_only(string_view line)
-// {
-// 	Scanner scanner(line);
-// 	auto tokens = scanner.scan_tokens();
-// }
-
-void run_prompt()
+void run_prompt(Lox &lox)
 {
 	for (string line;;) {
 		cout << "> ";
@@ -60,14 +81,21 @@ void run_prompt()
 		// If the user enters an expression then try to make that an
 		// expression statement and execute that, then print it's result
 
-		run_lox_interpreter(line);
-		lox_had_error = false;
-		lox_had_runtime_error = false;
+		lox.run(line);
+		lox.reset_errors();
+		lox.flush();
 		cout << '\n';
 	}
+
+	if (options.stats)
+		lox.statistics().report(std::cerr);
+	if (auto allocations = lox.allocation_profiler())
+		allocations->report(std::cerr);
+	report_profile(lox);
+	write_trace(lox);
 }
 
-void run_file(string path)
+void run_file(Lox &lox, string path)
 {
 	std::ifstream infile(path);
 	if (!infile) {
@@ -76,22 +104,219 @@ void run_file(string path)
 	}
 
 	string source(std::istreambuf_iterator<char>(infile), {});
-	run_lox_interpreter(source);
+	bool succeeded = lox.run(source);
+	lox.flush();
+
+	if (options.stats)
+		lox.statistics().report(std::cerr);
+	if (auto allocations = lox.allocation_profiler())
+		allocations->report(std::cerr);
+	report_profile(lox);
+	write_trace(lox);
 
-	if (lox_had_error || lox_had_runtime_error)
+	if (!succeeded)
 		std::exit(EXIT_FAILURE);
 }
 
-int main(int argc, char **argv)
+// What running one of several files produced
+struct JobResult {
+	std::string output;
+	// Written to std::cerr after the output
+	std::string log;
+	bool succeeded = false;
+};
+
+// Runs a file in a Lox of its own, it may be called from any thread.
+JobResult run_job(const string &path)
 {
-	if (argc == 1) {
-		run_prompt();
-	} else if (argc == 2) {
-		run_file(argv[1]);
-	} else {
-		cout << "Usage: " << argv[0] << " [filename]\n";
+	JobResult result;
+
+	std::ifstream infile(path);
+	if (!infile) {
+		result.log = "Cannot open file: " + path + "\n";
+		return result;
+	}
+
+	string source(std::istreambuf_iterator<char>(infile), {});
+	std::ostringstream output;
+	{
+		Lox lox(options.lox, output);
+		result.succeeded = lox.run(source);
+		lox.flush();
+
+		std::ostringstream log;
+		if (options.stats)
+			lox.statistics().report(log);
+		if (auto allocations = lox.allocation_profiler())
+			allocations->report(log);
+		result.log = std::move(log).str();
+	}
+
+	result.output = std::move(output).str();
+	return result;
+}
+
+// Runs each file in its own Lox, on options.jobs threads. The output of
+// each file is written out in the order of the files once it is done.
+void run_files(const std::vector<string> &files)
+{
+	ThreadPool pool(options.jobs);
+	std::vector<std::future<JobResult>> results;
+
+	for (auto &path : files) {
+		// A packaged_task can not be copied into a std::function
+		auto job = std::make_shared<std::packaged_task<JobResult()>>(
+			[&path] { return run_job(path); }
+		);
+		results.push_back(job->get_future());
+		pool.submit([job] { (*job)(); });
+	}
+
+	bool succeeded = true;
+	for (auto &future : results) {
+		auto result = future.get();
+		cout << result.output << std::flush;
+		std::cerr << result.log;
+		succeeded = succeeded && result.succeeded;
+	}
+
+	if (!succeeded)
 		std::exit(EXIT_FAILURE);
+}
+
+[[noreturn]] void print_usage(const char *program)
+{
+	cout << "Usage: " << program << " [options] [filename...]\n"
+		 << "Options:\n"
+		 << "  --lazy    Compile function bodies on their first call\n"
+		 << "  -O        Optimize the program before running it\n"
+		 << "  --stats   Print statistics at exit\n"
+		 << "  --engine=tree|closure\n"
+		 << "            Walk the AST or run it compiled to closures\n"
+		 << "  --jit     Compile hot numeric functions to machine code\n"
+		 << "  --jit-threshold=N\n"
+		 << "            Calls before a function is compiled, 100 by default\n"
+		 << "  --jit-dump\n"
+		 << "            Print the size of each function compiled\n"
+		 << "  --output-buffer=N\n"
+		 << "            Bytes of output buffered, 1 for none, 64 KiB by default\n"
+		 << "  --jobs=N  Run the files given on N threads, each in its own\n"
+		 << "            interpreter, 1 by default\n"
+		 << "  --actor-threads=N\n"
+		 << "            Threads running the actors spawned, one per core by default\n"
+		 << "  --profile[=FILE]\n"
+		 << "            Print the time spent in each function and write the\n"
+		 << "            stacks sampled to FILE, lox.folded by default\n"
+		 << "  --profile-rate=N\n"
+		 << "            Samples per second of CPU time, 1000 by default\n"
+		 << "  --trace=FILE\n"
+		 << "            Write a Chrome trace of the compiler phases, the run\n"
+		 << "            and the garbage collections to FILE\n"
+		 << "  --trace-calls=N\n"
+		 << "            Also trace the calls from the top level lasting N\n"
+		 << "            microseconds or more\n"
+		 << "  --alloc-profile[=N]\n"
+		 << "            Print the objects created on each line, recording\n"
+		 << "            one in N of them on average, all by default\n"
+		 << "  --memoize[=N]\n"
+		 << "            Cache the results of pure functions, up to N of\n"
+		 << "            them, 65536 by default\n";
+	std::exit(EXIT_FAILURE);
+}
+
+// Parses the number after '=' in an option like --name=N
+unsigned parse_count(string_view arg, const char *program)
+{
+	auto value = arg.substr(arg.find('=') + 1);
+	unsigned count = 0;
+	auto [end, error] =
+		std::from_chars(value.data(), value.data() + value.size(), count);
+	if (error != std::errc() || end != value.data() + value.size()
+		|| count == 0)
+		print_usage(program);
+	return count;
+}
+
+int main(int argc, char **argv)
+{
+	std::vector<string> files;
+	for (int i = 1; i < argc; ++i) {
+		string_view arg = argv[i];
+		if (arg == "--lazy")
+			options.lox.lazy_parse = true;
+		else if (arg == "-O")
+			options.lox.optimize = true;
+		else if (arg == "--stats")
+			options.stats = true;
+		else if (arg == "--engine=tree")
+			options.lox.engine = Interpreter::Engine::Tree;
+		else if (arg == "--engine=closure")
+			options.lox.engine = Interpreter::Engine::Closure;
+		else if (arg == "--jit")
+			options.lox.jit = true;
+		else if (arg.starts_with("--jit-threshold="))
+			options.lox.jit_threshold = parse_count(arg, argv[0]);
+		else if (arg == "--jit-dump")
+			options.lox.jit_dump = true;
+		else if (arg.starts_with("--output-buffer="))
+			options.lox.output_buffer = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--actor-threads="))
+			options.lox.actor_threads = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--jobs="))
+			options.jobs = parse_count(arg, argv[0]);
+		else if (arg == "--profile")
+			options.profile_path = "lox.folded";
+		else if (arg.starts_with("--profile="))
+			options.profile_path = arg.substr(arg.find('=') + 1);
+		else if (arg.starts_with("--profile-rate="))
+			options.profile_rate = parse_count(arg, argv[0]);
+		else if (arg.starts_with("--trace="))
+			options.trace_path = arg.substr(arg.find('=') + 1);
+		else if (arg.starts_with("--trace-calls="))
+			options.lox.trace_call_threshold = parse_count(arg, argv[0]);
+		else if (arg == "--alloc-profile")
+			options.lox.allocation_sample = 1;
+		else if (arg.starts_with("--alloc-profile="))
+			options.lox.allocation_sample = parse_count(arg, argv[0]);
+		else if (arg == "--memoize")
+			options.lox.memoize_capacity = 65536;
+		else if (arg.starts_with("--memoize="))
+			options.lox.memoize_capacity = parse_count(arg, argv[0]);
+		else if (arg.starts_with("-"))
+			print_usage(argv[0]);
+		else
+			files.emplace_back(arg);
+	}
+
+	if (!options.profile_path.empty()) {
+		// Only one thread can be profiled
+		if (files.size() > 1) {
+			std::clog << "Only a single file can be profiled.\n";
+			return EXIT_FAILURE;
+		}
+		options.lox.profile_rate = options.profile_rate;
 	}
 
+	if (!options.trace_path.empty()) {
+		if (files.size() > 1) {
+			std::clog << "Only a single file can be traced.\n";
+			return EXIT_FAILURE;
+		}
+		options.lox.trace = true;
+	}
+
+	if (files.size() > 1) {
+		run_files(files);
+		return 0;
+	}
+
+	// Preserve the interpreter state, throughout the session
+	Lox lox(options.lox);
+
+	if (files.empty())
+		run_prompt(lox);
+	else
+		run_file(lox, files[0]);
+
 	return 0;
 }
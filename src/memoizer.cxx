@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <span>
+#include <string>
+#include <unordered_set>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "token.hxx"
+#include "memoizer.hxx"
+#include "purity.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+#include "object/lox_callable.hxx"
+#include "object/lox_function.hxx"
+
+Memoizer::Memoizer(
+	const Interpreter &interpreter_, Stats &stats_, std::size_t capacity_
+)
+	: interpreter(interpreter_)
+	, stats(stats_)
+	, capacity(std::max<std::size_t>(capacity_, 1))
+{
+	results.reserve(capacity);
+	clock.reserve(capacity);
+}
+
+void Memoizer::clear()
+{
+	pure_functions.clear();
+	results.clear();
+	clock.clear();
+	hand = 0;
+}
+
+void Memoizer::begin(
+	Call &call, const LoxFunction &function, std::span<const Object> arguments
+)
+{
+	if (!is_pure(function))
+		return;
+
+	std::size_t hash = std::hash<const void *>()(&function);
+	for (auto &argument : arguments) {
+		if (!is_value(argument))
+			return;
+		hash ^= hash_value(argument) + 0x9e3779b9 + (hash << 6) + (hash >> 2);
+	}
+
+	auto entry = results.find(KeyView{&function, arguments, hash});
+	if (entry != results.end()) {
+		stats.memo_hits++;
+		entry->second.referenced = true;
+		call.result = &entry->second.result;
+		return;
+	}
+
+	stats.memo_misses++;
+	call.key = {&function, {arguments.begin(), arguments.end()}, hash};
+}
+
+void Memoizer::insert(Key key, const Object &result)
+{
+	if (!is_value(result) || results.contains(key))
+		return;
+
+	if (clock.size() < capacity) {
+		clock.push_back(&*results.emplace(std::move(key), Entry{result}).first);
+		return;
+	}
+
+	// Second chance for the results used since the hand last passed them
+	while (clock[hand]->second.referenced) {
+		clock[hand]->second.referenced = false;
+		hand = (hand + 1) % capacity;
+	}
+
+	results.erase(results.find(clock[hand]->first));
+	stats.memo_evictions++;
+	clock[hand] = &*results.emplace(std::move(key), Entry{result}).first;
+	hand = (hand + 1) % capacity;
+}
+
+bool Memoizer::is_pure(const LoxFunction &function)
+{
+	// Closures and methods are never memoized, they are not remembered
+	if (function.closure != interpreter.globals)
+		return false;
+
+	// Compiled by its first call, checked on the next one
+	auto &declaration = function.declaration;
+	if (declaration.lazy_body && !declaration.lazy_body->compiled)
+		return false;
+
+	auto [entry, inserted] = pure_functions.try_emplace(&function, false);
+	if (inserted) {
+		entry->second = analyse(function);
+		if (entry->second)
+			stats.memo_pure_functions++;
+	}
+	return entry->second;
+}
+
+bool Memoizer::analyse(const LoxFunction &function)
+{
+	// Its name must keep referring to it, a call by the name could be
+	// memoized otherwise, like with the functions it calls
+	if (global_function(function.declaration.name) != &function)
+		return false;
+
+	PurityAnalysis analysis(interpreter);
+	std::vector<const LoxFunction *> pending = {&function};
+	std::unordered_set<const LoxFunction *> seen = {&function};
+	std::vector<Token> callees;
+
+	while (!pending.empty()) {
+		auto next = pending.back();
+		pending.pop_back();
+
+		callees.clear();
+		if (!analysis.check(next->declaration, callees))
+			return false;
+
+		for (auto &name : callees) {
+			auto callee = global_function(name);
+			if (callee == nullptr)
+				return false;
+			if (seen.insert(callee).second)
+				pending.push_back(callee);
+		}
+	}
+
+	return true;
+}
+
+const LoxFunction *Memoizer::global_function(const Token &name) const
+{
+	// Declared once and never assigned to, so it holds this for good
+	auto writes = interpreter.global_writes.find(name.lexeme);
+	if (writes == interpreter.global_writes.end() || writes->second != 1)
+		return nullptr;
+
+	auto value = interpreter.globals->find(name.lexeme);
+	if (value == nullptr || !match_types<LoxCallablePtr>(*value))
+		return nullptr;
+
+	auto &callable = *std::get<LoxCallablePtr>(*value);
+	if (callable.kind != LoxCallable::Kind::Function)
+		return nullptr;
+
+	// Bodies are not compiled just to be checked
+	auto function = static_cast<const LoxFunction *>(&callable);
+	auto &declaration = function->declaration;
+	if (function->closure != interpreter.globals || function->is_initializer
+		|| (declaration.lazy_body && !declaration.lazy_body->compiled))
+		return nullptr;
+
+	return function;
+}
+
+bool Memoizer::is_value(const Object &object)
+{
+	return std::holds_alternative<std::nullptr_t>(object)
+		|| std::holds_alternative<bool>(object)
+		|| std::holds_alternative<double>(object)
+		|| std::holds_alternative<std::string>(object);
+}
+
+std::size_t Memoizer::hash_value(const Object &object)
+{
+	if (auto number = std::get_if<double>(&object)) {
+		auto bits = std::bit_cast<std::uint64_t>(*number);
+		return std::hash<std::uint64_t>()(bits);
+	}
+	if (auto string = std::get_if<std::string>(&object))
+		return std::hash<std::string>()(*string);
+	if (auto boolean = std::get_if<bool>(&object))
+		return *boolean ? 1 : 2;
+	return 0;
+}
+
+bool Memoizer::equal_arguments(
+	std::span<const Object> a, std::span<const Object> b
+)
+{
+	if (a.size() != b.size())
+		return false;
+
+	for (std::size_t i = 0; i < a.size(); ++i) {
+		// By their bits: -0 and 0 are told apart, NaN is equal to itself
+		auto x = std::get_if<double>(&a[i]);
+		auto y = std::get_if<double>(&b[i]);
+		if (x != nullptr && y != nullptr) {
+			if (std::bit_cast<std::uint64_t>(*x)
+				!= std::bit_cast<std::uint64_t>(*y))
+				return false;
+		} else if (a[i] != b[i]) {
+			return false;
+		}
+	}
+
+	return true;
+}
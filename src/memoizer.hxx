@@ -0,0 +1,148 @@
+#ifndef MEMOIZER_HXX_INCLUDED
+#define MEMOIZER_HXX_INCLUDED
+
+#include <cstddef>
+#include <optional>
+#include <span>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "token.hxx"
+#include "stats.hxx"
+#include "object/object.hxx"
+
+class Interpreter;
+class LoxFunction;
+
+// Caches the results of the calls of pure functions, enabled with
+// --memoize. A call made again with the same arguments returns the result
+// cached without running the function.
+//
+// Only functions declared in the globals by a 'fun' which is never assigned
+// to or declared again are memoized, if PurityAnalysis finds them and
+// every function they call to be pure. The arguments and the result must
+// be nil, booleans, numbers or strings: lists and other objects could be
+// changed after the call.
+//
+// At most capacity results are kept. When full, the CLOCK policy evicts a
+// result which was not used since the hand last passed it. Like the JIT,
+// each interpreter has its own, the actors do not memoize.
+class Memoizer
+{
+public:
+	Memoizer(
+		const Interpreter &interpreter_, Stats &stats_, std::size_t capacity_
+	);
+	Memoizer(const Memoizer &) = delete;
+	Memoizer &operator=(const Memoizer &) = delete;
+
+	/// Forgets the results and which functions are pure, for when a global
+	/// may be defined again.
+	void clear();
+
+	// A call being made, caches its result unless it was already
+	class Call
+	{
+	public:
+		Call(
+			Memoizer *memoizer_, const LoxFunction &function,
+			std::span<const Object> arguments
+		)
+			: memoizer(memoizer_)
+		{
+			if (memoizer != nullptr)
+				memoizer->begin(*this, function, arguments);
+		}
+
+		Call(const Call &) = delete;
+		Call &operator=(const Call &) = delete;
+
+		/// The result cached for the call, if there is one.
+		const Object *cached() const { return result; }
+
+		/// Caches the result of the call, which is returned.
+		Object remember(Object value)
+		{
+			if (key.function != nullptr)
+				memoizer->insert(std::move(key), value);
+			return value;
+		}
+
+	private:
+		friend class Memoizer;
+
+		Memoizer *memoizer;
+		const Object *result = nullptr;
+		// Set if the call is memoized and its result is not cached yet
+		struct Key {
+			const LoxFunction *function = nullptr;
+			std::vector<Object> arguments;
+			std::size_t hash = 0;
+		} key;
+	};
+
+private:
+	using Key = Call::Key;
+
+	// A call looked up, before its arguments are copied for the key
+	struct KeyView {
+		const LoxFunction *function;
+		std::span<const Object> arguments;
+		std::size_t hash;
+	};
+
+	struct KeyHash {
+		using is_transparent = void;
+		std::size_t operator()(const Key &key) const { return key.hash; }
+		std::size_t operator()(const KeyView &key) const { return key.hash; }
+	};
+
+	struct KeyEqual {
+		using is_transparent = void;
+		template <typename A, typename B>
+		bool operator()(const A &a, const B &b) const
+		{
+			return a.function == b.function
+				&& equal_arguments(a.arguments, b.arguments);
+		}
+	};
+
+	struct Entry {
+		Object result;
+		// Used since the hand of the clock last passed it
+		bool referenced = true;
+	};
+
+	using Table = std::unordered_map<Key, Entry, KeyHash, KeyEqual>;
+
+	void begin(
+		Call &call, const LoxFunction &function,
+		std::span<const Object> arguments
+	);
+	void insert(Key key, const Object &result);
+
+	bool is_pure(const LoxFunction &function);
+	// Checks the function and every function it calls, see PurityAnalysis
+	bool analyse(const LoxFunction &function);
+	// The function the global holds, if it is one which may be memoized
+	const LoxFunction *global_function(const Token &name) const;
+
+	// Nil, booleans, numbers and strings, these are compared by value
+	static bool is_value(const Object &object);
+	static std::size_t hash_value(const Object &object);
+	static bool
+	equal_arguments(std::span<const Object> a, std::span<const Object> b);
+
+	const Interpreter &interpreter;
+	Stats &stats;
+	std::size_t capacity;
+
+	std::unordered_map<const LoxFunction *, bool> pure_functions;
+	Table results;
+	// The entries in the order the hand of the clock passes them
+	std::vector<Table::value_type *> clock;
+	std::size_t hand = 0;
+};
+
+#endif
@@ -0,0 +1,164 @@
+#ifndef NUMERIC_HXX_INCLUDED
+#define NUMERIC_HXX_INCLUDED
+
+#include <functional>
+#include <memory>
+#include <string>
+#include <utility>
+#include <variant>
+
+#include "token.hxx"
+#include "expr.hxx"
+#include "environment.hxx"
+#include "object/object.hxx"
+
+// Expression trees proven by TypeInference to only ever operate on numbers.
+// They work on raw doubles, without the Object variant and its type checks.
+// Only local variables can be proven numeric, so an Environment is enough.
+
+struct NumberExpr;
+struct NumberCondition;
+
+using NumberExprPtr = std::unique_ptr<NumberExpr>;
+using NumberConditionPtr = std::unique_ptr<NumberCondition>;
+
+struct NumberExpr {
+	virtual double evaluate(Environment &env) const = 0;
+	virtual ~NumberExpr() = default;
+};
+
+struct NumberCondition {
+	virtual bool evaluate(Environment &env) const = 0;
+	virtual ~NumberCondition() = default;
+};
+
+struct NumberLiteral : public NumberExpr {
+	NumberLiteral(double value_)
+		: value(value_)
+	{
+	}
+
+	double evaluate(Environment &) const override { return value; }
+
+	const double value;
+};
+
+struct NumberVariable : public NumberExpr {
+	NumberVariable(const std::string &name_, int distance_)
+		: name(name_)
+		, distance(distance_)
+	{
+	}
+
+	double evaluate(Environment &env) const override
+	{
+		return std::get<double>(env.at(distance, name));
+	}
+
+	const std::string name;
+	const int distance;
+};
+
+struct NumberAssign : public NumberExpr {
+	NumberAssign(const Token &name_, int distance_, NumberExprPtr value_)
+		: name(name_)
+		, distance(distance_)
+		, value(std::move(value_))
+	{
+	}
+
+	double evaluate(Environment &env) const override
+	{
+		double result = value->evaluate(env);
+		env.assign_at(distance, name, result);
+		return result;
+	}
+
+	const Token name;
+	const int distance;
+	const NumberExprPtr value;
+};
+
+struct NumberNegate : public NumberExpr {
+	NumberNegate(NumberExprPtr right_)
+		: right(std::move(right_))
+	{
+	}
+
+	double evaluate(Environment &env) const override
+	{
+		return -right->evaluate(env);
+	}
+
+	const NumberExprPtr right;
+};
+
+// Op is one of the arithmetic function objects like std::plus<double>
+template <typename Op>
+struct NumberBinary : public NumberExpr {
+	NumberBinary(NumberExprPtr left_, NumberExprPtr right_)
+		: left(std::move(left_))
+		, right(std::move(right_))
+	{
+	}
+
+	double evaluate(Environment &env) const override
+	{
+		return Op{}(left->evaluate(env), right->evaluate(env));
+	}
+
+	const NumberExprPtr left;
+	const NumberExprPtr right;
+};
+
+// Op is one of the comparison function objects like std::less<double>
+template <typename Op>
+struct NumberComparison : public NumberCondition {
+	NumberComparison(NumberExprPtr left_, NumberExprPtr right_)
+		: left(std::move(left_))
+		, right(std::move(right_))
+	{
+	}
+
+	bool evaluate(Environment &env) const override
+	{
+		return Op{}(left->evaluate(env), right->evaluate(env));
+	}
+
+	const NumberExprPtr left;
+	const NumberExprPtr right;
+};
+
+// AST nodes holding the numeric trees, made by TypeInference.
+
+// A numeric expression, evaluates to a number.
+struct Numeric : public Expr {
+	Numeric(NumberExprPtr expression_)
+		: expression(std::move(expression_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_numeric_expr(*this);
+	}
+
+	NumberExprPtr expression;
+};
+
+// A comparison of two numeric expressions, evaluates to a boolean.
+struct NumericCondition : public Expr {
+	NumericCondition(NumberConditionPtr condition_)
+		: condition(std::move(condition_))
+	{
+	}
+
+	Object accept(ExprVisitor &visitor) const override
+	{
+		return visitor.visit_numeric_condition_expr(*this);
+	}
+
+	NumberConditionPtr condition;
+};
+
+#endif
@@ -0,0 +1,266 @@
+#include <cstddef>
+#include <limits>
+
+#include "float64_array.hxx"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#define LOX_AVX2_SUPPORTED 1
+#include <immintrin.h>
+#endif
+
+// Doubles in an AVX2 register, the scalar versions keep as many sums.
+constexpr std::size_t LANES = 4;
+constexpr double INF = std::numeric_limits<double>::infinity();
+
+// Helper functions
+//---------------------------------------------------------
+
+// Combines the running sums of the lanes
+static double add_lanes(const double (&lanes)[LANES])
+{
+	return (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+}
+
+static double min_of(double x, double min) { return x < min ? x : min; }
+
+static double max_of(double x, double max) { return x > max ? x : max; }
+
+// Scalar versions
+//---------------------------------------------------------
+
+static void
+add_scalar(double *out, const double *a, const double *b, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		out[i] = a[i] + b[i];
+}
+
+static void
+mul_scalar(double *out, const double *a, const double *b, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		out[i] = a[i] * b[i];
+}
+
+static void scale_scalar(double *out, const double *a, double k, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		out[i] = a[i] * k;
+}
+
+static void fill_scalar(double *out, double value, std::size_t n)
+{
+	for (std::size_t i = 0; i < n; ++i)
+		out[i] = value;
+}
+
+static double dot_scalar(const double *a, const double *b, std::size_t n)
+{
+	double lanes[LANES] = {};
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		for (std::size_t j = 0; j < LANES; ++j)
+			lanes[j] += a[i + j] * b[i + j];
+	}
+
+	auto result = add_lanes(lanes);
+	for (; i < n; ++i)
+		result += a[i] * b[i];
+	return result;
+}
+
+static double sum_scalar(const double *a, std::size_t n)
+{
+	double lanes[LANES] = {};
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		for (std::size_t j = 0; j < LANES; ++j)
+			lanes[j] += a[i + j];
+	}
+
+	auto result = add_lanes(lanes);
+	for (; i < n; ++i)
+		result += a[i];
+	return result;
+}
+
+static double min_scalar(const double *a, std::size_t n)
+{
+	auto result = INF;
+	for (std::size_t i = 0; i < n; ++i)
+		result = min_of(a[i], result);
+	return result;
+}
+
+static double max_scalar(const double *a, std::size_t n)
+{
+	auto result = -INF;
+	for (std::size_t i = 0; i < n; ++i)
+		result = max_of(a[i], result);
+	return result;
+}
+
+// AVX2 versions
+//---------------------------------------------------------
+
+#ifdef LOX_AVX2_SUPPORTED
+
+#define AVX2_FUNCTION __attribute__((target("avx2")))
+
+static bool has_avx2()
+{
+	static const bool supported = __builtin_cpu_supports("avx2");
+	return supported;
+}
+
+AVX2_FUNCTION static double add_lanes(__m256d sums)
+{
+	double lanes[LANES];
+	_mm256_storeu_pd(lanes, sums);
+	return add_lanes(lanes);
+}
+
+AVX2_FUNCTION static void
+add_avx2(double *out, const double *a, const double *b, std::size_t n)
+{
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		auto x = _mm256_loadu_pd(a + i);
+		auto y = _mm256_loadu_pd(b + i);
+		_mm256_storeu_pd(out + i, _mm256_add_pd(x, y));
+	}
+	add_scalar(out + i, a + i, b + i, n - i);
+}
+
+AVX2_FUNCTION static void
+mul_avx2(double *out, const double *a, const double *b, std::size_t n)
+{
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		auto x = _mm256_loadu_pd(a + i);
+		auto y = _mm256_loadu_pd(b + i);
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(x, y));
+	}
+	mul_scalar(out + i, a + i, b + i, n - i);
+}
+
+AVX2_FUNCTION static void
+scale_avx2(double *out, const double *a, double k, std::size_t n)
+{
+	auto factor = _mm256_set1_pd(k);
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES)
+		_mm256_storeu_pd(out + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), factor));
+	scale_scalar(out + i, a + i, k, n - i);
+}
+
+AVX2_FUNCTION static void fill_avx2(double *out, double value, std::size_t n)
+{
+	auto values = _mm256_set1_pd(value);
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES)
+		_mm256_storeu_pd(out + i, values);
+	fill_scalar(out + i, value, n - i);
+}
+
+// Multiplies and adds separately, a fused multiply-add would round
+// differently from the scalar version.
+AVX2_FUNCTION static double
+dot_avx2(const double *a, const double *b, std::size_t n)
+{
+	auto sums = _mm256_setzero_pd();
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES) {
+		auto product =
+			_mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i));
+		sums = _mm256_add_pd(sums, product);
+	}
+
+	auto result = add_lanes(sums);
+	for (; i < n; ++i)
+		result += a[i] * b[i];
+	return result;
+}
+
+AVX2_FUNCTION static double sum_avx2(const double *a, std::size_t n)
+{
+	auto sums = _mm256_setzero_pd();
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES)
+		sums = _mm256_add_pd(sums, _mm256_loadu_pd(a + i));
+
+	auto result = add_lanes(sums);
+	for (; i < n; ++i)
+		result += a[i];
+	return result;
+}
+
+// _mm256_min_pd and _mm256_max_pd return the second operand if either is
+// a NaN, like min_of and max_of do.
+AVX2_FUNCTION static double min_avx2(const double *a, std::size_t n)
+{
+	auto mins = _mm256_set1_pd(INF);
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES)
+		mins = _mm256_min_pd(_mm256_loadu_pd(a + i), mins);
+
+	double lanes[LANES];
+	_mm256_storeu_pd(lanes, mins);
+	return min_of(min_scalar(lanes, LANES), min_scalar(a + i, n - i));
+}
+
+AVX2_FUNCTION static double max_avx2(const double *a, std::size_t n)
+{
+	auto maxes = _mm256_set1_pd(-INF);
+	std::size_t i = 0;
+	for (; i + LANES <= n; i += LANES)
+		maxes = _mm256_max_pd(_mm256_loadu_pd(a + i), maxes);
+
+	double lanes[LANES];
+	_mm256_storeu_pd(lanes, maxes);
+	return max_of(max_scalar(lanes, LANES), max_scalar(a + i, n - i));
+}
+
+// Runs the AVX2 version of an operation if the CPU supports it
+#define DISPATCH(name, ...) \
+	return has_avx2() ? name##_avx2(__VA_ARGS__) : name##_scalar(__VA_ARGS__)
+
+#else
+
+#define DISPATCH(name, ...) return name##_scalar(__VA_ARGS__)
+
+#endif
+
+// Interface functions
+//---------------------------------------------------------
+
+void float64_add(double *out, const double *a, const double *b, std::size_t n)
+{
+	DISPATCH(add, out, a, b, n);
+}
+
+void float64_mul(double *out, const double *a, const double *b, std::size_t n)
+{
+	DISPATCH(mul, out, a, b, n);
+}
+
+void float64_scale(double *out, const double *a, double k, std::size_t n)
+{
+	DISPATCH(scale, out, a, k, n);
+}
+
+void float64_fill(double *out, double value, std::size_t n)
+{
+	DISPATCH(fill, out, value, n);
+}
+
+double float64_dot(const double *a, const double *b, std::size_t n)
+{
+	DISPATCH(dot, a, b, n);
+}
+
+double float64_sum(const double *a, std::size_t n) { DISPATCH(sum, a, n); }
+
+double float64_min(const double *a, std::size_t n) { DISPATCH(min, a, n); }
+
+double float64_max(const double *a, std::size_t n) { DISPATCH(max, a, n); }
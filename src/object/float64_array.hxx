@@ -0,0 +1,53 @@
+#ifndef FLOAT64_ARRAY_HXX_INCLUDED
+#define FLOAT64_ARRAY_HXX_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "object.hxx"
+
+// Fixed length array of raw doubles, for numeric code.
+// Made by the native Float64Array, its bulk operations are natives too.
+class LoxFloat64Array
+{
+public:
+	// The longest array Float64Array makes, 16 GiB of doubles
+	static constexpr std::size_t MAX_LENGTH = std::size_t(1) << 31;
+
+	LoxFloat64Array(std::size_t length)
+		: elements(length)
+	{
+	}
+
+	LoxFloat64Array(std::vector<double> elements_)
+		: elements(std::move(elements_))
+	{
+	}
+
+	std::string to_string() const
+	{
+		return "<Float64Array of " + std::to_string(elements.size()) + ">";
+	}
+
+	std::vector<double> elements;
+};
+
+// Bulk operations on arrays of n doubles, vectorized with AVX2 if the CPU
+// supports it. The output may be the same array as an input.
+//
+// Both versions add up the elements in the same order, four running sums
+// combined at the end, so sum and dot give the same result either way.
+// min and max skip NaNs, they are +inf and -inf for arrays of only NaNs.
+
+void float64_add(double *out, const double *a, const double *b, std::size_t n);
+void float64_mul(double *out, const double *a, const double *b, std::size_t n);
+void float64_scale(double *out, const double *a, double k, std::size_t n);
+void float64_fill(double *out, double value, std::size_t n);
+double float64_dot(const double *a, const double *b, std::size_t n);
+double float64_sum(const double *a, std::size_t n);
+double float64_min(const double *a, std::size_t n);
+double float64_max(const double *a, std::size_t n);
+
+#endif
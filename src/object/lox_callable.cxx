@@ -0,0 +1,67 @@
+#include <cassert>
+#include <string>
+
+#include "object.hxx"
+#include "lox_callable.hxx"
+#include "lox_function.hxx"
+#include "lox_class.hxx"
+#include "native.hxx"
+
+unsigned LoxCallable::arity() const
+{
+	switch (kind) {
+	case Kind::Function:
+		return static_cast<const LoxFunction &>(*this).arity();
+	case Kind::Class:
+		return static_cast<const LoxClass &>(*this).arity();
+	case Kind::Native:
+		return static_cast<const NativeFunction &>(*this).arity();
+	case Kind::BuiltinMethod:
+		return static_cast<const BuiltinMethod &>(*this).arity();
+	case Kind::Host:
+		return static_cast<const HostFunction &>(*this).arity();
+	}
+
+	assert(!"Unreachable code");
+	return 0;
+}
+
+std::string LoxCallable::to_string() const
+{
+	switch (kind) {
+	case Kind::Function:
+		return static_cast<const LoxFunction &>(*this).to_string();
+	case Kind::Class:
+		return static_cast<const LoxClass &>(*this).to_string();
+	case Kind::Native:
+		return static_cast<const NativeFunction &>(*this).to_string();
+	case Kind::BuiltinMethod:
+		return static_cast<const BuiltinMethod &>(*this).to_string();
+	case Kind::Host:
+		return static_cast<const HostFunction &>(*this).to_string();
+	}
+
+	assert(!"Unreachable code");
+	return {};
+}
+
+Object LoxCallable::call(Interpreter &interpreter, Arguments arguments)
+{
+	switch (kind) {
+	case Kind::Function:
+		return static_cast<LoxFunction &>(*this).call(interpreter, arguments);
+	case Kind::Class:
+		return static_cast<LoxClass &>(*this).call(interpreter, arguments);
+	case Kind::Native:
+		return static_cast<NativeFunction &>(*this).call(
+			interpreter, arguments
+		);
+	case Kind::BuiltinMethod:
+		return static_cast<BuiltinMethod &>(*this).call(interpreter, arguments);
+	case Kind::Host:
+		return static_cast<HostFunction &>(*this).call(interpreter, arguments);
+	}
+
+	assert(!"Unreachable code");
+	return nullptr;
+}
@@ -1,22 +1,48 @@
 #ifndef CALLABLE_HXX_INCLUDED
 #define CALLABLE_HXX_INCLUDED
 
+#include <span>
 #include <string>
-#include <vector>
 
 #include "object.hxx"
 
 class Interpreter;
 
+// Arguments of a call, in place on the value stack of the interpreter making
+// it, see ValueStack. They are the callee's to take, leaving nil behind: the
+// garbage collector still reads them.
+using Arguments = std::span<Object>;
+
 // LoxCallable object interface
+//
+// The callables are a closed set of kinds, each tagged with its kind. The
+// calls switch on it to the members of the kind, which are not virtual, so
+// neither dispatch nor telling the kinds apart needs a vtable or RTTI.
 class LoxCallable
 {
 public:
-	virtual unsigned arity() const = 0;
-	virtual std::string to_string() const = 0;
-	virtual Object
-	call(Interpreter &interpreter, std::vector<Object> &arguments) = 0;
-	virtual ~LoxCallable() = default;
+	enum class Kind {
+		Function,      // LoxFunction, a closure or a bound method
+		Class,         // LoxClass
+		Native,        // NativeFunction
+		BuiltinMethod, // BuiltinMethod
+		Host,          // HostFunction
+	};
+
+	unsigned arity() const;
+	std::string to_string() const;
+	Object call(Interpreter &interpreter, Arguments arguments);
+
+	const Kind kind;
+
+protected:
+	LoxCallable(Kind kind_)
+		: kind(kind_)
+	{
+	}
+
+	// Destroyed as the concrete kind, by the shared_ptr making it
+	~LoxCallable() = default;
 };
 
-#endif
\ No newline at end of file
+#endif
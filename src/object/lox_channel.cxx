@@ -0,0 +1,62 @@
+#include <chrono>
+#include <mutex>
+#include <utility>
+
+#include "runtime_error.hxx"
+#include "object.hxx"
+#include "lox_channel.hxx"
+#include "actor.hxx"
+#include "interpreter.hxx"
+
+void LoxChannel::send(const Object &value)
+{
+	// Copied before locking, the copy may be large
+	auto message = ValueCopier().copy(value);
+
+	Actor *receiver = nullptr;
+	{
+		std::lock_guard lock(mutex);
+		messages.push_back(std::move(message));
+		if (!receivers.empty()) {
+			receiver = receivers.front();
+			receivers.pop_front();
+		}
+	}
+
+	message_sent.notify_one();
+	if (receiver != nullptr)
+		receiver->interpreter.actor_scheduler().wake(*receiver);
+}
+
+Object LoxChannel::receive(Interpreter &interpreter)
+{
+	using namespace std::chrono_literals;
+
+	auto actor = interpreter.running_actor();
+	std::unique_lock lock(mutex);
+
+	while (messages.empty()) {
+		if (actor != nullptr) {
+			receivers.push_back(actor);
+			if (!interpreter.actor_scheduler().park(*actor, lock)) {
+				std::erase(receivers, actor);
+				throw ActorCancelled();
+			}
+			continue;
+		}
+
+		// Only an actor can send while this thread waits
+		if (!interpreter.has_actor_scheduler()
+			|| interpreter.actor_scheduler().idle()) {
+			throw NativeFnError(
+				"'receive' would wait forever, no actor is left to send."
+			);
+		}
+		// Checks again from time to time whether any actor is left
+		message_sent.wait_for(lock, 10ms);
+	}
+
+	auto message = std::move(messages.front());
+	messages.pop_front();
+	return message;
+}
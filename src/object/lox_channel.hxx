@@ -0,0 +1,38 @@
+#ifndef LOX_CHANNEL_HXX_INCLUDED
+#define LOX_CHANNEL_HXX_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+
+#include "object.hxx"
+
+class Actor;
+
+// Unbounded queue of messages between actors, see actor.hxx.
+// It is the only object shared by interpreters, the messages sent are
+// copies belonging to no interpreter until they are received.
+class LoxChannel
+{
+public:
+	std::string to_string() const { return "<channel>"; }
+
+	/// Sends a copy of the value, throws a NativeFnError if it is not data.
+	void send(const Object &value);
+
+	/// Waits for a message and returns it. An actor is suspended meanwhile,
+	/// any other caller blocks.
+	/// Throws a NativeFnError if no actor is left to send one.
+	Object receive(Interpreter &interpreter);
+
+private:
+	std::mutex mutex;
+	std::deque<Object> messages;
+	// Actors suspended in receive
+	std::deque<Actor *> receivers;
+	// For the other callers of receive
+	std::condition_variable message_sent;
+};
+
+#endif
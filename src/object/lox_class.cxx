@@ -6,14 +6,41 @@
 #include "lox_instance.hxx"
 #include "interpreter.hxx"
 
-Object LoxClass::call(Interpreter &interpreter, std::vector<Object> &arguments)
+Object LoxClass::call(Interpreter &interpreter, Arguments arguments)
 {
+	using Allocation = AllocationProfiler::Kind;
+	interpreter.count_allocation(Allocation::Instance, sizeof(LoxInstance));
 	auto instance = std::make_shared<LoxInstance>(self_ptr.lock());
 	instance->self_ptr = instance;
 
-	auto initializer = find_method("init");
-	if (initializer != nullptr)
+	if (initializer != nullptr) {
+		interpreter.count_allocation(
+			Allocation::Environment, sizeof(Environment)
+		);
+		interpreter.count_allocation(Allocation::Function, sizeof(LoxFunction));
 		initializer->bind(instance)->call(interpreter, arguments);
+	}
 
 	return instance;
-}
\ No newline at end of file
+}
+void LoxClass::link_methods()
+{
+	method_table.clear();
+	method_slots.clear();
+	if (superclass != nullptr) {
+		method_table = superclass->method_table;
+		method_slots = superclass->method_slots;
+	}
+
+	for (auto &[method_name, method] : methods) {
+		auto [slot, inserted] =
+			method_slots.try_emplace(method_name, method_table.size());
+		if (inserted)
+			method_table.push_back(method);
+		else
+			method_table[slot->second] = method;
+	}
+
+	initializer = find_method("init");
+	initializer_arity = initializer != nullptr ? initializer->arity() : 0;
+}
@@ -2,7 +2,9 @@
 #define LOX_CLASS_HXX_INCLUDED
 
 #include <map>
+#include <optional>
 #include <string>
+#include <unordered_map>
 #include <vector>
 
 #include "object.hxx"
@@ -18,43 +20,57 @@ using ClassMethodMap = std::map<const std::string, LoxFunctionPtr>;
 
 // The Lox class
 // Assign the shared_ptr created to the self_ptr field of this class.
-class LoxClass : public LoxCallable
+//
+// Each class has a flat table of its methods, inherited ones included, so
+// that finding one takes a single lookup however deep the hierarchy is.
+// A method overriding another takes its slot in the table: the slot of a
+// method in a class is also its slot in each of the subclasses.
+class LoxClass final : public LoxCallable
 {
+	friend class ValueCopier;      // superclass, methods and link_methods
+	friend class GarbageCollector; // method_table and gc_mark
+
 public:
 	LoxClass(
 		const std::string &name_, LoxClassPtr superclass_,
 		ClassMethodMap methods_
 	)
-		: name(name_)
+		: LoxCallable(Kind::Class)
+		, name(name_)
 		, superclass(std::move(superclass_))
 		, methods(std::move(methods_))
 	{
+		link_methods();
 	}
 
 	LoxFunctionPtr find_method(const std::string &method_name) const
 	{
-		auto result = methods.find(method_name);
-		if (result != methods.end())
-			return result->second;
-
-		if (superclass != nullptr)
-			return superclass->find_method(method_name);
-
-		return nullptr;
+		auto slot = method_slots.find(method_name);
+		if (slot == method_slots.end())
+			return nullptr;
+		return method_table[slot->second];
 	}
 
-	std::string to_string() const override { return "<class " + name + ">"; }
+	/// Returns the slot of the method in the method table, if there is one.
+	std::optional<unsigned> find_slot(const std::string &method_name) const
+	{
+		auto slot = method_slots.find(method_name);
+		if (slot == method_slots.end())
+			return std::nullopt;
+		return slot->second;
+	}
 
-	unsigned arity() const override
+	/// Returns the method in a slot found for this class or a superclass.
+	const LoxFunctionPtr &method_at(unsigned slot) const
 	{
-		auto initializer = find_method("init");
-		if (initializer == nullptr)
-			return 0;
-		return initializer->arity();
+		return method_table[slot];
 	}
 
-	Object
-	call(Interpreter &interpreter, std::vector<Object> &arguments) override;
+	std::string to_string() const { return "<class " + name + ">"; }
+
+	unsigned arity() const { return initializer_arity; }
+
+	Object call(Interpreter &interpreter, Arguments arguments);
 
 	// Instance needs to keep a reference to the Class, therefore,
 	// store a weak_ptr to itself which will be used by the instance
@@ -63,8 +79,19 @@ public:
 	std::string name;
 
 private:
+	// Builds the method table from that of the superclass and the methods
+	void link_methods();
+
 	LoxClassPtr superclass;
 	ClassMethodMap methods;
+
+	std::vector<LoxFunctionPtr> method_table;
+	std::unordered_map<std::string, unsigned> method_slots;
+	// The init method, if any, looked up once for the calls
+	LoxFunctionPtr initializer;
+	unsigned initializer_arity = 0;
+	// Last collection in which it was marked, see GarbageCollector.
+	unsigned gc_mark = 0;
 };
 
 #endif
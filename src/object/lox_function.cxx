@@ -1,32 +1,58 @@
 #include <cassert>
 #include <memory>
+#include <optional>
 #include <utility>
+#include <vector>
 
 #include "object.hxx"
 #include "lox_function.hxx"
+#include "lox_generator.hxx"
+#include "allocation_profiler.hxx"
+#include "memoizer.hxx"
 #include "environment.hxx"
 #include "interpreter.hxx"
+#include "profiler.hxx"
+#include "tracer.hxx"
 
-Object
-LoxFunction::call(Interpreter &interpreter, std::vector<Object> &arguments)
+Object LoxFunction::call(Interpreter &interpreter, Arguments arguments)
 {
-	assert(declaration.params.size() == arguments.size());
+	// Tail calls are made here in a loop, instead of from inside the body,
+	// so that they do not use any more of the native stack.
+	// Keeps the function and the arguments of the current tail call alive.
+	LoxFunctionPtr tail_function;
+	std::optional<ValueStack::Frame> tail_arguments;
+	auto function = this;
+	// Its result, that of the tail calls too, is cached if it is pure
+	Memoizer::Call memoized(interpreter.memoizer(), *this, arguments);
+	if (auto result = memoized.cached())
+		return *result;
 
-	auto environment = std::make_shared<Environment>(closure);
-	for (unsigned i = 0; i < declaration.params.size(); ++i)
-		environment->define(declaration.params[i].lexeme, arguments[i]);
+	Profiler::Scope profiled(interpreter.profiler(), declaration);
+	AllocationProfiler::Scope allocating(
+		interpreter.allocation_profiler(), declaration
+	);
+	interpreter.count_call(declaration.name.lexeme);
+	Tracer::CallSpan traced(
+		interpreter.tracer(), interpreter.traced_call_depth,
+		declaration.name.lexeme
+	);
 
-	try {
-		interpreter.execute_block(*declaration.body, std::move(environment));
-	} catch (Interpreter::ControlReturn return_value) {
-		if (is_initializer)
-			return closure->get_at(0, "this");
-		return return_value.value;
+	while (true) {
+		try {
+			return memoized.remember(function->execute(interpreter, arguments));
+		} catch (Interpreter::ControlTailCall &) {
+			auto &value_stack = interpreter.value_stack;
+			auto callee = value_stack.take_tail_call(tail_arguments);
+			tail_function = std::static_pointer_cast<LoxFunction>(
+				std::get<LoxCallablePtr>(std::move(callee))
+			);
+			arguments = tail_arguments->values();
+			function = tail_function.get();
+			profiled.replace(function->declaration);
+			allocating.replace(function->declaration);
+			interpreter.count_call(function->declaration.name.lexeme);
+		}
 	}
-
-	if (is_initializer)
-		return closure->get_at(0, "this");
-	return nullptr;
 }
 
 LoxFunctionPtr LoxFunction::bind(LoxInstancePtr instance)
@@ -40,3 +66,52 @@ LoxFunctionPtr LoxFunction::bind(LoxInstancePtr instance)
 		declaration, std::move(environment), is_initializer
 	);
 }
+
+Object LoxFunction::execute(Interpreter &interpreter, Arguments arguments)
+{
+	assert(declaration.params.size() == arguments.size());
+
+	if (declaration.lazy_body && !declaration.lazy_body->compiled)
+		interpreter.compile_lazy_body(declaration);
+
+	if (!is_initializer && !declaration.is_generator()) {
+		if (auto result = interpreter.jit_call(declaration, arguments))
+			return *result;
+	}
+
+	interpreter.count(&ExecutionStats::environments);
+	interpreter.count_allocation(
+		Interpreter::Allocation::Environment, sizeof(Environment),
+		declaration.name.line
+	);
+	// The arguments are moved in, leaving nil for the garbage collector
+	auto environment = std::make_shared<Environment>(closure);
+	for (unsigned i = 0; i < declaration.params.size(); ++i) {
+		environment->define(
+			declaration.params[i].lexeme, std::exchange(arguments[i], nullptr)
+		);
+	}
+
+	// The body is run by the generator, a piece at a time
+	if (declaration.is_generator()) {
+		interpreter.count_allocation(
+			Interpreter::Allocation::Generator, sizeof(LoxGenerator),
+			declaration.name.line
+		);
+		return std::make_shared<LoxGenerator>(
+			interpreter, declaration, std::move(environment)
+		);
+	}
+
+	try {
+		interpreter.execute_body(declaration, std::move(environment));
+	} catch (Interpreter::ControlReturn return_value) {
+		if (is_initializer)
+			return closure->get_at(0, "this");
+		return return_value.value;
+	}
+
+	if (is_initializer)
+		return closure->get_at(0, "this");
+	return nullptr;
+}
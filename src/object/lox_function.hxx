@@ -16,34 +16,45 @@ class LoxFunction;
 
 using LoxFunctionPtr = std::shared_ptr<LoxFunction>;
 
-class LoxFunction : public LoxCallable
+class LoxFunction final : public LoxCallable
 {
+	friend class ValueCopier; // declaration and is_initializer
+	friend class Memoizer;    // declaration and is_initializer
+
 public:
 	LoxFunction(
 		const Function &declaration_, EnvironmentPtr closure_,
 		bool is_init = false
 	)
-		: closure(std::move(closure_))
+		: LoxCallable(Kind::Function)
+		, closure(std::move(closure_))
 		, declaration(declaration_)
 		, is_initializer(is_init)
 	{
 	}
 
-	unsigned arity() const override { return declaration.params.size(); }
+	unsigned arity() const { return declaration.params.size(); }
 
-	std::string to_string() const override
+	std::string to_string() const
 	{
 		return "<fn " + declaration.name.lexeme + ">";
 	}
 
-	Object
-	call(Interpreter &interpreter, std::vector<Object> &arguments) override;
+	Object call(Interpreter &interpreter, Arguments arguments);
 
 	LoxFunctionPtr bind(LoxInstancePtr instance);
 
+	bool is_declared_by(const std::vector<StmtPtr> &body) const
+	{
+		return declaration.body.get() == &body;
+	}
+
 	EnvironmentPtr closure;
 
 private:
+	// Runs the body once, a tail call in it is thrown to call()
+	Object execute(Interpreter &interpreter, Arguments arguments);
+
 	Function declaration;
 	bool is_initializer = false;
 };
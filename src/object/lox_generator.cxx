@@ -0,0 +1,173 @@
+#include <memory>
+#include <utility>
+
+#include "runtime_error.hxx"
+#include "object.hxx"
+#include "lox_generator.hxx"
+#include "environment.hxx"
+#include "interpreter.hxx"
+
+LoxGenerator::LoxGenerator(
+	Interpreter &interpreter, const Function &declaration,
+	EnvironmentPtr environment
+)
+	: name(declaration.name.lexeme)
+	, body(declaration.body)
+{
+	interpreter.garbage_collector.track_environment(environment);
+	frames.push_back({body.get(), nullptr, 0, std::move(environment)});
+}
+
+Object LoxGenerator::resume(Interpreter &interpreter, const Object &sent)
+{
+	if (running)
+		throw NativeFnError("Generator is already running.");
+	if (frames.empty())
+		return nullptr;
+
+	auto previous = interpreter.environment;
+	running = true;
+
+	try {
+		// The yield suspended at stores the value sent, if it is assigned
+		if (suspended_at != nullptr) {
+			interpreter.environment = frames.back().environment;
+			if (auto var = dynamic_cast<const Var *>(suspended_at)) {
+				interpreter.environment->define(var->name.lexeme, sent);
+			} else {
+				auto &stmt = dynamic_cast<const Expression &>(*suspended_at);
+				auto assign = dynamic_cast<const Assign *>(stmt.expression.get());
+				if (assign != nullptr)
+					interpreter.assign_variable(*assign, sent);
+			}
+			suspended_at = nullptr;
+		}
+
+		auto result = run(interpreter);
+		interpreter.environment = std::move(previous);
+		running = false;
+		return result;
+	} catch (...) {
+		// Done for good after an error
+		frames.clear();
+		interpreter.environment = std::move(previous);
+		running = false;
+		throw;
+	}
+}
+
+Object LoxGenerator::run(Interpreter &interpreter)
+{
+	auto &collector = interpreter.garbage_collector;
+
+	while (!frames.empty()) {
+		// The enclosing frames share its environment or enclose it
+		interpreter.environment = frames.back().environment;
+		collector.push_reachable(interpreter.environment);
+
+		bool has_yielded = false;
+		try {
+			has_yielded = step(interpreter);
+		} catch (Interpreter::ControlBreak) {
+			unwind_loop(true);
+		} catch (Interpreter::ControlContinue) {
+			unwind_loop(false);
+		} catch (Interpreter::ControlReturn &return_value) {
+			collector.pop_environment();
+			frames.clear();
+			return std::move(return_value.value);
+		} catch (...) {
+			collector.pop_environment();
+			throw;
+		}
+
+		collector.pop_environment();
+		if (has_yielded)
+			return yielded;
+	}
+
+	return nullptr;
+}
+
+bool LoxGenerator::step(Interpreter &interpreter)
+{
+	auto &frame = frames.back();
+
+	if (frame.loop != nullptr) {
+		auto &loop = *frame.loop;
+		// Counted loops too are run like this, with the counter in
+		// the variable, see Interpreter::execute_loop.
+		if (frame.next != 0 && loop.for_update != nullptr)
+			interpreter.evaluate(*loop.for_update);
+		frame.next = 1;
+
+		if (!is_truthy(interpreter.evaluate(*loop.condition))) {
+			frames.pop_back();
+			return false;
+		}
+		return start(interpreter, *loop.body);
+	}
+
+	if (frame.next == frame.statements->size()) {
+		frames.pop_back();
+		return false;
+	}
+	return start(interpreter, *(*frame.statements)[frame.next++]);
+}
+
+bool LoxGenerator::start(Interpreter &interpreter, const Stmt &stmt)
+{
+	if (auto yield = statement_yield(stmt)) {
+		yielded = nullptr;
+		if (yield->value != nullptr)
+			yielded = interpreter.evaluate(*yield->value);
+		suspended_at = &stmt;
+		return true;
+	}
+
+	auto block = dynamic_cast<const Block *>(&stmt);
+	if (block != nullptr && block->has_yield) {
+		auto environment = interpreter.environment;
+		if (block->needs_environment) {
+			interpreter.count(&ExecutionStats::environments);
+			interpreter.count_allocation(
+				Interpreter::Allocation::Environment, sizeof(Environment),
+				block->line
+			);
+			environment = std::make_shared<Environment>(environment);
+			interpreter.garbage_collector.track_environment(environment);
+		}
+		frames.push_back(
+			{&block->statements, nullptr, 0, std::move(environment)}
+		);
+		return false;
+	}
+
+	auto branch = dynamic_cast<const If *>(&stmt);
+	if (branch != nullptr && branch->has_yield) {
+		if (is_truthy(interpreter.evaluate(*branch->condition)))
+			return start(interpreter, *branch->then_branch);
+		if (branch->else_branch != nullptr)
+			return start(interpreter, *branch->else_branch);
+		return false;
+	}
+
+	auto loop = dynamic_cast<const While *>(&stmt);
+	if (loop != nullptr && loop->has_yield) {
+		frames.push_back({nullptr, loop, 0, interpreter.environment});
+		return false;
+	}
+
+	interpreter.execute(stmt);
+	return false;
+}
+
+void LoxGenerator::unwind_loop(bool is_break)
+{
+	while (!frames.empty() && frames.back().loop == nullptr)
+		frames.pop_back();
+
+	// For a 'continue' the loop runs its update clause next
+	if (is_break && !frames.empty())
+		frames.pop_back();
+}
@@ -0,0 +1,79 @@
+#ifndef LOX_GENERATOR_HXX_INCLUDED
+#define LOX_GENERATOR_HXX_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "object.hxx"
+#include "stmt.hxx"
+#include "environment.hxx"
+
+// A call of a function with a yield in its body, made by LoxFunction::call.
+// Its methods are: next(), send(value) and done().
+//
+// The body is run a piece at a time by resume, up to the next yield. Where it
+// is in each enclosing block and loop is kept in frames on the heap rather
+// than on the native stack, so a suspended generator holds nothing more than
+// its frames and environments. Only the statements with a yield inside them
+// are stepped through, see Block::has_yield, the rest are run as usual by the
+// Interpreter, on the tree engine whichever one is selected.
+class LoxGenerator
+{
+	friend class GarbageCollector; // frames
+
+public:
+	LoxGenerator(
+		Interpreter &interpreter, const Function &declaration,
+		EnvironmentPtr environment
+	);
+
+	std::string to_string() const { return "<generator " + name + ">"; }
+
+	/// Runs the body until the next yield and returns the value yielded, or
+	/// until it returns and returns the value returned. Returns nil once done.
+	/// The value sent is the result of the yield it was suspended at.
+	Object resume(Interpreter &interpreter, const Object &sent);
+
+	/// The body has returned, or failed with an error.
+	bool done() const { return frames.empty(); }
+
+	// Number of the last garbage collection in which it was marked
+	unsigned gc_mark = 0;
+
+private:
+	// A block or a loop being run
+	struct Frame {
+		// Non-null for a block
+		const std::vector<StmtPtr> *statements = nullptr;
+		// Non-null for a loop
+		const While *loop = nullptr;
+		// The next statement of a block, for a loop 1 once a turn has run
+		std::size_t next = 0;
+		EnvironmentPtr environment;
+	};
+
+	// Runs the frames until a yield or the end of the body
+	Object run(Interpreter &interpreter);
+	// Runs the next statement of the innermost block, or the next turn of
+	// the innermost loop. Returns true if it yielded.
+	bool step(Interpreter &interpreter);
+	// Runs a statement, or pushes a frame for it if it has a yield inside.
+	// Returns true if it is a yield, the value yielded is stored in yielded.
+	bool start(Interpreter &interpreter, const Stmt &stmt);
+	// Pops the frames inside the innermost loop, and the loop too for
+	// a 'break'.
+	void unwind_loop(bool is_break);
+
+	std::string name;
+	// Keeps the statements which the frames point into alive
+	std::shared_ptr<const std::vector<StmtPtr>> body;
+	std::vector<Frame> frames;
+	// Statement of the yield it is suspended at
+	const Stmt *suspended_at = nullptr;
+	Object yielded;
+	bool running = false;
+};
+
+#endif
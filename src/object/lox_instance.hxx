@@ -16,6 +16,7 @@
 class LoxInstance
 {
 	friend class GarbageCollector;
+	friend class ValueCopier;
 
 public:
 	LoxInstance(LoxClassPtr klass_)
@@ -43,6 +44,11 @@ public:
 		);
 	}
 
+	bool has_field(const std::string &name) const
+	{
+		return fields.contains(name);
+	}
+
 	void set(const Token &name, const Object &value)
 	{
 		fields[name.lexeme] = value;
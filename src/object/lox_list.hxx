@@ -0,0 +1,50 @@
+#ifndef LOX_LIST_HXX_INCLUDED
+#define LOX_LIST_HXX_INCLUDED
+
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "object.hxx"
+
+// The Lox list, a contiguous array of values growing as needed.
+// Indexed from zero, its methods are in native.hxx.
+class LoxList
+{
+	friend class GarbageCollector;
+
+public:
+	LoxList() = default;
+
+	LoxList(std::vector<Object> elements_)
+		: elements(std::move(elements_))
+	{
+	}
+
+	std::string to_string() const
+	{
+		// A list containing itself
+		if (printing)
+			return "[...]";
+
+		printing = true;
+		std::string result = "[";
+		for (auto &element : elements) {
+			if (result.size() > 1)
+				result += ", ";
+			result += to_element_string(element);
+		}
+		printing = false;
+
+		return result + "]";
+	}
+
+	std::vector<Object> elements;
+
+private:
+	mutable bool printing = false;
+	// Last collection in which it was marked, see GarbageCollector.
+	unsigned gc_mark = 0;
+};
+
+#endif
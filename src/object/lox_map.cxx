@@ -0,0 +1,191 @@
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <utility>
+#include <variant>
+#include <vector>
+
+#include "object.hxx"
+#include "lox_map.hxx"
+
+// Smallest table allocated
+constexpr std::size_t MIN_CAPACITY = 8;
+
+// Helper functions
+//---------------------------------------------------------
+
+static std::size_t hash_key(const Object &key)
+{
+	std::size_t hash = 0;
+
+	if (auto number = std::get_if<double>(&key)) {
+		// Equal keys must have equal hashes
+		if (*number == 0)
+			hash = 0;
+		else if (std::isnan(*number))
+			hash = 1;
+		else
+			hash = std::hash<double>{}(*number);
+	} else {
+		hash = std::visit(
+			[](const auto &value) {
+				return std::hash<std::decay_t<decltype(value)>>{}(value);
+			},
+			key
+		);
+	}
+
+	// Pointers and small integers have few distinct low bits, which
+	// are the ones used for the index. Mix the others into them.
+	std::uint64_t mixed = hash ^ key.index();
+	mixed *= 0x9e3779b97f4a7c15;
+	return mixed ^ (mixed >> 32);
+}
+
+static bool same_key(const Object &a, const Object &b)
+{
+	if (auto x = std::get_if<double>(&a)) {
+		auto y = std::get_if<double>(&b);
+		return y != nullptr && (*x == *y || (std::isnan(*x) && std::isnan(*y)));
+	}
+
+	return a == b;
+}
+
+// LoxMap methods
+//---------------------------------------------------------
+
+std::string LoxMap::to_string() const
+{
+	// A map containing itself
+	if (printing)
+		return "{...}";
+
+	printing = true;
+	std::string result = "{";
+	for (auto &slot : slots) {
+		if (slot.state != SlotState::Full)
+			continue;
+
+		if (result.size() > 1)
+			result += ", ";
+		result += to_element_string(slot.key);
+		result += ": ";
+		result += to_element_string(slot.value);
+	}
+	printing = false;
+
+	return result + "}";
+}
+
+const Object *LoxMap::find(const Object &key) const
+{
+	if (count == 0)
+		return nullptr;
+
+	auto &slot = slots[find_slot(key, hash_key(key))];
+	return slot.state == SlotState::Full ? &slot.value : nullptr;
+}
+
+void LoxMap::set(const Object &key, const Object &value)
+{
+	// Keep an empty slot after adding, so that probing always ends.
+	if ((used + 1) * 4 > slots.size() * 3)
+		rehash(std::max(MIN_CAPACITY, std::bit_ceil((count + 1) * 2)));
+
+	auto hash = hash_key(key);
+	auto &slot = slots[find_slot(key, hash)];
+
+	if (slot.state == SlotState::Full) {
+		slot.value = value;
+		return;
+	}
+
+	if (slot.state == SlotState::Empty)
+		used++;
+	count++;
+	slot = Slot{key, value, hash, SlotState::Full};
+}
+
+bool LoxMap::remove(const Object &key)
+{
+	if (count == 0)
+		return false;
+
+	auto &slot = slots[find_slot(key, hash_key(key))];
+	if (slot.state != SlotState::Full)
+		return false;
+
+	// Release the objects, but leave a tombstone to keep the probe chain.
+	slot = Slot{nullptr, nullptr, 0, SlotState::Removed};
+	count--;
+	return true;
+}
+
+std::vector<Object> LoxMap::keys() const
+{
+	std::vector<Object> result;
+	result.reserve(count);
+	for (auto &slot : slots) {
+		if (slot.state == SlotState::Full)
+			result.push_back(slot.key);
+	}
+	return result;
+}
+
+std::vector<Object> LoxMap::values() const
+{
+	std::vector<Object> result;
+	result.reserve(count);
+	for (auto &slot : slots) {
+		if (slot.state == SlotState::Full)
+			result.push_back(slot.value);
+	}
+	return result;
+}
+
+std::size_t LoxMap::find_slot(const Object &key, std::size_t hash) const
+{
+	auto mask = slots.size() - 1;
+	// First tombstone found, reused when the key is not in the map.
+	std::size_t removed = slots.size();
+
+	for (auto index = hash & mask;; index = (index + 1) & mask) {
+		auto &slot = slots[index];
+
+		switch (slot.state) {
+		case SlotState::Empty:
+			return removed != slots.size() ? removed : index;
+		case SlotState::Removed:
+			if (removed == slots.size())
+				removed = index;
+			break;
+		case SlotState::Full:
+			if (slot.hash == hash && same_key(slot.key, key))
+				return index;
+			break;
+		}
+	}
+}
+
+void LoxMap::rehash(std::size_t capacity)
+{
+	auto old_slots = std::exchange(slots, std::vector<Slot>(capacity));
+	used = count;
+
+	auto mask = capacity - 1;
+	for (auto &slot : old_slots) {
+		if (slot.state != SlotState::Full)
+			continue;
+
+		auto index = slot.hash & mask;
+		while (slots[index].state != SlotState::Empty)
+			index = (index + 1) & mask;
+		slots[index] = std::move(slot);
+	}
+}
@@ -0,0 +1,64 @@
+#ifndef LOX_MAP_HXX_INCLUDED
+#define LOX_MAP_HXX_INCLUDED
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+#include "object.hxx"
+
+// The Lox map, a hash map from any value to any value, its methods are in
+// native.hxx. Strings, numbers, booleans and nil are compared by value, all
+// other objects by identity. All NaNs are the same key, so are 0 and -0.
+//
+// Uses open addressing with linear probing in a table of a power of two size
+// kept at most 3/4 full, removed entries are left as tombstones until the
+// table is rebuilt.
+class LoxMap
+{
+	friend class GarbageCollector;
+
+public:
+	std::string to_string() const;
+
+	std::size_t size() const { return count; }
+
+	/// Returns the value for the key, or nullptr if it is not in the map.
+	const Object *find(const Object &key) const;
+
+	/// Adds the key or replaces its value.
+	void set(const Object &key, const Object &value);
+
+	/// Removes the key, returns false if it was not in the map.
+	bool remove(const Object &key);
+
+	std::vector<Object> keys() const;
+	std::vector<Object> values() const;
+
+private:
+	enum class SlotState : unsigned char { Empty, Full, Removed };
+
+	struct Slot {
+		Object key;
+		Object value;
+		std::size_t hash = 0;
+		SlotState state = SlotState::Empty;
+	};
+
+	// Returns the slot holding the key, or if there is none then the slot
+	// where it should be added. The table must not be empty.
+	std::size_t find_slot(const Object &key, std::size_t hash) const;
+	// Rebuilds the table with the capacity, dropping the tombstones.
+	void rehash(std::size_t capacity);
+
+	std::vector<Slot> slots;
+	// Number of the Full slots, and of the Full and Removed ones.
+	std::size_t count = 0;
+	std::size_t used = 0;
+
+	mutable bool printing = false;
+	// Last collection in which it was marked, see GarbageCollector.
+	unsigned gc_mark = 0;
+};
+
+#endif
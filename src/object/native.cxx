@@ -1,24 +1,37 @@
 #include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <format>
+#include <memory>
+#include <new>
 #include <thread>
+#include <utility>
 #include <variant>
 
 #include "runtime_error.hxx"
 #include "object.hxx"
 #include "lox_instance.hxx"
 #include "lox_class.hxx"
+#include "lox_list.hxx"
+#include "lox_map.hxx"
+#include "float64_array.hxx"
+#include "lox_channel.hxx"
+#include "lox_generator.hxx"
 #include "native.hxx"
 #include "interpreter.hxx"
+#include "actor.hxx"
+#include "event_loop.hxx"
 
 using namespace std::chrono;
 using std::get;
 
-Object ClockFn::call(Interpreter &, std::vector<Object> &)
+static Object native_clock(Interpreter &, Arguments)
 {
 	duration<double> time = system_clock::now().time_since_epoch();
 	return time.count();
 }
 
-Object SleepFn::call(Interpreter &, std::vector<Object> &arguments)
+static Object native_sleep(Interpreter &interpreter, Arguments arguments)
 {
 	auto &time = arguments[0];
 	if (!match_types<double>(time) || get<double>(time) < 0) {
@@ -28,16 +41,20 @@ Object SleepFn::call(Interpreter &, std::vector<Object> &arguments)
 	}
 
 	unsigned time_ms = 1000.0 * std::get<double>(time);
-	std::this_thread::sleep_for(milliseconds(time_ms));
+	// Actors leave the thread to the others meanwhile
+	if (auto actor = interpreter.running_actor())
+		interpreter.actor_scheduler().sleep(*actor, milliseconds(time_ms));
+	else
+		std::this_thread::sleep_for(milliseconds(time_ms));
 	return nullptr;
 }
 
-Object StringFn::call(Interpreter &, std::vector<Object> &arguments)
+static Object native_string(Interpreter &, Arguments arguments)
 {
 	return ::to_string(arguments[0]);
 }
 
-Object InstanceOfFn::call(Interpreter &, std::vector<Object> &arguments)
+static Object native_instance_of(Interpreter &, Arguments arguments)
 {
 	auto &instance = arguments[0];
 	auto &klass = arguments[1];
@@ -49,3 +66,415 @@ Object InstanceOfFn::call(Interpreter &, std::vector<Object> &arguments)
 
 	return get<LoxInstancePtr>(instance)->instance_of(get<LoxClassPtr>(klass));
 }
+
+// Float64Array natives
+//---------------------------------------------------------
+
+// Returns the argument as a Float64Array, throws if it is not one.
+static LoxFloat64Array &
+float64_array(const Object &argument, const char *function)
+{
+	if (!match_types<LoxFloat64ArrayPtr>(argument)) {
+		throw NativeFnError(
+			std::format("Arguments to '{}' must be Float64Arrays.", function)
+		);
+	}
+
+	return *get<LoxFloat64ArrayPtr>(argument);
+}
+
+static void check_same_length(
+	const LoxFloat64Array &a, const LoxFloat64Array &b, const char *function
+)
+{
+	if (a.elements.size() != b.elements.size()) {
+		throw NativeFnError(std::format(
+			"Float64Arrays passed to '{}' must have the same length.", function
+		));
+	}
+}
+
+static Object
+native_float64_array(Interpreter &interpreter, Arguments arguments)
+{
+	auto &argument = arguments[0];
+	auto count_allocation = [&](std::size_t length) {
+		interpreter.count_allocation(
+			AllocationProfiler::Kind::Float64Array,
+			sizeof(LoxFloat64Array) + length * sizeof(double)
+		);
+	};
+
+	// Copy of a list of numbers
+	if (match_types<LoxListPtr>(argument)) {
+		auto &list = get<LoxListPtr>(argument)->elements;
+		std::vector<double> elements;
+		elements.reserve(list.size());
+
+		for (auto &element : list) {
+			if (!match_types<double>(element)) {
+				throw NativeFnError(
+					"List passed to 'Float64Array' must only hold numbers."
+				);
+			}
+			elements.push_back(get<double>(element));
+		}
+
+		count_allocation(elements.size());
+		return std::make_shared<LoxFloat64Array>(std::move(elements));
+	}
+
+	// Zero filled array of the length
+	auto length = std::get_if<double>(&argument);
+	if (length == nullptr || !std::isfinite(*length) || *length < 0
+		|| std::trunc(*length) != *length) {
+		throw NativeFnError(
+			"Argument to 'Float64Array' must be a length or a list of numbers."
+		);
+	}
+	if (*length > LoxFloat64Array::MAX_LENGTH) {
+		throw NativeFnError(std::format(
+			"Float64Array length must be at most {}.",
+			LoxFloat64Array::MAX_LENGTH
+		));
+	}
+
+	auto size = static_cast<std::size_t>(*length);
+	try {
+		auto array = std::make_shared<LoxFloat64Array>(size);
+		count_allocation(size);
+		return array;
+	} catch (const std::bad_alloc &) {
+		throw NativeFnError(
+			"Not enough memory for a Float64Array of this length."
+		);
+	}
+}
+
+static Object native_f64_add(Interpreter &, Arguments arguments)
+{
+	auto &out = float64_array(arguments[0], "f64_add");
+	auto &a = float64_array(arguments[1], "f64_add");
+	auto &b = float64_array(arguments[2], "f64_add");
+	check_same_length(out, a, "f64_add");
+	check_same_length(a, b, "f64_add");
+
+	float64_add(
+		out.elements.data(), a.elements.data(), b.elements.data(),
+		out.elements.size()
+	);
+	return nullptr;
+}
+
+static Object native_f64_mul(Interpreter &, Arguments arguments)
+{
+	auto &out = float64_array(arguments[0], "f64_mul");
+	auto &a = float64_array(arguments[1], "f64_mul");
+	auto &b = float64_array(arguments[2], "f64_mul");
+	check_same_length(out, a, "f64_mul");
+	check_same_length(a, b, "f64_mul");
+
+	float64_mul(
+		out.elements.data(), a.elements.data(), b.elements.data(),
+		out.elements.size()
+	);
+	return nullptr;
+}
+
+static Object native_f64_scale(Interpreter &, Arguments arguments)
+{
+	auto &out = float64_array(arguments[0], "f64_scale");
+	auto &a = float64_array(arguments[1], "f64_scale");
+	check_same_length(out, a, "f64_scale");
+	if (!match_types<double>(arguments[2]))
+		throw NativeFnError("Factor passed to 'f64_scale' must be a number.");
+
+	float64_scale(
+		out.elements.data(), a.elements.data(), get<double>(arguments[2]),
+		out.elements.size()
+	);
+	return nullptr;
+}
+
+static Object native_f64_fill(Interpreter &, Arguments arguments)
+{
+	auto &out = float64_array(arguments[0], "f64_fill");
+	if (!match_types<double>(arguments[1]))
+		throw NativeFnError("Value passed to 'f64_fill' must be a number.");
+
+	float64_fill(
+		out.elements.data(), get<double>(arguments[1]), out.elements.size()
+	);
+	return nullptr;
+}
+
+static Object native_f64_dot(Interpreter &, Arguments arguments)
+{
+	auto &a = float64_array(arguments[0], "f64_dot");
+	auto &b = float64_array(arguments[1], "f64_dot");
+	check_same_length(a, b, "f64_dot");
+
+	return float64_dot(a.elements.data(), b.elements.data(), a.elements.size());
+}
+
+static Object native_f64_sum(Interpreter &, Arguments arguments)
+{
+	auto &a = float64_array(arguments[0], "f64_sum");
+	return float64_sum(a.elements.data(), a.elements.size());
+}
+
+static Object native_f64_min(Interpreter &, Arguments arguments)
+{
+	auto &a = float64_array(arguments[0], "f64_min");
+	if (a.elements.empty())
+		throw NativeFnError("Float64Array passed to 'f64_min' is empty.");
+
+	return float64_min(a.elements.data(), a.elements.size());
+}
+
+static Object native_f64_max(Interpreter &, Arguments arguments)
+{
+	auto &a = float64_array(arguments[0], "f64_max");
+	if (a.elements.empty())
+		throw NativeFnError("Float64Array passed to 'f64_max' is empty.");
+
+	return float64_max(a.elements.data(), a.elements.size());
+}
+
+// Actor natives
+//---------------------------------------------------------
+
+static Object native_spawn(Interpreter &interpreter, Arguments arguments)
+{
+	interpreter.actor_scheduler().spawn(interpreter, arguments[0], arguments[1]);
+	return nullptr;
+}
+
+static Object native_channel(Interpreter &, Arguments)
+{
+	return std::make_shared<LoxChannel>();
+}
+
+// Returns the argument as a channel, throws if it is not one.
+static LoxChannel &channel(const Object &argument, const char *function)
+{
+	if (!match_types<LoxChannelPtr>(argument)) {
+		throw NativeFnError(
+			std::format("First argument to '{}' must be a channel.", function)
+		);
+	}
+
+	return *get<LoxChannelPtr>(argument);
+}
+
+static Object native_send(Interpreter &, Arguments arguments)
+{
+	channel(arguments[0], "send").send(arguments[1]);
+	return nullptr;
+}
+
+static Object native_receive(Interpreter &interpreter, Arguments arguments)
+{
+	return channel(arguments[0], "receive").receive(interpreter);
+}
+
+// Event loop natives
+//---------------------------------------------------------
+
+static Object native_task(Interpreter &interpreter, Arguments arguments)
+{
+	if (!match_types<LoxGeneratorPtr>(arguments[0]))
+		throw NativeFnError("Argument to 'task' must be a generator.");
+
+	interpreter.event_loop().add(get<LoxGeneratorPtr>(arguments[0]));
+	return nullptr;
+}
+
+static Object native_run_tasks(Interpreter &interpreter, Arguments)
+{
+	interpreter.event_loop().run(interpreter);
+	return nullptr;
+}
+
+// Native functions, defined in the globals of each interpreter
+struct FunctionEntry {
+	const char *name;
+	unsigned arity;
+	NativeFunction::Body body;
+};
+
+static constexpr FunctionEntry NATIVE_FUNCTIONS[] = {
+	{"clock", 0, native_clock},
+	{"sleep", 1, native_sleep},
+	{"string", 1, native_string},
+	{"instance_of", 2, native_instance_of},
+	{"Float64Array", 1, native_float64_array},
+	{"f64_add", 3, native_f64_add},
+	{"f64_mul", 3, native_f64_mul},
+	{"f64_scale", 3, native_f64_scale},
+	{"f64_fill", 2, native_f64_fill},
+	{"f64_dot", 2, native_f64_dot},
+	{"f64_sum", 1, native_f64_sum},
+	{"f64_min", 1, native_f64_min},
+	{"f64_max", 1, native_f64_max},
+	{"spawn", 2, native_spawn},
+	{"Channel", 0, native_channel},
+	{"send", 2, native_send},
+	{"receive", 1, native_receive},
+	{"task", 1, native_task},
+	{"run_tasks", 0, native_run_tasks},
+};
+
+void define_native_functions(Environment &globals)
+{
+	for (auto &function : NATIVE_FUNCTIONS) {
+		auto native = std::make_shared<NativeFunction>(
+			function.name, function.arity, function.body
+		);
+		globals.define(function.name, std::move(native));
+	}
+}
+
+// Built-in methods
+//---------------------------------------------------------
+
+static Object
+list_append(Interpreter &, const Object &self, Arguments arguments)
+{
+	auto &elements = get<LoxListPtr>(self)->elements;
+	elements.push_back(std::exchange(arguments[0], nullptr));
+	return nullptr;
+}
+
+static Object list_pop(Interpreter &, const Object &self, Arguments)
+{
+	auto &elements = get<LoxListPtr>(self)->elements;
+	if (elements.empty())
+		throw NativeFnError("Cannot pop from an empty list.");
+
+	auto last = std::move(elements.back());
+	elements.pop_back();
+	return last;
+}
+
+static Object list_len(Interpreter &, const Object &self, Arguments)
+{
+	return static_cast<double>(get<LoxListPtr>(self)->elements.size());
+}
+
+static Object map_len(Interpreter &, const Object &self, Arguments)
+{
+	return static_cast<double>(get<LoxMapPtr>(self)->size());
+}
+
+static Object map_has(Interpreter &, const Object &self, Arguments arguments)
+{
+	return get<LoxMapPtr>(self)->find(arguments[0]) != nullptr;
+}
+
+static Object map_remove(Interpreter &, const Object &self, Arguments arguments)
+{
+	return get<LoxMapPtr>(self)->remove(arguments[0]);
+}
+
+static Object map_keys(Interpreter &interpreter, const Object &self, Arguments)
+{
+	auto &map = *get<LoxMapPtr>(self);
+	interpreter.count_allocation(
+		AllocationProfiler::Kind::List,
+		sizeof(LoxList) + map.size() * sizeof(Object)
+	);
+	return std::make_shared<LoxList>(map.keys());
+}
+
+static Object
+map_values(Interpreter &interpreter, const Object &self, Arguments)
+{
+	auto &map = *get<LoxMapPtr>(self);
+	interpreter.count_allocation(
+		AllocationProfiler::Kind::List,
+		sizeof(LoxList) + map.size() * sizeof(Object)
+	);
+	return std::make_shared<LoxList>(map.values());
+}
+
+static Object float64_array_len(Interpreter &, const Object &self, Arguments)
+{
+	return static_cast<double>(get<LoxFloat64ArrayPtr>(self)->elements.size());
+}
+
+static Object
+generator_next(Interpreter &interpreter, const Object &self, Arguments)
+{
+	return get<LoxGeneratorPtr>(self)->resume(interpreter, nullptr);
+}
+
+static Object generator_send(
+	Interpreter &interpreter, const Object &self, Arguments arguments
+)
+{
+	return get<LoxGeneratorPtr>(self)->resume(interpreter, arguments[0]);
+}
+
+static Object generator_done(Interpreter &, const Object &self, Arguments)
+{
+	return get<LoxGeneratorPtr>(self)->done();
+}
+
+struct MethodEntry {
+	const char *name;
+	unsigned arity;
+	BuiltinMethod::Body body;
+};
+
+static constexpr MethodEntry LIST_METHODS[] = {
+	{"append", 1, list_append},
+	{"pop", 0, list_pop},
+	{"len", 0, list_len},
+};
+
+static constexpr MethodEntry MAP_METHODS[] = {
+	{"len", 0, map_len},
+	{"has", 1, map_has},
+	{"remove", 1, map_remove},
+	{"keys", 0, map_keys},
+	{"values", 0, map_values},
+};
+
+static constexpr MethodEntry FLOAT64_ARRAY_METHODS[] = {
+	{"len", 0, float64_array_len},
+};
+
+static constexpr MethodEntry GENERATOR_METHODS[] = {
+	{"next", 0, generator_next},
+	{"send", 1, generator_send},
+	{"done", 0, generator_done},
+};
+
+Object get_builtin_method(const Object &object, const Token &name)
+{
+	auto bind = [&](const auto &methods) -> Object {
+		for (auto &method : methods) {
+			if (name.lexeme == method.name) {
+				return std::make_shared<BuiltinMethod>(
+					method.name, method.arity, method.body, object
+				);
+			}
+		}
+
+		throw RuntimeError(
+			name, std::format("Undefined property '{}'.", name.lexeme)
+		);
+	};
+
+	if (match_types<LoxListPtr>(object))
+		return bind(LIST_METHODS);
+	if (match_types<LoxMapPtr>(object))
+		return bind(MAP_METHODS);
+	if (match_types<LoxFloat64ArrayPtr>(object))
+		return bind(FLOAT64_ARRAY_METHODS);
+	if (match_types<LoxGeneratorPtr>(object))
+		return bind(GENERATOR_METHODS);
+
+	throw RuntimeError(name, "Only instances, collections and generators have properties.");
+}
@@ -1,29 +1,129 @@
 #ifndef NATIVE_HXX_INCLUDED
 #define NATIVE_HXX_INCLUDED
 
+#include <functional>
 #include <string>
-#include <vector>
+#include <utility>
 
 #include "object.hxx"
+#include "token.hxx"
 #include "lox_callable.hxx"
 
 class Interpreter;
+class Environment;
 
-#define GENERATE_NATIVE_FUNCTION(class_name, arity_expr, name_str)  \
-	struct class_name : public LoxCallable {                        \
-		unsigned arity() const override { return arity_expr; }      \
-		std::string to_string() const override { return name_str; } \
-		Object call(Interpreter &, std::vector<Object> &) override; \
+// Native(built-in) function, a plain function pointer. They are listed in a
+// table in native.cxx: clock, sleep, string and instance_of, Float64Array
+// and its bulk operations, the actors and channels, and the event loop tasks.
+class NativeFunction final : public LoxCallable
+{
+public:
+	using Body = Object (*)(Interpreter &interpreter, Arguments arguments);
+
+	NativeFunction(const char *name_, unsigned arity_, Body body_)
+		: LoxCallable(Kind::Native)
+		, name(name_)
+		, function_arity(arity_)
+		, body(body_)
+	{
+	}
+
+	unsigned arity() const { return function_arity; }
+
+	std::string to_string() const
+	{
+		return std::string("<native-fn ") + name + ">";
+	}
+
+	Object call(Interpreter &interpreter, Arguments arguments)
+	{
+		return body(interpreter, arguments);
+	}
+
+private:
+	const char *name;
+	unsigned function_arity;
+	Body body;
+};
+
+/// Defines each native function in the environment, the globals.
+void define_native_functions(Environment &globals);
+
+// Native function defined by the program embedding the interpreter.
+class HostFunction final : public LoxCallable
+{
+public:
+	using Body = std::function<Object(Arguments arguments)>;
+
+	HostFunction(const std::string &name_, unsigned arity_, Body body_)
+		: LoxCallable(Kind::Host)
+		, name(name_)
+		, function_arity(arity_)
+		, body(std::move(body_))
+	{
+	}
+
+	unsigned arity() const { return function_arity; }
+
+	std::string to_string() const
+	{
+		return "<native-fn " + name + ">";
+	}
+
+	Object call(Interpreter &, Arguments arguments)
+	{
+		return body(arguments);
+	}
+
+private:
+	std::string name;
+	unsigned function_arity;
+	Body body;
+};
+
+// Built-in method of a list, map or generator, bound to it.
+class BuiltinMethod final : public LoxCallable
+{
+public:
+	using Body = Object (*)(
+		Interpreter &interpreter, const Object &self, Arguments arguments
+	);
+
+	BuiltinMethod(const char *name_, unsigned arity_, Body body_, Object self_)
+		: LoxCallable(Kind::BuiltinMethod)
+		, name(name_)
+		, method_arity(arity_)
+		, body(body_)
+		, self(std::move(self_))
+	{
+	}
+
+	unsigned arity() const { return method_arity; }
+
+	std::string to_string() const
+	{
+		return std::string("<native-method ") + name + ">";
 	}
 
-// Native(built-in) functions
-GENERATE_NATIVE_FUNCTION(ClockFn, 0, "<native-fn clock>");
-GENERATE_NATIVE_FUNCTION(SleepFn, 1, "<native-fn sleep>");
-GENERATE_NATIVE_FUNCTION(StringFn, 1, "<native-fn string>");
-GENERATE_NATIVE_FUNCTION(InstanceOfFn, 2, "<native-fn instance_of>");
+	Object call(Interpreter &interpreter, Arguments arguments)
+	{
+		return body(interpreter, self, arguments);
+	}
 
-#undef GENERATE_NATIVE_FUNCTION
+	const char *name;
+	unsigned method_arity;
+	Body body;
+	// The list, map or generator
+	Object self;
+};
 
+// Returns the method of a list, map, Float64Array or generator bound to it.
+// List methods: append(value), pop(), len()
+// Map methods: len(), has(key), remove(key), keys(), values()
+// Float64Array methods: len()
+// Generator methods: next(), send(value), done()
+// Throws a RuntimeError if there is no such method.
+Object get_builtin_method(const Object &object, const Token &name);
 
 
 #endif
\ No newline at end of file
@@ -1,3 +1,5 @@
+#include <charconv>
+#include <cmath>
 #include <cstddef>
 #include <string>
 #include <variant>
@@ -6,39 +8,39 @@
 #include "lox_callable.hxx"
 #include "lox_class.hxx"
 #include "lox_instance.hxx"
+#include "lox_list.hxx"
+#include "lox_map.hxx"
+#include "float64_array.hxx"
+#include "lox_channel.hxx"
+#include "lox_generator.hxx"
 
 using std::get;
 using std::string;
 
-static string double_to_string_trimmed(double val)
+char *format_number(double number, char *first)
 {
-	auto str = std::to_string(val);
-	auto is_zeros = [](const string &s) -> bool {
-		for (auto c : s) {
-			if (c != '0')
-				return false;
-		}
-		return true;
-	};
+	// Integers up to 2^53 are exact, write them out in full
+	constexpr double MAX_EXACT_INTEGER = 9007199254740992.0;
+	auto last = first + MAX_NUMBER_CHARS;
 
-	// Remove the fractional part if it is zero
-	if (auto at = str.find('.');
-		at != string::npos && is_zeros(str.substr(at + 1))) {
-		return str.substr(0, at);
-	}
-
-	return str;
+	if (std::trunc(number) == number && std::abs(number) <= MAX_EXACT_INTEGER)
+		return std::to_chars(first, last, number, std::chars_format::fixed).ptr;
+	return std::to_chars(first, last, number).ptr;
 }
 
-// std::nullptr_t, std::string, LoxCallablePtr, LoxClassPtr, LoxInstancePtr, double, bool
+// std::nullptr_t, std::string, LoxCallablePtr, LoxClassPtr, LoxInstancePtr,
+// LoxListPtr, LoxMapPtr, LoxFloat64ArrayPtr, LoxChannelPtr, LoxGeneratorPtr,
+// double, bool
 string to_string(const Object &obj)
 {
 	if (auto ptr = get_if<std::nullptr_t>(&obj))
 		return "nil";
 	if (auto ptr = get_if<bool>(&obj))
 		return *ptr ? "true" : "false";
-	if (auto ptr = get_if<double>(&obj))
-		return double_to_string_trimmed(*ptr);
+	if (auto ptr = get_if<double>(&obj)) {
+		char buffer[MAX_NUMBER_CHARS];
+		return string(buffer, format_number(*ptr, buffer));
+	}
 	if (auto ptr = get_if<string>(&obj))
 		return *ptr;
 	if (auto ptr = get_if<LoxCallablePtr>(&obj))
@@ -47,7 +49,24 @@ string to_string(const Object &obj)
 		return (*ptr)->to_string();
 	if (auto ptr = get_if<LoxInstancePtr>(&obj))
 		return (*ptr)->to_string();
+	if (auto ptr = get_if<LoxListPtr>(&obj))
+		return (*ptr)->to_string();
+	if (auto ptr = get_if<LoxMapPtr>(&obj))
+		return (*ptr)->to_string();
+	if (auto ptr = get_if<LoxFloat64ArrayPtr>(&obj))
+		return (*ptr)->to_string();
+	if (auto ptr = get_if<LoxChannelPtr>(&obj))
+		return (*ptr)->to_string();
+	if (auto ptr = get_if<LoxGeneratorPtr>(&obj))
+		return (*ptr)->to_string();
 
 	assert(!"Unreachable code");
 	return "";
 }
+
+string to_element_string(const Object &obj)
+{
+	if (auto ptr = get_if<string>(&obj))
+		return '"' + *ptr + '"';
+	return to_string(obj);
+}
@@ -12,11 +12,21 @@
 class LoxCallable;
 class LoxClass;
 class LoxInstance;
+class LoxList;
+class LoxMap;
+class LoxFloat64Array;
+class LoxChannel;
+class LoxGenerator;
 class Interpreter;
 
 using LoxCallablePtr = std::shared_ptr<LoxCallable>;
 using LoxClassPtr = std::shared_ptr<LoxClass>;
 using LoxInstancePtr = std::shared_ptr<LoxInstance>;
+using LoxListPtr = std::shared_ptr<LoxList>;
+using LoxMapPtr = std::shared_ptr<LoxMap>;
+using LoxFloat64ArrayPtr = std::shared_ptr<LoxFloat64Array>;
+using LoxChannelPtr = std::shared_ptr<LoxChannel>;
+using LoxGeneratorPtr = std::shared_ptr<LoxGenerator>;
 
 // The Lox object type
 // Represents all the in-built types supported by Lox
@@ -25,10 +35,21 @@ using LoxInstancePtr = std::shared_ptr<LoxInstance>;
 // type and not behind a polymorphic pointer to LoxCallable.
 using Object = std::variant<
 	std::nullptr_t, bool, double, std::string, LoxCallablePtr, LoxClassPtr,
-	LoxInstancePtr>;
+	LoxInstancePtr, LoxListPtr, LoxMapPtr, LoxFloat64ArrayPtr, LoxChannelPtr,
+	LoxGeneratorPtr>;
 
 std::string to_string(const Object &obj);
 
+// Same as to_string, but strings are quoted. For elements of lists and maps.
+std::string to_element_string(const Object &obj);
+
+// Longest text written by format_number
+constexpr std::size_t MAX_NUMBER_CHARS = 32;
+
+// Writes the shortest text which reads back as the same number, integers
+// are written without a fractional part or exponent. Returns the end.
+char *format_number(double number, char *first);
+
 // Returns true if all primitives hold the value of the corresponding given type.
 // Precisely: If for every object
 // nth object holds the value of the type represented
@@ -47,4 +68,16 @@ inline bool match_types(const Objects &...objects)
 	return all_match;
 }
 
+// Lox truthiness: nil and false are falsey, everything else is truthy.
+inline bool is_truthy(const Object &obj)
+{
+	if (match_types<std::nullptr_t>(obj))
+		return false;
+
+	if (match_types<bool>(obj))
+		return std::get<bool>(obj);
+
+	return true;
+}
+
 #endif
\ No newline at end of file
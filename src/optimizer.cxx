@@ -0,0 +1,494 @@
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+#include "runtime_error.hxx"
+#include "token_type.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "optimizer.hxx"
+#include "type_inference.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+
+using enum TokenType;
+using std::make_unique;
+
+// Maximum number of nodes in an inlined expression
+constexpr unsigned MAX_INLINE_NODES = 24;
+
+// Helper functions
+//---------------------------------------------------------
+
+// The visitor methods receive const nodes, but the optimizer owns the tree.
+template <typename T>
+static T &mutate(const T &node)
+{
+	return const_cast<T &>(node);
+}
+
+static const Literal *as_literal(const Expr &expr)
+{
+	return dynamic_cast<const Literal *>(&expr);
+}
+
+// Statements after which the rest of the block is never executed.
+static bool is_terminator(const Stmt &stmt)
+{
+	return dynamic_cast<const Return *>(&stmt) != nullptr
+		|| dynamic_cast<const Break *>(&stmt) != nullptr
+		|| dynamic_cast<const Continue *>(&stmt) != nullptr;
+}
+
+// Optimizer interface methods
+//---------------------------------------------------------
+
+void Optimizer::optimize_program(std::vector<StmtPtr> &statements)
+{
+	for (auto &stmt : statements) {
+		if (auto function = dynamic_cast<const Function *>(stmt.get()))
+			add_inline_candidate(*function);
+	}
+
+	optimize(statements);
+
+	TypeInference type_inference(interpreter);
+	type_inference.specialize(statements);
+}
+
+void Optimizer::optimize_body(const Function &function)
+{
+	optimize(*function.body);
+
+	TypeInference type_inference(interpreter);
+	type_inference.specialize_function(function);
+}
+
+void Optimizer::optimize(std::vector<StmtPtr> &statements)
+{
+	for (auto iter = statements.begin(); iter != statements.end(); ++iter) {
+		optimize(*iter);
+
+		if (*iter != nullptr && is_terminator(**iter)) {
+			statements.erase(iter + 1, statements.end());
+			break;
+		}
+	}
+
+	std::erase(statements, nullptr);
+}
+
+void Optimizer::optimize(StmtPtr &stmt)
+{
+	stmt->accept(*this);
+
+	if (remove_stmt) {
+		remove_stmt = false;
+		stmt = nullptr;
+	} else if (stmt_replacement != nullptr) {
+		stmt = std::move(stmt_replacement);
+	}
+}
+
+void Optimizer::optimize(ExprPtr &expr)
+{
+	expr->accept(*this);
+
+	if (expr_replacement != nullptr)
+		expr = std::move(expr_replacement);
+}
+
+void Optimizer::optimize_branch(StmtPtr &stmt)
+{
+	optimize(stmt);
+	if (stmt == nullptr)
+		stmt = make_block();
+}
+
+void Optimizer::optimize_function(const Function &function)
+{
+	// Lazy bodies are optimized after they are compiled.
+	if (function.lazy_body && !function.lazy_body->compiled)
+		return;
+
+	optimize(*function.body);
+}
+
+ExprPtr Optimizer::fold(const Expr &expr)
+{
+	try {
+		return make_unique<Literal>(interpreter.evaluate(expr));
+	} catch (RuntimeError &) {
+		return nullptr;
+	}
+}
+
+void Optimizer::add_inline_candidate(const Function &function)
+{
+	auto &candidates = interpreter.inline_candidates;
+	// Drop the older function with the same name, if any.
+	candidates.erase(function.name.lexeme);
+
+	if (function.lazy_body && !function.lazy_body->compiled)
+		return;
+	if (function.params.size() > MAX_INLINE_PARAMS)
+		return;
+	if (function.body->size() != 1)
+		return;
+
+	auto ret = dynamic_cast<const Return *>(function.body->front().get());
+	if (ret == nullptr || ret->value == nullptr)
+		return;
+
+	unsigned budget = MAX_INLINE_NODES;
+	if (clone_inlinable(*ret->value, function.params, budget) == nullptr)
+		return;
+
+	candidates.insert({
+		function.name.lexeme,
+		{function.body, function.params},
+	});
+}
+
+ExprPtr Optimizer::clone_inlinable(
+	const Expr &expr, const std::vector<Token> &params, unsigned &budget
+)
+{
+	if (budget == 0)
+		return nullptr;
+	budget--;
+
+	auto clone = [&](const Expr &sub_expr) {
+		return clone_inlinable(sub_expr, params, budget);
+	};
+
+	if (auto literal = dynamic_cast<const Literal *>(&expr))
+		return make_unique<Literal>(literal->value);
+
+	if (auto variable = dynamic_cast<const Variable *>(&expr)) {
+		for (unsigned i = 0; i < params.size(); ++i) {
+			if (params[i].lexeme == variable->name.lexeme)
+				return make_unique<InlineParam>(variable->name, i);
+		}
+
+		// Anything else in a global function's body is global too.
+		auto global = make_unique<Variable>(variable->name);
+		interpreter.resolve_global(*global);
+		return global;
+	}
+
+	if (auto grouping = dynamic_cast<const Grouping *>(&expr))
+		return clone(*grouping->expression);
+
+	if (auto unary = dynamic_cast<const Unary *>(&expr)) {
+		auto right = clone(*unary->right);
+		if (right == nullptr)
+			return nullptr;
+		return make_unique<Unary>(unary->operat, std::move(right));
+	}
+
+	if (auto binary = dynamic_cast<const Binary *>(&expr)) {
+		auto left = clone(*binary->left);
+		auto right = left ? clone(*binary->right) : nullptr;
+		if (right == nullptr)
+			return nullptr;
+		return make_unique<Binary>(
+			std::move(left), binary->operat, std::move(right)
+		);
+	}
+
+	if (auto logical = dynamic_cast<const Logical *>(&expr)) {
+		auto left = clone(*logical->left);
+		auto right = left ? clone(*logical->right) : nullptr;
+		if (right == nullptr)
+			return nullptr;
+		return make_unique<Logical>(
+			std::move(left), logical->operat, std::move(right)
+		);
+	}
+
+	if (auto ternary = dynamic_cast<const Ternary *>(&expr)) {
+		auto condition = clone(*ternary->condition);
+		auto true_expr = condition ? clone(*ternary->true_expr) : nullptr;
+		auto false_expr = true_expr ? clone(*ternary->false_expr) : nullptr;
+		if (false_expr == nullptr)
+			return nullptr;
+		return make_unique<Ternary>(
+			std::move(condition), std::move(true_expr), std::move(false_expr)
+		);
+	}
+
+	if (auto get = dynamic_cast<const Get *>(&expr)) {
+		auto object = clone(*get->object);
+		if (object == nullptr)
+			return nullptr;
+		return make_unique<Get>(std::move(object), get->name);
+	}
+
+	// Calls, assignments and the rest are not inlined.
+	return nullptr;
+}
+
+// Statement visitor methods
+//-----------------------------------------------
+
+void Optimizer::visit_block_stmt(const Block &stmt)
+{
+	auto &node = mutate(stmt);
+	optimize(node.statements);
+	remove_stmt = node.statements.empty();
+}
+
+void Optimizer::visit_expr_stmt(const Expression &stmt)
+{
+	auto &node = mutate(stmt);
+	optimize(node.expression);
+	// Literals have no side effects
+	remove_stmt = as_literal(*node.expression) != nullptr;
+}
+
+void Optimizer::visit_print_stmt(const Print &stmt)
+{
+	optimize(mutate(stmt).expression);
+}
+
+void Optimizer::visit_assert_stmt(const Assert &stmt)
+{
+	auto &node = mutate(stmt);
+	optimize(node.expression);
+
+	auto literal = as_literal(*node.expression);
+	remove_stmt = literal != nullptr && is_truthy(literal->value);
+}
+
+void Optimizer::visit_return_stmt(const Return &stmt)
+{
+	auto &node = mutate(stmt);
+	if (node.value != nullptr)
+		optimize(node.value);
+}
+
+void Optimizer::visit_if_stmt(const If &stmt)
+{
+	auto &node = mutate(stmt);
+	optimize(node.condition);
+	optimize_branch(node.then_branch);
+	if (node.else_branch != nullptr)
+		optimize(node.else_branch);
+
+	auto literal = as_literal(*node.condition);
+	if (literal == nullptr)
+		return;
+
+	if (is_truthy(literal->value))
+		stmt_replacement = std::move(node.then_branch);
+	else if (node.else_branch != nullptr)
+		stmt_replacement = std::move(node.else_branch);
+	else
+		remove_stmt = true;
+}
+
+void Optimizer::visit_while_stmt(const While &stmt)
+{
+	auto &node = mutate(stmt);
+	optimize(node.condition);
+
+	auto literal = as_literal(*node.condition);
+	if (literal != nullptr && !is_truthy(literal->value)) {
+		remove_stmt = true;
+		return;
+	}
+
+	if (node.counted != nullptr)
+		optimize(node.counted->limit);
+	optimize_branch(node.body);
+	if (node.for_update != nullptr)
+		optimize(node.for_update);
+}
+
+void Optimizer::visit_var_stmt(const Var &stmt)
+{
+	optimize(mutate(stmt).initializer);
+}
+
+void Optimizer::visit_function_stmt(const Function &stmt)
+{
+	optimize_function(stmt);
+}
+
+void Optimizer::visit_class_stmt(const Class &stmt)
+{
+	for (auto &method : stmt.methods)
+		optimize_function(method);
+}
+
+// Expression visitor methods
+//-----------------------------------------------
+
+Object Optimizer::visit_assign_expr(const Assign &expr)
+{
+	optimize(mutate(expr).expression);
+	return nullptr;
+}
+
+Object Optimizer::visit_ternary_expr(const Ternary &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.condition);
+	optimize(node.true_expr);
+	optimize(node.false_expr);
+
+	if (auto literal = as_literal(*node.condition)) {
+		expr_replacement = std::move(
+			is_truthy(literal->value) ? node.true_expr : node.false_expr
+		);
+	}
+	return nullptr;
+}
+
+Object Optimizer::visit_logical_expr(const Logical &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.left);
+	optimize(node.right);
+
+	// The result is the value of the operand which decided it
+	if (auto literal = as_literal(*node.left)) {
+		bool short_circuits = (node.operat.type == OR)
+			== is_truthy(literal->value);
+		expr_replacement = std::move(short_circuits ? node.left : node.right);
+	}
+	return nullptr;
+}
+
+Object Optimizer::visit_binary_expr(const Binary &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.left);
+	optimize(node.right);
+
+	if (as_literal(*node.left) && as_literal(*node.right))
+		expr_replacement = fold(expr);
+	return nullptr;
+}
+
+Object Optimizer::visit_call_expr(const Call &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.callee);
+	for (auto &arg : node.arguments)
+		optimize(arg);
+
+	// Only calls of global functions by their name are inlined
+	auto callee = dynamic_cast<const Variable *>(node.callee.get());
+	if (callee == nullptr || interpreter.locals.contains(callee))
+		return nullptr;
+
+	auto &name = callee->name.lexeme;
+	auto candidate = interpreter.inline_candidates.find(name);
+	if (candidate == interpreter.inline_candidates.end())
+		return nullptr;
+
+	auto &[body, params] = candidate->second;
+	auto writes = interpreter.global_writes.find(name);
+	if (writes == interpreter.global_writes.end() || writes->second != 1)
+		return nullptr;
+	if (params.size() != node.arguments.size())
+		return nullptr;
+
+	// The body may have been optimized since it was added, check again.
+	auto ret = body->size() == 1
+		? dynamic_cast<const Return *>(body->front().get())
+		: nullptr;
+	if (ret == nullptr)
+		return nullptr;
+
+	unsigned budget = MAX_INLINE_NODES;
+	auto inlined = clone_inlinable(*ret->value, params, budget);
+	if (inlined == nullptr)
+		return nullptr;
+
+	auto call = make_unique<Call>(
+		std::move(node.callee), node.paren, std::move(node.arguments)
+	);
+	expr_replacement =
+		make_unique<InlineCall>(std::move(call), body, std::move(inlined));
+	interpreter.stats.inlined_sites++;
+	return nullptr;
+}
+
+Object Optimizer::visit_get_expr(const Get &expr)
+{
+	optimize(mutate(expr).object);
+	return nullptr;
+}
+
+Object Optimizer::visit_set_expr(const Set &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.object);
+	optimize(node.value);
+	return nullptr;
+}
+
+Object Optimizer::visit_list_literal_expr(const ListLiteral &expr)
+{
+	for (auto &element : mutate(expr).elements)
+		optimize(element);
+	return nullptr;
+}
+
+Object Optimizer::visit_map_literal_expr(const MapLiteral &expr)
+{
+	auto &node = mutate(expr);
+	for (std::size_t i = 0; i < node.keys.size(); ++i) {
+		optimize(node.keys[i]);
+		optimize(node.values[i]);
+	}
+	return nullptr;
+}
+
+Object Optimizer::visit_subscript_expr(const Subscript &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.object);
+	optimize(node.index);
+	return nullptr;
+}
+
+Object Optimizer::visit_subscript_set_expr(const SubscriptSet &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.object);
+	optimize(node.index);
+	optimize(node.value);
+	return nullptr;
+}
+
+Object Optimizer::visit_yield_expr(const Yield &expr)
+{
+	auto &node = mutate(expr);
+	if (node.value != nullptr)
+		optimize(node.value);
+	return nullptr;
+}
+
+Object Optimizer::visit_grouping_expr(const Grouping &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.expression);
+	expr_replacement = std::move(node.expression);
+	return nullptr;
+}
+
+Object Optimizer::visit_unary_expr(const Unary &expr)
+{
+	auto &node = mutate(expr);
+	optimize(node.right);
+
+	if (as_literal(*node.right))
+		expr_replacement = fold(expr);
+	return nullptr;
+}
@@ -0,0 +1,111 @@
+#ifndef OPTIMIZER_HXX_INCLUDED
+#define OPTIMIZER_HXX_INCLUDED
+
+#include <vector>
+
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "object/object.hxx"
+
+class Interpreter;
+
+// Rewrites the resolved AST in place before it is interpreted.
+// It folds constant expressions, removes unreachable branches and statements
+// and drops grouping wrappers. Constant expressions that fail with a runtime
+// error are kept as they are, so that the error is reported when executed.
+//
+// Calls of small global functions are inlined, if the function's body is
+// a single return statement without any calls or assignments in it and the
+// global is declared only once and never assigned to. See InlineCall.
+//
+// Finally, TypeInference specializes the numeric expressions.
+class Optimizer : private StmtVisitor, private ExprVisitor
+{
+public:
+	Optimizer(Interpreter &interpreter_)
+		: interpreter(interpreter_)
+	{
+	}
+
+	/// Optimizes a program, the top-level statements.
+	void optimize_program(std::vector<StmtPtr> &statements);
+
+	/// Optimizes a lazily compiled function body.
+	void optimize_body(const Function &function);
+
+	void optimize(std::vector<StmtPtr> &statements);
+
+	void visit_block_stmt(const Block &stmt) override;
+	void visit_expr_stmt(const Expression &stmt) override;
+	void visit_print_stmt(const Print &stmt) override;
+	void visit_assert_stmt(const Assert &stmt) override;
+	void visit_break_stmt(const Break &) override {}
+	void visit_continue_stmt(const Continue &) override {}
+	void visit_return_stmt(const Return &stmt) override;
+	void visit_if_stmt(const If &stmt) override;
+	void visit_while_stmt(const While &stmt) override;
+	void visit_var_stmt(const Var &stmt) override;
+	void visit_function_stmt(const Function &stmt) override;
+	void visit_class_stmt(const Class &stmt) override;
+
+	Object visit_assign_expr(const Assign &expr) override;
+	Object visit_ternary_expr(const Ternary &expr) override;
+	Object visit_logical_expr(const Logical &expr) override;
+	Object visit_binary_expr(const Binary &expr) override;
+	Object visit_call_expr(const Call &expr) override;
+	Object visit_get_expr(const Get &expr) override;
+	Object visit_set_expr(const Set &expr) override;
+	Object visit_super_expr(const Super &) override { return nullptr; }
+	Object visit_this_expr(const This &) override { return nullptr; }
+	Object visit_grouping_expr(const Grouping &expr) override;
+	Object visit_literal_expr(const Literal &) override { return nullptr; }
+	Object visit_unary_expr(const Unary &expr) override;
+	Object visit_variable_expr(const Variable &) override { return nullptr; }
+	Object visit_list_literal_expr(const ListLiteral &expr) override;
+	Object visit_map_literal_expr(const MapLiteral &expr) override;
+	Object visit_subscript_expr(const Subscript &expr) override;
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override;
+	Object visit_yield_expr(const Yield &expr) override;
+	Object visit_inline_call_expr(const InlineCall &) override
+	{
+		return nullptr;
+	}
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		return nullptr;
+	}
+	Object visit_numeric_expr(const Numeric &) override { return nullptr; }
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return nullptr;
+	}
+
+private:
+	// Optimize the node held and replace it if the visitor asked for it.
+	void optimize(StmtPtr &stmt);
+	void optimize(ExprPtr &expr);
+	// For statements which must always exist, like a loop body.
+	void optimize_branch(StmtPtr &stmt);
+	void optimize_function(const Function &function);
+
+	// Evaluates a constant expression and returns a Literal for its value.
+	// Returns nullptr if the evaluation throws a runtime error.
+	ExprPtr fold(const Expr &expr);
+
+	// Adds the function to the inline candidates if it can be inlined.
+	void add_inline_candidate(const Function &function);
+	// Copies the return value expression of an inlined function, replacing
+	// its parameters with InlineParam. Returns nullptr if it cannot be inlined.
+	ExprPtr clone_inlinable(
+		const Expr &expr, const std::vector<Token> &params, unsigned &budget
+	);
+
+	Interpreter &interpreter;
+
+	// Set by the visitor methods to replace the node visited
+	ExprPtr expr_replacement;
+	StmtPtr stmt_replacement;
+	bool remove_stmt = false;
+};
+
+#endif
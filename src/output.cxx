@@ -0,0 +1,78 @@
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <variant>
+
+#include "output.hxx"
+#include "object/object.hxx"
+
+OutputSink::OutputSink(OutputSink &other)
+	: target(other.target)
+{
+	if (other.target_mutex == nullptr)
+		other.target_mutex = std::make_shared<std::mutex>();
+	target_mutex = other.target_mutex;
+	set_capacity(other.capacity);
+}
+
+void OutputSink::set_capacity(std::size_t capacity_)
+{
+	flush();
+	capacity = capacity_;
+	buffer.reserve(capacity);
+}
+
+void OutputSink::write(std::string_view text)
+{
+	if (buffer.size() + text.size() > capacity)
+		flush();
+
+	// Too large to be worth buffering
+	if (text.size() >= capacity) {
+		write_out(text);
+		return;
+	}
+
+	buffer.append(text);
+}
+
+void OutputSink::write(char c)
+{
+	buffer.push_back(c);
+	if (buffer.size() >= capacity)
+		flush();
+}
+
+void OutputSink::write_value(const Object &value)
+{
+	// Numbers and strings are written without a temporary string
+	if (auto number = std::get_if<double>(&value)) {
+		char text[MAX_NUMBER_CHARS];
+		write(std::string_view(text, format_number(*number, text)));
+	} else if (auto str = std::get_if<std::string>(&value)) {
+		write(std::string_view(*str));
+	} else {
+		write(std::string_view(to_string(value)));
+	}
+}
+
+void OutputSink::flush()
+{
+	if (buffer.empty())
+		return;
+
+	write_out(buffer);
+	buffer.clear();
+}
+
+void OutputSink::write_out(std::string_view text)
+{
+	std::unique_lock<std::mutex> lock;
+	if (target_mutex != nullptr)
+		lock = std::unique_lock(*target_mutex);
+
+	target.write(text.data(), text.size());
+	target.flush();
+}
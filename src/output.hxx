@@ -0,0 +1,56 @@
+#ifndef OUTPUT_HXX_INCLUDED
+#define OUTPUT_HXX_INCLUDED
+
+#include <cstddef>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "object/object.hxx"
+
+// Buffered writer for everything printed by the interpreter, the output of
+// the program and the error messages, so that they stay in order.
+// It is flushed when full, on every error, after each line in the REPL and
+// at exit.
+class OutputSink
+{
+public:
+	static constexpr std::size_t DEFAULT_CAPACITY = 64 * 1024;
+
+	OutputSink(std::ostream &target_, std::size_t capacity_ = DEFAULT_CAPACITY)
+		: target(target_)
+	{
+		set_capacity(capacity_);
+	}
+
+	/// Writes to the same stream as other, which may be used by another
+	/// thread. Each buffer written out stays in one piece.
+	OutputSink(OutputSink &other);
+
+	OutputSink(const OutputSink &) = delete;
+	OutputSink &operator=(const OutputSink &) = delete;
+	~OutputSink() { flush(); }
+
+	/// Buffers up to capacity bytes, 1 writes everything right away.
+	void set_capacity(std::size_t capacity_);
+
+	void write(std::string_view text);
+	void write(char c);
+	/// Writes the value as the print statement does.
+	void write_value(const Object &value);
+
+	void flush();
+
+private:
+	void write_out(std::string_view text);
+
+	std::ostream &target;
+	// Set once the target is shared by several sinks
+	std::shared_ptr<std::mutex> target_mutex;
+	std::string buffer;
+	std::size_t capacity = DEFAULT_CAPACITY;
+};
+
+#endif
@@ -6,12 +6,14 @@
 #include <string_view>
 #include <typeinfo>
 #include <optional>
+#include <variant>
 #include <initializer_list>
 
 #include "token.hxx"
 #include "token_type.hxx"
 #include "expr.hxx"
 #include "parser.hxx"
+#include "object/object.hxx"
 
 using enum TokenType;
 using std::format;
@@ -107,7 +109,7 @@ Function Parser::function(std::string_view kind)
 	if (!check(RIGHT_PAREN)) {
 		do {
 			if (parameters.size() >= MAX_PARAMS) {
-				print_error(
+				errors.print_error(
 					peek(),
 					format("Can't have more than {} parameters.", MAX_PARAMS)
 				);
@@ -119,9 +121,25 @@ Function Parser::function(std::string_view kind)
 	consume(RIGHT_PAREN, "Expect ')' after parameters.");
 
 	consume(LEFT_BRACE, format("Expect '{{' before {} body.", kind));
+
+	// Only top-level functions and methods are pre-parsed, so that a body
+	// once compiled is complete along with all the closures inside it.
+	if (lazy_functions && nesting == 0) {
+		auto lazy_body = skip_body();
+		return Function(
+			name, std::move(parameters),
+			std::make_shared<std::vector<StmtPtr>>(), std::move(lazy_body)
+		);
+	}
+
+	auto enclosing_has_yield = std::exchange(has_yield, false);
+	nesting++;
 	auto body = std::make_shared<std::vector<StmtPtr>>(bare_block());
+	nesting--;
 
-	return Function(name, std::move(parameters), std::move(body));
+	Function function(name, std::move(parameters), std::move(body));
+	function.has_yield = std::exchange(has_yield, enclosing_has_yield);
+	return function;
 }
 
 StmtPtr Parser::var_declaration()
@@ -237,6 +255,7 @@ StmtPtr Parser::for_statement()
 		initializer = expression_statement();
 
 	ExprPtr condition = nullptr;
+	auto condition_begin = current;
 	if (!check(SEMICOLON))
 		condition = expression();
 	consume(SEMICOLON, "Expect ';' after loop condition.");
@@ -247,6 +266,9 @@ StmtPtr Parser::for_statement()
 	consume(RIGHT_PAREN, "Expect ')' after for clauses.");
 
 	auto body = statement();
+	auto counted = counted_loop(
+		initializer.get(), condition.get(), condition_begin, increment.get()
+	);
 
 	// A 'for' loop is just a syntactic sugar for the while loop.
 	// The below two are equaivalent:
@@ -262,16 +284,80 @@ StmtPtr Parser::for_statement()
 	// Increment clause is required to seperately for supporting
 	// continue statements in the 'for' loop.
 	auto loop = make_unique<While>(
-		std::move(condition), std::move(body), std::move(increment)
+		std::move(condition), std::move(body), std::move(increment),
+		std::move(counted)
 	);
 
-	if (initializer != nullptr)
-		body = make_block(std::move(initializer), std::move(loop));
+	if (initializer == nullptr)
+		return loop;
+	return make_block(std::move(initializer), std::move(loop));
+}
+
+std::unique_ptr<CountedLoop> Parser::counted_loop(
+	const Stmt *initializer, const Expr *condition,
+	vector<Token>::size_type condition_begin, const Expr *increment
+)
+{
+	auto is_counter = [&](const Expr *expr, const Token &name) {
+		auto variable = dynamic_cast<const Variable *>(expr);
+		return variable != nullptr && variable->name.lexeme == name.lexeme;
+	};
+
+	// var i = ...;
+	auto var = dynamic_cast<const Var *>(initializer);
+	if (var == nullptr)
+		return nullptr;
+
+	// i < limit
+	auto compare = dynamic_cast<const Binary *>(condition);
+	if (compare == nullptr || !is_counter(compare->left.get(), var->name))
+		return nullptr;
+	switch (compare->operat.type) {
+	case LESS:
+	case LESS_EQUAL:
+	case GREATER:
+	case GREATER_EQUAL:
+		break;
+	default:
+		return nullptr;
+	}
+
+	// i = i + step
+	auto update = dynamic_cast<const Assign *>(increment);
+	if (update == nullptr || update->name.lexeme != var->name.lexeme)
+		return nullptr;
+	auto add = dynamic_cast<const Binary *>(update->expression.get());
+	if (add == nullptr || !is_counter(add->left.get(), var->name))
+		return nullptr;
+	if (add->operat.type != PLUS && add->operat.type != MINUS)
+		return nullptr;
+	auto step = dynamic_cast<const Literal *>(add->right.get());
+	if (step == nullptr || !match_types<double>(step->value))
+		return nullptr;
 
-	return body;
+	// The counted loop gets a copy of the limit by parsing it again, it
+	// begins after the counter and the comparison operator.
+	auto saved_current = current;
+	current = condition_begin + 2;
+	auto limit = term();
+	current = saved_current;
+
+	double value = std::get<double>(step->value);
+	return make_unique<CountedLoop>(
+		var->name, compare->operat, std::move(limit),
+		add->operat.type == PLUS ? value : -value
+	);
 }
 
-StmtPtr Parser::block() { return make_unique<Block>(bare_block()); }
+StmtPtr Parser::block()
+{
+	int line = previous().line;
+	nesting++;
+	auto statements = bare_block();
+	nesting--;
+
+	return make_unique<Block>(std::move(statements), line);
+}
 
 StmtPtr Parser::expression_statement()
 {
@@ -291,6 +377,56 @@ std::vector<StmtPtr> Parser::bare_block()
 	return statements;
 }
 
+std::shared_ptr<LazyBody> Parser::skip_body()
+{
+	auto lazy_body = std::make_shared<LazyBody>(tokens, current);
+
+	// Stack of the currently open brackets, the body's own brace included
+	vector<TokenType> open{LEFT_BRACE};
+
+	while (!open.empty()) {
+		if (is_at_end())
+			throw make_error(peek(), "Expect '}' after block.");
+
+		auto token = advance();
+		switch (token.type) {
+		case LEFT_PAREN:
+		case LEFT_BRACE:
+			open.push_back(token.type);
+			break;
+
+		case RIGHT_PAREN:
+		case RIGHT_BRACE: {
+			auto expected = token.type == RIGHT_PAREN ? LEFT_PAREN : LEFT_BRACE;
+			if (open.back() != expected)
+				throw make_error(token, "Unbalanced brackets in function body.");
+			open.pop_back();
+			break;
+		}
+
+		default:
+			break;
+		}
+	}
+
+	return lazy_body;
+}
+
+std::vector<StmtPtr>
+Parser::parse_lazy_body(LazyBody &lazy, ErrorReporter &errors)
+{
+	Parser parser(lazy.tokens, lazy.begin, errors);
+	parser.nesting = 1;
+
+	try {
+		auto statements = parser.bare_block();
+		lazy.has_yield = parser.has_yield;
+		return statements;
+	} catch (const ParseError &) {
+		return {};
+	}
+}
+
 // Expression parsing
 //---------------------------------------------------------
 
@@ -298,6 +434,9 @@ ExprPtr Parser::expression() { return assignment(); }
 
 ExprPtr Parser::assignment()
 {
+	if (match({YIELD}))
+		return yield();
+
 	// Since the '=' can be any-number of tokens ahead,
 	// parse the left hand side and then check for equal sign.
 	// Then, check if the assingment target is valid.
@@ -321,14 +460,33 @@ ExprPtr Parser::assignment()
 			return make_unique<Set>(
 				std::move(get.object), get.name, std::move(value)
 			);
+		}
+		// Same for Subscript(like: object[index])
+		else if (typeid(expr_ref) == typeid(Subscript)) {
+			auto &subscript = dynamic_cast<Subscript &>(*expr);
+			return make_unique<SubscriptSet>(
+				std::move(subscript.object), subscript.bracket,
+				std::move(subscript.index), std::move(value)
+			);
 		} else {
-			print_error(equals, "Invalid assignment target.");
+			errors.print_error(equals, "Invalid assignment target.");
 		}
 	}
 
 	return expr;
 }
 
+ExprPtr Parser::yield()
+{
+	auto keyword = previous();
+	ExprPtr value = nullptr;
+	if (!check(SEMICOLON) && !check(RIGHT_PAREN))
+		value = assignment();
+
+	has_yield = true;
+	return make_unique<Yield>(keyword, std::move(value));
+}
+
 ExprPtr Parser::ternary()
 {
 	auto expr = logic_or();
@@ -384,6 +542,13 @@ ExprPtr Parser::call()
 			expr = make_unique<Get>(std::move(expr), name);
 		} else if (match({LEFT_PAREN})) {
 			expr = finish_call(std::move(expr));
+		} else if (match({LEFT_BRACKET})) {
+			auto bracket = previous();
+			auto index = expression();
+			consume(RIGHT_BRACKET, "Expect ']' after index.");
+			expr = make_unique<Subscript>(
+				std::move(expr), bracket, std::move(index)
+			);
 		} else {
 			break;
 		}
@@ -423,9 +588,47 @@ ExprPtr Parser::primary()
 		return make_unique<Grouping>(std::move(expr));
 	}
 
+	if (match({LEFT_BRACKET}))
+		return list_literal();
+	if (match({LEFT_BRACE}))
+		return map_literal();
+
 	throw make_error(peek(), "Expect expression.");
 }
 
+ExprPtr Parser::list_literal()
+{
+	auto bracket = previous();
+	vector<ExprPtr> elements;
+
+	if (!check(RIGHT_BRACKET)) {
+		do {
+			elements.push_back(expression());
+		} while (match({COMMA}));
+	}
+
+	consume(RIGHT_BRACKET, "Expect ']' after list elements.");
+	return make_unique<ListLiteral>(bracket, std::move(elements));
+}
+
+ExprPtr Parser::map_literal()
+{
+	auto brace = previous();
+	vector<ExprPtr> keys;
+	vector<ExprPtr> values;
+
+	if (!check(RIGHT_BRACE)) {
+		do {
+			keys.push_back(expression());
+			consume(COLON, "Expect ':' after map key.");
+			values.push_back(expression());
+		} while (match({COMMA}));
+	}
+
+	consume(RIGHT_BRACE, "Expect '}' after map entries.");
+	return make_unique<MapLiteral>(brace, std::move(keys), std::move(values));
+}
+
 ExprPtr Parser::finish_call(ExprPtr callee)
 {
 	vector<ExprPtr> arguments;
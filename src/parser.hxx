@@ -22,17 +22,40 @@ struct ParseError : public std::runtime_error {
 class Parser
 {
 public:
-	Parser(const std::vector<Token> &tokens_)
-		: tokens(tokens_)
+	/// @param lazy_functions Only pre-parse the bodies of top-level functions
+	/// and methods, see LazyBody.
+	Parser(
+		std::vector<Token> tokens_, ErrorReporter &errors_,
+		bool lazy_functions_ = false
+	)
+		: tokens(std::make_shared<const std::vector<Token>>(std::move(tokens_)))
+		, errors(errors_)
+		, lazy_functions(lazy_functions_)
 	{
 	}
 
 	std::vector<StmtPtr> parse();
 
+	/// Parses a function body skipped by the pre-parser.
+	/// Returns an empty vector on failure.
+	static std::vector<StmtPtr>
+	parse_lazy_body(LazyBody &lazy, ErrorReporter &errors);
+
 private:
-	Token peek() const { return tokens[current]; }
+	// For parsing lazy bodies, shares the tokens and starts parsing at begin
+	Parser(
+		std::shared_ptr<const std::vector<Token>> tokens_,
+		std::vector<Token>::size_type begin, ErrorReporter &errors_
+	)
+		: tokens(std::move(tokens_))
+		, current(begin)
+		, errors(errors_)
+	{
+	}
+
+	const Token &peek() const { return (*tokens)[current]; }
 
-	Token previous() const { return tokens[current - 1]; }
+	const Token &previous() const { return (*tokens)[current - 1]; }
 
 	bool is_at_end() const { return peek().type == TokenType::END_OF_FILE; }
 
@@ -52,14 +75,14 @@ private:
 
 	ParseError make_error(Token token, std::string_view message) const
 	{
-		print_error(token, message);
+		errors.print_error(token, message);
 		return ParseError();
 	}
 
 	bool match(std::initializer_list<TokenType> types)
 	{
 		for (auto t : types) {
-			if (t == tokens[current].type) {
+			if (t == peek().type) {
 				advance();
 				return true;
 			}
@@ -94,6 +117,8 @@ private:
 
 	ExprPtr expression();
 	ExprPtr assignment();
+	// Parses the rest of a yield after the keyword
+	ExprPtr yield();
 	ExprPtr ternary();
 	ExprPtr logic_or();
 	ExprPtr logic_and();
@@ -108,12 +133,32 @@ private:
 	// Parsing helpers (common facilities)
 	// Parses a block. Like: { ... }
 	std::vector<StmtPtr> bare_block();
+	// Skips a function body after its '{', only checking that the brackets
+	// are balanced. Returns a LazyBody for parsing it later.
+	std::shared_ptr<LazyBody> skip_body();
+	// Returns the CountedLoop for a 'for' loop if it has the required form,
+	// see CountedLoop. Otherwise returns nullptr.
+	std::unique_ptr<CountedLoop> counted_loop(
+		const Stmt *initializer, const Expr *condition,
+		std::vector<Token>::size_type condition_begin, const Expr *increment
+	);
 	// Parses function call arguments and makes a Call object
 	// Like: arguments?)
 	ExprPtr finish_call(ExprPtr callee);
+	// Parses the rest of a list literal after its '['
+	ExprPtr list_literal();
+	// Parses the rest of a map literal after its '{'
+	ExprPtr map_literal();
 
-	const std::vector<Token> tokens;
+	// Shared with the lazily parsed function bodies
+	const std::shared_ptr<const std::vector<Token>> tokens;
 	std::vector<Token>::size_type current = 0;
+	ErrorReporter &errors;
+	const bool lazy_functions = false;
+	// Number of enclosing blocks and function bodies
+	int nesting = 0;
+	// Set when a yield is parsed, for the function body being parsed
+	bool has_yield = false;
 };
 
 #endif
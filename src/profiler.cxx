@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <signal.h>
+#include <sys/time.h>
+#include <time.h>
+
+#include "profiler.hxx"
+
+// The Profiler sampled by the signal handler
+static std::atomic<Profiler *> active_profiler = nullptr;
+
+Profiler::Profiler(unsigned rate)
+	: thread(pthread_self())
+{
+	// Frames of the top level code
+	functions.push_back({"<script>", 0, nullptr});
+
+	Profiler *expected = nullptr;
+	if (!active_profiler.compare_exchange_strong(expected, this))
+		throw std::runtime_error("Another profiler is already running.");
+
+	struct sigaction action = {};
+	action.sa_handler = handle_signal;
+	action.sa_flags = SA_RESTART;
+	sigemptyset(&action.sa_mask);
+
+	auto interval = 1'000'000 / std::max(rate, 1u);
+	struct itimerval timer = {};
+	timer.it_interval.tv_sec = interval / 1'000'000;
+	timer.it_interval.tv_usec = std::max(interval % 1'000'000, 1u);
+	timer.it_value = timer.it_interval;
+
+	if (sigaction(SIGPROF, &action, nullptr) != 0
+		|| setitimer(ITIMER_PROF, &timer, nullptr) != 0) {
+		active_profiler = nullptr;
+		throw std::runtime_error("Cannot start the profiling timer.");
+	}
+	running = true;
+	start_time = thread_cpu_time();
+}
+
+void Profiler::stop()
+{
+	if (!running)
+		return;
+	running = false;
+
+	struct itimerval timer = {};
+	setitimer(ITIMER_PROF, &timer, nullptr);
+	// A signal still pending is ignored by the handler
+	active_profiler = nullptr;
+	cpu_time = thread_cpu_time() - start_time;
+	drain();
+}
+
+std::chrono::nanoseconds Profiler::thread_cpu_time() const
+{
+	clockid_t clock;
+	struct timespec time = {};
+	if (pthread_getcpuclockid(thread, &clock) == 0)
+		clock_gettime(clock, &time);
+	return std::chrono::seconds(time.tv_sec)
+		   + std::chrono::nanoseconds(time.tv_nsec);
+}
+
+void Profiler::handle_signal(int)
+{
+	auto profiler = active_profiler.load(std::memory_order_acquire);
+	if (profiler == nullptr)
+		return;
+
+	if (!pthread_equal(pthread_self(), profiler->thread)) {
+		profiler->other_threads.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+	profiler->sample();
+}
+
+void Profiler::sample()
+{
+	auto frames = std::min(depth.load(std::memory_order_acquire), MAX_DEPTH);
+	auto begin = written.load(std::memory_order_relaxed);
+	auto used = begin - read.load(std::memory_order_acquire);
+	if (RING_SIZE - used < frames + 1) {
+		dropped.fetch_add(1, std::memory_order_relaxed);
+		return;
+	}
+
+	ring[begin % RING_SIZE] = frames;
+	for (std::size_t i = 0; i < frames; ++i)
+		ring[(begin + 1 + i) % RING_SIZE] = stack[i];
+	written.store(begin + 1 + frames, std::memory_order_release);
+}
+
+void Profiler::drain()
+{
+	auto end = written.load(std::memory_order_acquire);
+	auto position = read.load(std::memory_order_relaxed);
+	std::vector<unsigned> frames;
+
+	while (position != end) {
+		std::size_t count = ring[position++ % RING_SIZE];
+		frames.assign(1, 0);
+		for (std::size_t i = 0; i < count; ++i)
+			frames.push_back(ring[position++ % RING_SIZE]);
+		stacks[frames]++;
+	}
+
+	read.store(position, std::memory_order_release);
+}
+
+unsigned Profiler::function_id(const Function &function)
+{
+	// A lazy body is compiled into body on the first call, it stays the key
+	std::shared_ptr<const void> body = function.body;
+	if (function.lazy_body != nullptr)
+		body = function.lazy_body;
+
+	auto [entry, inserted] =
+		function_ids.try_emplace(body.get(), functions.size());
+	if (inserted) {
+		functions.push_back(
+			{function.name.lexeme, function.name.line, std::move(body)}
+		);
+	}
+	return entry->second;
+}
+
+std::string Profiler::frame_name(unsigned id) const
+{
+	auto &function = functions[id];
+	if (id == 0)
+		return function.name;
+	return std::format("{}:{}", function.name, function.line);
+}
+
+void Profiler::report(std::ostream &out)
+{
+	drain();
+
+	std::uint64_t total_samples = 0;
+	std::vector<std::uint64_t> self(functions.size());
+	std::vector<std::uint64_t> total(functions.size());
+	for (auto &[frames, count] : stacks) {
+		total_samples += count;
+		self[frames.back()] += count;
+		// A recursive function is only counted once in each stack
+		for (auto id : std::set<unsigned>(frames.begin(), frames.end()))
+			total[id] += count;
+	}
+
+	std::vector<unsigned> order;
+	for (unsigned id = 0; id < functions.size(); ++id) {
+		if (total[id] != 0)
+			order.push_back(id);
+	}
+	std::sort(order.begin(), order.end(), [&](unsigned a, unsigned b) {
+		return self[a] != self[b] ? self[a] > self[b] : total[a] > total[b];
+	});
+
+	auto elapsed = running ? thread_cpu_time() - start_time : cpu_time;
+	auto total_ms = std::chrono::duration<double, std::milli>(elapsed).count();
+	auto taken = std::max<std::uint64_t>(total_samples + dropped, 1);
+	auto milliseconds = [&](std::uint64_t samples) {
+		return samples * total_ms / taken;
+	};
+	auto percent = [&](std::uint64_t samples) {
+		return samples * 100.0 / std::max<std::uint64_t>(total_samples, 1);
+	};
+
+	out << std::format(
+		"Profile: {} samples over {:.1f} ms of CPU time\n", total_samples,
+		total_ms
+	);
+	out << std::format(
+		"  {:>10}{:>8}{:>12}{:>8}  {}\n", "self ms", "self", "total ms",
+		"total", "function"
+	);
+	for (auto id : order) {
+		out << std::format(
+			"  {:>10.1f}{:>7.1f}%{:>12.1f}{:>7.1f}%  {}\n",
+			milliseconds(self[id]), percent(self[id]), milliseconds(total[id]),
+			percent(total[id]), frame_name(id)
+		);
+	}
+
+	if (dropped != 0)
+		out << std::format("  {} samples dropped\n", dropped.load());
+	if (other_threads != 0) {
+		out << std::format(
+			"  {} samples in other threads not profiled\n", other_threads.load()
+		);
+	}
+}
+
+void Profiler::write_folded(std::ostream &out)
+{
+	drain();
+
+	for (auto &[frames, count] : stacks) {
+		for (std::size_t i = 0; i < frames.size(); ++i)
+			out << (i == 0 ? "" : ";") << frame_name(frames[i]);
+		out << ' ' << count << '\n';
+	}
+}
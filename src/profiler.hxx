@@ -0,0 +1,155 @@
+#ifndef PROFILER_HXX_INCLUDED
+#define PROFILER_HXX_INCLUDED
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <ostream>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <pthread.h>
+
+#include "stmt.hxx"
+
+// Samples the Lox call stack of an interpreter on a SIGPROF timer, enabled
+// with --profile. Only one can run at a time, and only the thread which
+// created it is profiled: the actors are not.
+//
+// LoxFunction::call keeps a shadow stack of the functions being run, as ids
+// in a fixed array. The signal handler copies it into a ring buffer, which
+// the profiled thread drains into the stacks seen, on calls once it is half
+// full and when reporting. Time spent in natives and generators is counted
+// in the function calling them.
+class Profiler
+{
+public:
+	/// Starts sampling rate times a second of CPU time, or as often as
+	/// the kernel's timer allows.
+	/// Throws a std::runtime_error if another Profiler is running.
+	Profiler(unsigned rate);
+	Profiler(const Profiler &) = delete;
+	Profiler &operator=(const Profiler &) = delete;
+	~Profiler() { stop(); }
+
+	void stop();
+
+	/// Writes the time spent in each function, and in the ones it called.
+	void report(std::ostream &out);
+	/// Writes the stacks sampled in the folded format of flamegraph.pl:
+	/// a line of frames separated by ';' and the number of samples each.
+	void write_folded(std::ostream &out);
+
+	// Pushes a frame for a call of the function while in scope
+	class Scope
+	{
+	public:
+		Scope(Profiler *profiler_, const Function &function)
+			: profiler(profiler_)
+		{
+			if (profiler != nullptr)
+				profiler->enter(function);
+		}
+
+		Scope(const Scope &) = delete;
+		Scope &operator=(const Scope &) = delete;
+
+		~Scope()
+		{
+			if (profiler != nullptr)
+				profiler->leave();
+		}
+
+		/// The frame is now for a tail call of the function.
+		void replace(const Function &function)
+		{
+			if (profiler != nullptr)
+				profiler->replace(function);
+		}
+
+	private:
+		Profiler *profiler;
+	};
+
+private:
+	// Deeper frames are not recorded, the samples are cut at this depth
+	static constexpr std::size_t MAX_DEPTH = 4096;
+	// Entries of the ring buffer, a sample takes its depth plus one
+	static constexpr std::size_t RING_SIZE = 1 << 20;
+
+	struct FunctionInfo {
+		std::string name;
+		int line;
+		// Keeps the key alive so that it names this function only
+		std::shared_ptr<const void> body;
+	};
+
+	static void handle_signal(int);
+	// CPU time used by the profiled thread so far
+	std::chrono::nanoseconds thread_cpu_time() const;
+
+	void enter(const Function &function)
+	{
+		auto current = depth.load(std::memory_order_relaxed);
+		if (current < MAX_DEPTH)
+			stack[current] = function_id(function);
+		depth.store(current + 1, std::memory_order_release);
+
+		if (written.load(std::memory_order_relaxed)
+				- read.load(std::memory_order_relaxed)
+			> RING_SIZE / 2)
+			drain();
+	}
+
+	void leave()
+	{
+		depth.store(
+			depth.load(std::memory_order_relaxed) - 1, std::memory_order_release
+		);
+	}
+
+	void replace(const Function &function)
+	{
+		auto current = depth.load(std::memory_order_relaxed);
+		if (current <= MAX_DEPTH)
+			stack[current - 1] = function_id(function);
+		std::atomic_signal_fence(std::memory_order_release);
+	}
+
+	// Identifies the function by its body, shared by all of its closures
+	unsigned function_id(const Function &function);
+	// Copies the shadow stack into the ring buffer, in the signal handler
+	void sample();
+	// Moves the samples out of the ring buffer into stacks
+	void drain();
+	// Name and line of the function, they may be declared more than once
+	std::string frame_name(unsigned id) const;
+
+	std::vector<FunctionInfo> functions;
+	std::unordered_map<const void *, unsigned> function_ids;
+	// Samples for each stack seen, outermost frame first
+	std::map<std::vector<unsigned>, std::uint64_t> stacks;
+
+	std::unique_ptr<unsigned[]> stack{new unsigned[MAX_DEPTH]};
+	std::atomic<std::size_t> depth = 0;
+	std::unique_ptr<unsigned[]> ring{new unsigned[RING_SIZE]};
+	// Entries written by the signal handler and read by drain, they only
+	// grow and are taken modulo RING_SIZE
+	std::atomic<std::size_t> written = 0;
+	std::atomic<std::size_t> read = 0;
+	std::atomic<std::uint64_t> dropped = 0;
+	std::atomic<std::uint64_t> other_threads = 0;
+
+	pthread_t thread;
+	bool running = false;
+	// The time of a sample is the CPU time used while running over the
+	// samples taken, the timer may be coarser than the rate asked for.
+	std::chrono::nanoseconds start_time;
+	std::chrono::nanoseconds cpu_time{0};
+};
+
+#endif
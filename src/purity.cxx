@@ -0,0 +1,189 @@
+#include <vector>
+
+#include "token.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "purity.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+
+bool PurityAnalysis::check(
+	const Function &function, std::vector<Token> &callees_
+)
+{
+	pure = !function.is_generator();
+	callees = &callees_;
+	walk(*function.body);
+	return pure;
+}
+
+void PurityAnalysis::walk(const std::vector<StmtPtr> &statements)
+{
+	for (auto &stmt : statements) {
+		if (!pure)
+			return;
+		walk(*stmt);
+	}
+}
+
+void PurityAnalysis::walk(const ExprPtr &expr)
+{
+	if (expr != nullptr && pure)
+		expr->accept(*this);
+}
+
+bool PurityAnalysis::is_local(const Expr &expr) const
+{
+	// Only functions declared in the globals are checked, so a variable
+	// resolved to a scope is one of the function's own
+	return interpreter.locals.contains(&expr);
+}
+
+// Statement visitor methods
+//---------------------------------------------------------
+
+void PurityAnalysis::visit_block_stmt(const Block &stmt)
+{
+	walk(stmt.statements);
+}
+
+void PurityAnalysis::visit_expr_stmt(const Expression &stmt)
+{
+	walk(stmt.expression);
+}
+
+void PurityAnalysis::visit_assert_stmt(const Assert &stmt)
+{
+	walk(stmt.expression);
+}
+
+void PurityAnalysis::visit_return_stmt(const Return &stmt)
+{
+	walk(stmt.value);
+}
+
+void PurityAnalysis::visit_if_stmt(const If &stmt)
+{
+	walk(stmt.condition);
+	walk(*stmt.then_branch);
+	if (stmt.else_branch != nullptr)
+		walk(*stmt.else_branch);
+}
+
+void PurityAnalysis::visit_while_stmt(const While &stmt)
+{
+	walk(stmt.condition);
+	walk(*stmt.body);
+	walk(stmt.for_update);
+}
+
+void PurityAnalysis::visit_var_stmt(const Var &stmt)
+{
+	walk(stmt.initializer);
+}
+
+// Expression visitor methods
+//---------------------------------------------------------
+
+Object PurityAnalysis::visit_assign_expr(const Assign &expr)
+{
+	if (!is_local(expr))
+		return impure();
+	walk(expr.expression);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_ternary_expr(const Ternary &expr)
+{
+	walk(expr.condition);
+	walk(expr.true_expr);
+	walk(expr.false_expr);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_logical_expr(const Logical &expr)
+{
+	walk(expr.left);
+	walk(expr.right);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_binary_expr(const Binary &expr)
+{
+	walk(expr.left);
+	walk(expr.right);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_call_expr(const Call &expr)
+{
+	// A global function called by its name, whatever it holds when called
+	auto callee = dynamic_cast<const Variable *>(expr.callee.get());
+	if (callee != nullptr && !is_local(*callee))
+		callees->push_back(callee->name);
+	else
+		walk(expr.callee);
+
+	for (auto &argument : expr.arguments)
+		walk(argument);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_grouping_expr(const Grouping &expr)
+{
+	walk(expr.expression);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_unary_expr(const Unary &expr)
+{
+	walk(expr.right);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_variable_expr(const Variable &expr)
+{
+	// Globals may be assigned to between the calls
+	if (!is_local(expr))
+		return impure();
+	return nullptr;
+}
+
+// The lists and maps are created by the call, it may change them
+
+Object PurityAnalysis::visit_list_literal_expr(const ListLiteral &expr)
+{
+	for (auto &element : expr.elements)
+		walk(element);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_map_literal_expr(const MapLiteral &expr)
+{
+	for (auto &key : expr.keys)
+		walk(key);
+	for (auto &value : expr.values)
+		walk(value);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_subscript_expr(const Subscript &expr)
+{
+	walk(expr.object);
+	walk(expr.index);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_subscript_set_expr(const SubscriptSet &expr)
+{
+	walk(expr.object);
+	walk(expr.index);
+	walk(expr.value);
+	return nullptr;
+}
+
+Object PurityAnalysis::visit_inline_call_expr(const InlineCall &expr)
+{
+	// The body inlined is that of the function called, checked with it
+	return visit_call_expr(*expr.call);
+}
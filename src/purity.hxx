@@ -0,0 +1,96 @@
+#ifndef PURITY_HXX_INCLUDED
+#define PURITY_HXX_INCLUDED
+
+#include <vector>
+
+#include "token.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "object/object.hxx"
+
+class Interpreter;
+
+// Checks the body of a function for anything making it impure, for the
+// Memoizer. Called with the same arguments, a pure function returns the
+// same result and does nothing else.
+//
+// The body may only use its own parameters and local variables, number,
+// string, list and map expressions, and the control flow statements. No
+// print, globals, closures, classes, instances or yield. It may call global
+// functions by their name: those are collected, and the function is only
+// pure if they are as well, which is for the Memoizer to check.
+class PurityAnalysis : private StmtVisitor, private ExprVisitor
+{
+public:
+	PurityAnalysis(const Interpreter &interpreter_)
+		: interpreter(interpreter_)
+	{
+	}
+
+	/// Returns false if the body is impure, otherwise adds the names of
+	/// the global functions it calls to callees.
+	bool check(const Function &function, std::vector<Token> &callees);
+
+private:
+	void visit_block_stmt(const Block &stmt) override;
+	void visit_expr_stmt(const Expression &stmt) override;
+	void visit_print_stmt(const Print &) override { pure = false; }
+	void visit_assert_stmt(const Assert &stmt) override;
+	void visit_break_stmt(const Break &) override {}
+	void visit_continue_stmt(const Continue &) override {}
+	void visit_return_stmt(const Return &stmt) override;
+	void visit_if_stmt(const If &stmt) override;
+	void visit_while_stmt(const While &stmt) override;
+	void visit_var_stmt(const Var &stmt) override;
+	void visit_function_stmt(const Function &) override { pure = false; }
+	void visit_class_stmt(const Class &) override { pure = false; }
+
+	Object visit_assign_expr(const Assign &expr) override;
+	Object visit_ternary_expr(const Ternary &expr) override;
+	Object visit_logical_expr(const Logical &expr) override;
+	Object visit_binary_expr(const Binary &expr) override;
+	Object visit_call_expr(const Call &expr) override;
+	Object visit_get_expr(const Get &) override { return impure(); }
+	Object visit_set_expr(const Set &) override { return impure(); }
+	Object visit_super_expr(const Super &) override { return impure(); }
+	Object visit_this_expr(const This &) override { return impure(); }
+	Object visit_grouping_expr(const Grouping &expr) override;
+	Object visit_literal_expr(const Literal &) override { return nullptr; }
+	Object visit_unary_expr(const Unary &expr) override;
+	Object visit_variable_expr(const Variable &expr) override;
+	Object visit_list_literal_expr(const ListLiteral &expr) override;
+	Object visit_map_literal_expr(const MapLiteral &expr) override;
+	Object visit_subscript_expr(const Subscript &expr) override;
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override;
+	Object visit_yield_expr(const Yield &) override { return impure(); }
+	Object visit_inline_call_expr(const InlineCall &expr) override;
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		return nullptr;
+	}
+	// Arithmetic and comparisons of local numbers, see TypeInference
+	Object visit_numeric_expr(const Numeric &) override { return nullptr; }
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return nullptr;
+	}
+
+	Object impure()
+	{
+		pure = false;
+		return nullptr;
+	}
+
+	void walk(const std::vector<StmtPtr> &statements);
+	void walk(const Stmt &stmt) { stmt.accept(*this); }
+	void walk(const ExprPtr &expr);
+
+	// Resolved to a variable of the function, not a global
+	bool is_local(const Expr &expr) const;
+
+	const Interpreter &interpreter;
+	bool pure = true;
+	std::vector<Token> *callees = nullptr;
+};
+
+#endif
@@ -1,12 +1,79 @@
+#include <memory>
+
 #include "token.hxx"
 #include "expr.hxx"
+#include "stmt.hxx"
 #include "resolver.hxx"
 #include "interpreter.hxx"
 
-void Resolver::resolve_local(const Expr &expr, const Token &name)
+void Resolver::resolve_lazy_body(const Function &function)
+{
+	auto &context = *function.lazy_body->context;
+	scopes = context.scopes;
+	current_class = context.current_class;
+	current_loop = context.current_loop;
+
+	resolve_function(function, context.type);
+}
+
+void Resolver::resolve_function(const Function &function, FunctionType type)
+{
+	// Body is not parsed yet, save the context for resolving it later.
+	if (function.lazy_body && !function.lazy_body->compiled) {
+		function.lazy_body->context = std::make_shared<ResolverContext>(
+			scopes, current_class, current_loop, type
+		);
+		return;
+	}
+
+	auto enclosing_function = current_function;
+	auto enclosing_in_generator = in_generator;
+	auto enclosing_yield_count = yield_count;
+	current_function = type;
+	in_generator = function.is_generator();
+	begin_scope();
+
+	for (auto &param : function.params) {
+		declare(param);
+		define(param);
+	}
+	resolve(*function.body);
+
+	end_scope();
+	current_function = enclosing_function;
+	in_generator = enclosing_in_generator;
+	yield_count = enclosing_yield_count;
+}
+
+void Resolver::begin_counted_loop(CountedLoop &loop)
 {
 	for (auto iter = scopes.crbegin(); iter != scopes.crend(); ++iter) {
-		if (iter->contains(name.lexeme))
+		if (iter->contains(loop.name.lexeme)) {
+			loop.distance = iter - scopes.crbegin();
+			break;
+		}
+	}
+
+	counted_loops.push_back(&loop);
+	resolve(*loop.limit);
+}
+
+bool Resolver::resolve_local(const Expr &expr, const Token &name)
+{
+	for (auto iter = scopes.crbegin(); iter != scopes.crend(); ++iter) {
+		if (iter->contains(name.lexeme)) {
 			interpreter.resolve(expr, iter - scopes.crbegin());
+			return true;
+		}
 	}
+
+	// Not found, assume it is global. Also drop any stale entry, AST nodes
+	// compiled later (lazy bodies, REPL lines) may reuse freed addresses.
+	interpreter.resolve_global(expr);
+	return false;
+}
+
+void Resolver::resolve_global_write(const Token &name)
+{
+	interpreter.resolve_global_write(name);
 }
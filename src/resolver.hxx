@@ -1,6 +1,7 @@
 #ifndef RESOLVER_HXX_INCLUDED
 #define RESOLVER_HXX_INCLUDED
 
+#include <cstddef>
 #include <vector>
 #include <string>
 #include <map>
@@ -17,11 +18,21 @@ class Resolver : private StmtVisitor, private ExprVisitor
 {
 
 public:
-	Resolver(Interpreter &interpreter_)
+	enum class ClassType { None, Class, Subclass };
+	enum class FunctionType { None, Function, Initializer, Method };
+	enum class LoopType { None, While };
+	using Scope = std::map<const std::string, bool>;
+
+	Resolver(Interpreter &interpreter_, ErrorReporter &errors_)
 		: interpreter(interpreter_)
+		, errors(errors_)
 	{
 	}
 
+	/// Resolves a lazily parsed function body after it has been parsed,
+	/// in the same context in which the function was declared.
+	void resolve_lazy_body(const Function &function);
+
 	void resolve(const std::vector<StmtPtr> &statements)
 	{
 		for (auto &stmt : statements) {
@@ -31,14 +42,24 @@ public:
 
 	void visit_block_stmt(const Block &stmt) override
 	{
-		begin_scope();
-		resolve(stmt.statements);
-		end_scope();
+		auto yields_before = yield_count;
+
+		if (!stmt.needs_environment) {
+			resolve(stmt.statements);
+		} else {
+			begin_scope();
+			resolve(stmt.statements);
+			end_scope();
+		}
+
+		if (yield_count != yields_before)
+			const_cast<Block &>(stmt).has_yield = true;
 	}
 
 	void visit_var_stmt(const Var &stmt) override
 	{
 		declare(stmt.name);
+		statement_yield_expr = statement_yield(stmt);
 		resolve(*stmt.initializer);
 		define(stmt.name);
 	}
@@ -53,7 +74,7 @@ public:
 
 		if (stmt.superclass
 			&& stmt.name.lexeme == stmt.superclass->name.lexeme) {
-			print_error(
+			errors.print_error(
 				stmt.superclass->name, "A class can't inherit from itself."
 			);
 		}
@@ -96,46 +117,73 @@ public:
 
 	void visit_expr_stmt(const Expression &stmt) override
 	{
+		statement_yield_expr = statement_yield(stmt);
 		resolve(*stmt.expression);
 	}
 
 	void visit_return_stmt(const Return &stmt) override
 	{
-		if (current_function == FunctionType::None)
-			print_error((stmt.keyword), "Return statement outside function.");
+		if (current_function == FunctionType::None) {
+			errors.print_error(
+				stmt.keyword, "Return statement outside function."
+			);
+		}
 
 		// Disallow returning a value from an initializer
 		if (stmt.value != nullptr
 			&& current_function == FunctionType::Initializer) {
-			print_error(
+			errors.print_error(
 				stmt.keyword, "Can't return a value from an initializer."
 			);
 		}
 
 		if (stmt.value != nullptr)
 			resolve(*stmt.value);
+
+		// Initializers always return 'this' and have no tail calls, neither
+		// do generators as they return from a LoxGenerator.
+		if ((current_function == FunctionType::Function
+			 || current_function == FunctionType::Method)
+			&& !in_generator && dynamic_cast<const Call *>(stmt.value.get()) != nullptr)
+			const_cast<Return &>(stmt).tail_call = true;
 	}
 
 	void visit_if_stmt(const If &stmt) override
 	{
+		auto yields_before = yield_count;
+
 		resolve(*stmt.condition);
 		resolve(*stmt.then_branch);
 		if (stmt.else_branch != nullptr)
 			resolve(*stmt.else_branch);
+
+		if (yield_count != yields_before)
+			const_cast<If &>(stmt).has_yield = true;
 	}
 
 	void visit_while_stmt(const While &stmt) override
 	{
+		auto yields_before = yield_count;
+
 		resolve(*stmt.condition);
 		if (stmt.for_update)
 			resolve(*stmt.for_update);
 
+		// The counter is watched while resolving the rest of the loop
+		if (stmt.counted)
+			begin_counted_loop(*stmt.counted);
+
 		auto enclosing_loop = current_loop;
 		current_loop = LoopType::While;
 
 		resolve(*stmt.body);
 
 		current_loop = enclosing_loop;
+		if (stmt.counted)
+			counted_loops.pop_back();
+
+		if (yield_count != yields_before)
+			const_cast<While &>(stmt).has_yield = true;
 	}
 
 	void visit_assert_stmt(const Assert &stmt) override
@@ -151,32 +199,45 @@ public:
 	void visit_break_stmt(const Break &stmt) override
 	{
 		if (current_loop == LoopType::None)
-			print_error(stmt.keyword, "break statement outside loop.");
+			errors.print_error(stmt.keyword, "break statement outside loop.");
 	}
 
 	void visit_continue_stmt(const Continue &stmt) override
 	{
 		if (current_loop == LoopType::None)
-			print_error(stmt.keyword, "continue statement outside loop.");
+			errors.print_error(
+				stmt.keyword, "continue statement outside loop."
+			);
 	}
 
 	Object visit_variable_expr(const Variable &expr) override
 	{
 		if (!scopes.empty() && scopes.back().contains(expr.name.lexeme)
 			&& scopes.back()[expr.name.lexeme] == false) {
-			print_error(
+			errors.print_error(
 				expr.name, "Can't read local variable in its own initializer."
 			);
 		}
 
+		for (auto loop : counted_loops) {
+			if (loop->name.lexeme == expr.name.lexeme)
+				loop->observed = true;
+		}
+
 		resolve_local(expr, expr.name);
 		return nullptr;
 	}
 
 	Object visit_assign_expr(const Assign &expr) override
 	{
+		for (auto loop : counted_loops) {
+			if (loop->name.lexeme == expr.name.lexeme)
+				loop->enabled = false;
+		}
+
 		resolve(*expr.expression);
-		resolve_local(expr, expr.name);
+		if (!resolve_local(expr, expr.name))
+			resolve_global_write(expr.name);
 		return nullptr;
 	}
 
@@ -223,12 +284,70 @@ public:
 		return nullptr;
 	}
 
+	Object visit_list_literal_expr(const ListLiteral &expr) override
+	{
+		for (auto &element : expr.elements)
+			resolve(*element);
+		return nullptr;
+	}
+
+	Object visit_map_literal_expr(const MapLiteral &expr) override
+	{
+		for (std::size_t i = 0; i < expr.keys.size(); ++i) {
+			resolve(*expr.keys[i]);
+			resolve(*expr.values[i]);
+		}
+		return nullptr;
+	}
+
+	Object visit_subscript_expr(const Subscript &expr) override
+	{
+		resolve(*expr.object);
+		resolve(*expr.index);
+		return nullptr;
+	}
+
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override
+	{
+		resolve(*expr.value);
+		resolve(*expr.object);
+		resolve(*expr.index);
+		return nullptr;
+	}
+
+	Object visit_yield_expr(const Yield &expr) override
+	{
+		if (current_function == FunctionType::None) {
+			errors.print_error(
+				expr.keyword, "Can't use 'yield' outside of a function."
+			);
+		} else if (current_function == FunctionType::Initializer) {
+			errors.print_error(
+				expr.keyword, "Can't use 'yield' in an initializer."
+			);
+		} else if (&expr != statement_yield_expr) {
+			errors.print_error(
+				expr.keyword,
+				"Can only use 'yield' as a statement, a variable's initializer "
+				"or the value assigned to a variable."
+			);
+		}
+
+		statement_yield_expr = nullptr;
+		yield_count++;
+		if (expr.value != nullptr)
+			resolve(*expr.value);
+		return nullptr;
+	}
+
 	Object visit_super_expr(const Super &expr) override
 	{
 		if (current_class == ClassType::None) {
-			print_error(expr.keyword, "Can't use 'super' outside of a class.");
+			errors.print_error(
+				expr.keyword, "Can't use 'super' outside of a class."
+			);
 		} else if (current_class != ClassType::Subclass) {
-			print_error(
+			errors.print_error(
 				expr.keyword, "Can't use 'super' in a class with no superclass."
 			);
 		}
@@ -240,7 +359,9 @@ public:
 	Object visit_this_expr(const This &expr) override
 	{
 		if (current_class == ClassType::None) {
-			print_error(expr.keyword, "Can't use 'this' outside of a class.");
+			errors.print_error(
+				expr.keyword, "Can't use 'this' outside of a class."
+			);
 			return nullptr;
 		}
 
@@ -262,11 +383,23 @@ public:
 
 	Object visit_literal_expr(const Literal &) override { return nullptr; }
 
-private:
-	enum class ClassType { None, Class, Subclass };
-	enum class FunctionType { None, Function, Initializer, Method };
-	enum class LoopType { None, While };
+	// Only made after resolution, by the Optimizer and TypeInference
+	Object visit_inline_call_expr(const InlineCall &) override
+	{
+		return nullptr;
+	}
+
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		return nullptr;
+	}
+	Object visit_numeric_expr(const Numeric &) override { return nullptr; }
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return nullptr;
+	}
 
+private:
 	// Just const_cast instead of sticking const in every accept method
 	void resolve(const Stmt &stmt) { const_cast<Stmt &>(stmt).accept(*this); }
 
@@ -278,10 +411,12 @@ private:
 
 	void declare(const Token &name)
 	{
-		if (scopes.empty())
+		if (scopes.empty()) {
+			resolve_global_write(name);
 			return;
+		}
 		if (scopes.back().contains(name.lexeme)) {
-			print_error(
+			errors.print_error(
 				name, "Already a variable with this name in this scope."
 			);
 		}
@@ -297,35 +432,49 @@ private:
 	}
 
 	// Resolves a funtion, by introducing its parameters in the current scope
-	void resolve_function(const Function &function, FunctionType type)
-	{
-		auto enclosing_function = current_function;
-		current_function = type;
-		begin_scope();
+	void resolve_function(const Function &function, FunctionType type);
 
-		for (auto &param : function.params) {
-			declare(param);
-			define(param);
-		}
-		resolve(*function.body);
+	// Finds the counter and resolves the limit of a counted loop
+	void begin_counted_loop(CountedLoop &loop);
 
-		end_scope();
-		current_function = enclosing_function;
-	}
-
-	void resolve_local(const Expr &expr, const Token &name);
+	// Returns false if the variable is global
+	bool resolve_local(const Expr &expr, const Token &name);
+	// Records a declaration of or an assignment to a global
+	void resolve_global_write(const Token &name);
 
 	// Store variables present in a socpe and along with info
 	// if they are defined(true) or just declared(false) yet.
 	// Each vector element represents a scope. The last element represents
 	// the current innermost scope.
-	std::vector<std::map<const std::string, bool>> scopes;
+	std::vector<Scope> scopes;
 	Interpreter &interpreter;
+	ErrorReporter &errors;
+
+	// Counted loops being resolved, any variable with the same name as
+	// the counter is taken to be the counter.
+	std::vector<CountedLoop *> counted_loops;
 
 	// Keeps track of if we are inside a class/function/loop
 	ClassType current_class = ClassType::None;
 	FunctionType current_function = FunctionType::None;
 	LoopType current_loop = LoopType::None;
+	// The function being resolved has a yield in its body
+	bool in_generator = false;
+
+	// Number of yields resolved in the current function, the statements
+	// during which it changes have a yield inside them.
+	unsigned yield_count = 0;
+	// The yield of the statement being resolved, if it is in one of the
+	// forms allowed, see statement_yield.
+	const Yield *statement_yield_expr = nullptr;
+};
+
+// State of the Resolver at the declaration of a lazily parsed function
+struct ResolverContext {
+	std::vector<Resolver::Scope> scopes;
+	Resolver::ClassType current_class;
+	Resolver::LoopType current_loop;
+	Resolver::FunctionType type;
 };
 
 #endif
@@ -20,7 +20,7 @@ static const std::map<std::string_view, TokenType> KEYWORD_MAP = {
 	{"print", PRINT}, {"return", RETURN},
 	{"break", BREAK}, {"continue", CONTINUE},
 	{"nil", NIL},     {"true", TRUE},
-	{"false", FALSE},
+	{"false", FALSE}, {"yield", YIELD},
 };
 
 void Scanner::do_identifier()
@@ -60,7 +60,7 @@ void Scanner::do_string()
 		advance();
 
 	if (is_at_end())
-		print_error(line, "Unterminated string litetral.");
+		errors.print_error(line, "Unterminated string litetral.");
 
 	advance(); // Eat the closing "
 
@@ -85,6 +85,12 @@ void Scanner::scan_token()
 	case '}':
 		add_token(RIGHT_BRACE);
 		break;
+	case '[':
+		add_token(LEFT_BRACKET);
+		break;
+	case ']':
+		add_token(RIGHT_BRACKET);
+		break;
 	case ',':
 		add_token(COMMA);
 		break;
@@ -147,7 +153,9 @@ void Scanner::scan_token()
 		else if (std::isalpha(c) || c == '_')
 			do_identifier();
 		else
-			print_error(line, std::format("Unexpected character '{}'.", c));
+			errors.print_error(
+				line, std::format("Unexpected character '{}'.", c)
+			);
 		break;
 	}
 }
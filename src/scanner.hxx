@@ -15,9 +15,9 @@
 class Scanner
 {
 public:
-	Scanner(std::string_view source_)
+	Scanner(std::string_view source_, ErrorReporter &errors_)
 		: source(source_)
-
+		, errors(errors_)
 	{
 	}
 
@@ -67,6 +67,7 @@ private:
 
 	using size_type = std::string_view::size_type;
 	const std::string_view source;
+	ErrorReporter &errors;
 	std::vector<Token> tokens;
 	size_type start = 0;
 	size_type current = 0;
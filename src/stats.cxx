@@ -0,0 +1,70 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "stats.hxx"
+
+// Entries listed of the node kinds, lines and functions
+constexpr std::size_t TOP_COUNT = 20;
+
+// Writes the largest counts of the entries first, with their share of total
+static void report_ranked(
+	std::ostream &out, std::string_view title,
+	std::vector<std::pair<std::string, std::uint64_t>> entries
+)
+{
+	std::uint64_t total = 0;
+	for (auto &entry : entries)
+		total += entry.second;
+
+	std::stable_sort(entries.begin(), entries.end(), [](auto &a, auto &b) {
+		return a.second > b.second;
+	});
+
+	out << std::format("  {} ({} in total):\n", title, total);
+	for (std::size_t i = 0; i < entries.size() && i < TOP_COUNT; ++i) {
+		auto &[name, count] = entries[i];
+		if (count == 0)
+			break;
+		out << std::format(
+			"    {:<22}{:>14}{:>7.1f}%\n", name, count, count * 100.0 / total
+		);
+	}
+}
+
+void ExecutionStats::report(std::ostream &out) const
+{
+	auto line = [&](std::string_view name, std::uint64_t count) {
+		out << std::format("  {:<24}{:>12}\n", name, count);
+	};
+
+	out << "Execution:\n";
+	line("call/block environments", environments);
+	line("break exceptions", breaks);
+	line("continue exceptions", continues);
+	line("return exceptions", returns);
+	line("tail call exceptions", tail_calls);
+	line("global variable lookups", global_lookups);
+	line("local variable lookups", local_lookups);
+
+	std::vector<std::pair<std::string, std::uint64_t>> entries;
+	for (std::size_t i = 0; i < nodes.size(); ++i)
+		entries.emplace_back(NODE_NAMES[i], nodes[i]);
+	report_ranked(out, "nodes run by the tree-walker", std::move(entries));
+
+	entries.clear();
+	for (std::size_t i = 0; i < lines.size(); ++i)
+		entries.emplace_back(std::format("line {}", i), lines[i]);
+	report_ranked(out, "nodes run on each line", std::move(entries));
+
+	entries.assign(calls.begin(), calls.end());
+	// The same order each time for functions called as often
+	std::sort(entries.begin(), entries.end());
+	report_ranked(out, "calls of each function", std::move(entries));
+}
@@ -0,0 +1,154 @@
+#ifndef STATS_HXX_INCLUDED
+#define STATS_HXX_INCLUDED
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <format>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+
+// Set by the LOX_STATS CMake option
+#ifndef LOX_STATS
+#define LOX_STATS 0
+#endif
+
+/// Whether the ExecutionStats are counted, without them nothing is done
+/// for them at run time.
+constexpr bool EXECUTION_STATS = LOX_STATS;
+
+// What was run, reported with --stats in a build with EXECUTION_STATS.
+// The nodes and lines are counted by the tree-walker only, the rest by
+// both engines.
+struct ExecutionStats {
+	enum class Node : unsigned char {
+		// Statements
+		Block,
+		Expression,
+		Print,
+		Assert,
+		Break,
+		Continue,
+		Return,
+		If,
+		While,
+		Var,
+		Function,
+		Class,
+		// Expressions
+		Assign,
+		Ternary,
+		Logical,
+		Binary,
+		Call,
+		Get,
+		Set,
+		Super,
+		This,
+		Grouping,
+		Literal,
+		Unary,
+		Variable,
+		ListLiteral,
+		MapLiteral,
+		Subscript,
+		SubscriptSet,
+		Yield,
+		InlineCall,
+		InlineParam,
+		Numeric,
+		NumericCondition,
+		COUNT
+	};
+
+	static constexpr std::array<std::string_view, std::size_t(Node::COUNT)>
+		NODE_NAMES = {
+			"block", "expression", "print", "assert", "break", "continue",
+			"return", "if", "while", "var", "function", "class", "assign",
+			"ternary", "logical", "binary", "call", "get", "set", "super",
+			"this", "grouping", "literal", "unary", "variable", "list literal",
+			"map literal", "subscript", "subscript set", "yield", "inline call",
+			"inline param", "numeric", "numeric condition",
+		};
+
+	std::array<std::uint64_t, std::size_t(Node::COUNT)> nodes = {};
+	// Executions of the nodes having a line, indexed by it
+	std::vector<std::uint64_t> lines;
+	// Calls of each Lox function, by name
+	std::unordered_map<std::string, std::uint64_t> calls;
+	// Created for calls, blocks and superclasses, not for bound methods
+	std::uint64_t environments = 0;
+	// Exceptions thrown for control flow
+	std::uint64_t breaks = 0;
+	std::uint64_t continues = 0;
+	std::uint64_t returns = 0;
+	std::uint64_t tail_calls = 0;
+	// Variables looked up or assigned to
+	std::uint64_t global_lookups = 0;
+	std::uint64_t local_lookups = 0;
+
+	/// @param line 0 if the node has none
+	void count_node(Node node, int line)
+	{
+		nodes[std::size_t(node)]++;
+		if (line <= 0)
+			return;
+		if (std::size_t(line) >= lines.size())
+			lines.resize(line + 1);
+		lines[line]++;
+	}
+
+	/// Writes the counters, the largest ones first.
+	void report(std::ostream &out) const;
+};
+
+// Counters collected while compiling and running, reported with --stats.
+struct Stats {
+	// Optimizer
+	std::size_t inlined_sites = 0;
+	std::size_t numeric_sites = 0;
+	// Interpreter
+	std::size_t inlined_calls = 0;
+	std::size_t inline_fallbacks = 0;
+	// JIT
+	std::size_t jit_compiled = 0;
+	std::size_t jit_calls = 0;
+	std::size_t jit_guard_fallbacks = 0;
+	// Memoizer
+	std::size_t memo_pure_functions = 0;
+	std::size_t memo_hits = 0;
+	std::size_t memo_misses = 0;
+	std::size_t memo_evictions = 0;
+	// Only counted in a build with EXECUTION_STATS
+	ExecutionStats execution;
+
+	void report(std::ostream &out) const
+	{
+		auto line = [&](std::string_view name, std::size_t count) {
+			out << std::format("  {:<24}{:>12}\n", name, count);
+		};
+
+		out << "Statistics:\n";
+		line("inlined call sites", inlined_sites);
+		line("numeric expressions", numeric_sites);
+		line("inlined calls", inlined_calls);
+		line("inline guard fallbacks", inline_fallbacks);
+		line("jit compiled functions", jit_compiled);
+		line("jit calls", jit_calls);
+		line("jit guard fallbacks", jit_guard_fallbacks);
+		line("memoized functions", memo_pure_functions);
+		line("memoized call hits", memo_hits);
+		line("memoized call misses", memo_misses);
+		line("memoized evictions", memo_evictions);
+
+		if constexpr (EXECUTION_STATS)
+			execution.report(out);
+		else
+			out << "Build with -DLOX_STATS=ON for the execution counters.\n";
+	}
+};
+
+#endif
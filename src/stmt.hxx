@@ -21,6 +21,7 @@ struct While;
 struct Var;
 struct Function;
 struct Class;
+struct ResolverContext;
 
 using StmtPtr = std::unique_ptr<Stmt>;
 
@@ -46,10 +47,7 @@ struct Stmt {
 };
 
 struct Block : public Stmt {
-	Block(std::vector<StmtPtr> statements_)
-		: statements(std::move(statements_))
-	{
-	}
+	Block(std::vector<StmtPtr> statements_, int line_ = 0);
 
 	void accept(StmtVisitor &visitor) const override
 	{
@@ -57,6 +55,12 @@ struct Block : public Stmt {
 	}
 
 	std::vector<StmtPtr> statements;
+	// Only blocks declaring something get their own scope and environment.
+	bool needs_environment;
+	// Set by the Resolver if a yield is inside, see LoxGenerator.
+	bool has_yield = false;
+	// Of the opening brace, 0 for the blocks made by desugaring.
+	int line;
 };
 
 template <typename... Stmts>
@@ -155,6 +159,9 @@ struct Return : public Stmt {
 
 	Token keyword;
 	ExprPtr value;
+	// Set by the Resolver if the value is a call in a function or method,
+	// such calls are made in the caller's place, see LoxFunction::call.
+	bool tail_call = false;
 };
 
 struct If : public Stmt {
@@ -173,13 +180,50 @@ struct If : public Stmt {
 	ExprPtr condition;
 	StmtPtr then_branch;
 	StmtPtr else_branch;
+	// Set by the Resolver if a yield is inside, see LoxGenerator.
+	bool has_yield = false;
+};
+
+// A 'for' loop of the form:
+//     for (var i = start; i < limit; i = i + step) body
+// with any of '<', '<=', '>', '>=' and '+', '-' and a number literal step.
+// Found by the Parser and checked by the Resolver, the loop is run with the
+// counter in a double which is written to the variable only when observed.
+struct CountedLoop {
+	CountedLoop(
+		const Token &name_, const Token &comparison_, ExprPtr limit_,
+		double step_
+	)
+		: name(name_)
+		, comparison(comparison_)
+		, limit(std::move(limit_))
+		, step(step_)
+	{
+	}
+
+	Token name;
+	Token comparison;
+	// A copy of the right side of the condition
+	ExprPtr limit;
+	double step;
+
+	// Set by the Resolver
+	int distance = 0;
+	// False if the counter is assigned to anywhere else
+	bool enabled = true;
+	// True if the counter is read by the body or the limit
+	bool observed = false;
 };
 
 struct While : public Stmt {
-	While(ExprPtr condition_, StmtPtr body_, ExprPtr for_update_ = nullptr)
+	While(
+		ExprPtr condition_, StmtPtr body_, ExprPtr for_update_ = nullptr,
+		std::unique_ptr<CountedLoop> counted_ = nullptr
+	)
 		: condition(std::move(condition_))
 		, body(std::move(body_))
 		, for_update(std::move(for_update_))
+		, counted(std::move(counted_))
 	{
 	}
 
@@ -193,6 +237,10 @@ struct While : public Stmt {
 	// Update clause for the 'for' loop, execute it after
 	// body finishes or we see a 'continue' statement.
 	ExprPtr for_update;
+	// Non-null if this is a counted 'for' loop
+	std::unique_ptr<CountedLoop> counted;
+	// Set by the Resolver if a yield is inside, see LoxGenerator.
+	bool has_yield = false;
 };
 
 struct Var : public Stmt {
@@ -211,14 +259,39 @@ struct Var : public Stmt {
 	ExprPtr initializer;
 };
 
+// A function body skipped by the pre-parser.
+// Stores the tokens needed to parse it and the state of the Resolver at the
+// point of declaration, so that it can be compiled on the first call.
+struct LazyBody {
+	LazyBody(
+		std::shared_ptr<const std::vector<Token>> tokens_,
+		std::vector<Token>::size_type begin_
+	)
+		: tokens(std::move(tokens_))
+		, begin(begin_)
+	{
+	}
+
+	std::shared_ptr<const std::vector<Token>> tokens;
+	// Index of the first token after the opening brace
+	std::vector<Token>::size_type begin;
+	// Filled by the Resolver
+	std::shared_ptr<ResolverContext> context;
+	bool compiled = false;
+	// Set by the Parser once compiled, see Function::is_generator
+	bool has_yield = false;
+};
+
 struct Function : public Stmt {
 	Function(
 		const Token &name_, std::vector<Token> params_,
-		std::shared_ptr<std::vector<StmtPtr>> body_
+		std::shared_ptr<std::vector<StmtPtr>> body_,
+		std::shared_ptr<LazyBody> lazy_body_ = nullptr
 	)
 		: name(name_)
 		, params(std::move(params_))
 		, body(std::move(body_))
+		, lazy_body(std::move(lazy_body_))
 	{
 	}
 
@@ -227,9 +300,20 @@ struct Function : public Stmt {
 		visitor.visit_function_stmt(*this);
 	}
 
+	// A call of it returns a LoxGenerator, if its body has a yield.
+	// Only known once a lazy body is compiled.
+	bool is_generator() const
+	{
+		return lazy_body != nullptr ? lazy_body->has_yield : has_yield;
+	}
+
 	Token name;
 	std::vector<Token> params;
 	std::shared_ptr<std::vector<StmtPtr>> body;
+	// Non-null if the body was skipped, body is empty until it is compiled
+	std::shared_ptr<LazyBody> lazy_body;
+	// Set by the Parser, if the body was not skipped
+	bool has_yield = false;
 };
 
 struct Class : public Stmt {
@@ -253,4 +337,33 @@ struct Class : public Stmt {
 	std::vector<Function> methods;
 };
 
+inline Block::Block(std::vector<StmtPtr> statements_, int line_)
+	: statements(std::move(statements_))
+	, needs_environment(false)
+	, line(line_)
+{
+	for (auto &stmt : statements) {
+		if (dynamic_cast<const Var *>(stmt.get()) != nullptr
+			|| dynamic_cast<const Function *>(stmt.get()) != nullptr
+			|| dynamic_cast<const Class *>(stmt.get()) != nullptr)
+			needs_environment = true;
+	}
+}
+
+// Returns the yield of a statement in one of the forms allowed for it:
+//     yield value;    name = yield value;    var name = yield value;
+// Returns nullptr for any other statement.
+inline const Yield *statement_yield(const Stmt &stmt)
+{
+	const Expr *expr = nullptr;
+	if (auto expression = dynamic_cast<const Expression *>(&stmt))
+		expr = expression->expression.get();
+	else if (auto var = dynamic_cast<const Var *>(&stmt))
+		expr = var->initializer.get();
+
+	if (auto assign = dynamic_cast<const Assign *>(expr))
+		expr = assign->expression.get();
+	return dynamic_cast<const Yield *>(expr);
+}
+
 #endif
\ No newline at end of file
@@ -0,0 +1,49 @@
+#include <mutex>
+#include <utility>
+
+#include "thread_pool.hxx"
+
+ThreadPool::ThreadPool(unsigned thread_count)
+{
+	threads.reserve(thread_count);
+	for (unsigned i = 0; i < thread_count; ++i)
+		threads.emplace_back(&ThreadPool::work, this);
+}
+
+ThreadPool::~ThreadPool()
+{
+	{
+		std::lock_guard lock(mutex);
+		stopping = true;
+	}
+	task_ready.notify_all();
+
+	for (auto &thread : threads)
+		thread.join();
+}
+
+void ThreadPool::submit(Task task)
+{
+	{
+		std::lock_guard lock(mutex);
+		tasks.push_back(std::move(task));
+	}
+	task_ready.notify_one();
+}
+
+void ThreadPool::work()
+{
+	for (;;) {
+		Task task;
+		{
+			std::unique_lock lock(mutex);
+			task_ready.wait(lock, [this] { return stopping || !tasks.empty(); });
+			// The tasks left are still run when stopping
+			if (tasks.empty())
+				return;
+			task = std::move(tasks.front());
+			tasks.pop_front();
+		}
+		task();
+	}
+}
@@ -0,0 +1,38 @@
+#ifndef THREAD_POOL_HXX_INCLUDED
+#define THREAD_POOL_HXX_INCLUDED
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed number of worker threads running the tasks submitted, in order.
+//
+// Lox objects are not shared between threads: a task should create its own
+// Lox and only hand its results back, see run_files in lox.cxx.
+class ThreadPool
+{
+public:
+	using Task = std::function<void()>;
+
+	ThreadPool(unsigned thread_count);
+	ThreadPool(const ThreadPool &) = delete;
+	ThreadPool &operator=(const ThreadPool &) = delete;
+	/// Waits for all the tasks submitted to finish.
+	~ThreadPool();
+
+	void submit(Task task);
+
+private:
+	void work();
+
+	std::vector<std::thread> threads;
+	std::deque<Task> tasks;
+	std::mutex mutex;
+	std::condition_variable task_ready;
+	bool stopping = false;
+};
+
+#endif
@@ -10,6 +10,8 @@ enum class TokenType {
 	RIGHT_PAREN,
 	LEFT_BRACE,
 	RIGHT_BRACE,
+	LEFT_BRACKET,
+	RIGHT_BRACKET,
 	COMMA,
 	DOT,
 	MINUS,
@@ -52,6 +54,7 @@ enum class TokenType {
 	RETURN,
 	BREAK,
 	CONTINUE,
+	YIELD,
 	NIL,
 	TRUE,
 	FALSE,
@@ -72,6 +75,10 @@ static std::string to_string(TokenType tt)
 		return "LEFT_BRACE";
 	case RIGHT_BRACE:
 		return "RIGHT_BRACE";
+	case LEFT_BRACKET:
+		return "LEFT_BRACKET";
+	case RIGHT_BRACKET:
+		return "RIGHT_BRACKET";
 	case COMMA:
 		return "COMMA";
 	case DOT:
@@ -144,6 +151,8 @@ static std::string to_string(TokenType tt)
 		return "BREAK";
 	case CONTINUE:
 		return "CONTINUE";
+	case YIELD:
+		return "YIELD";
 	case NIL:
 		return "NIL";
 	case TRUE:
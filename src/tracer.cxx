@@ -0,0 +1,83 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <format>
+#include <ostream>
+#include <string>
+#include <string_view>
+
+#include "tracer.hxx"
+
+// Number of the thread, its track in the trace
+static unsigned thread_number()
+{
+	static std::atomic<unsigned> threads = 0;
+	thread_local unsigned number = ++threads;
+	return number;
+}
+
+Tracer::Tracer(std::chrono::microseconds call_threshold_)
+	: call_threshold(call_threshold_)
+{
+}
+
+void Tracer::record(
+	const char *category, std::string_view name, Clock::time_point start,
+	Clock::time_point end
+)
+{
+	auto index = recorded.fetch_add(1, std::memory_order_relaxed);
+	auto &event = events[index % CAPACITY];
+
+	event.category = category;
+	auto length = std::min(name.size(), NAME_SIZE - 1);
+	std::copy_n(name.data(), length, event.name.begin());
+	event.name[length] = '\0';
+	event.start_ns =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(start - origin)
+			.count();
+	event.duration_ns =
+		std::chrono::duration_cast<std::chrono::nanoseconds>(end - start)
+			.count();
+	event.thread = thread_number();
+	event.written.store(index + 1, std::memory_order_release);
+}
+
+void Tracer::write_json(std::ostream &out) const
+{
+	auto count = recorded.load(std::memory_order_acquire);
+	auto first = count > CAPACITY ? count - CAPACITY : 0;
+
+	out << "{\"traceEvents\":[";
+	bool is_first = true;
+	for (auto index = first; index < count; ++index) {
+		auto &event = events[index % CAPACITY];
+		// Not written yet, or overwritten by a later one
+		if (event.written.load(std::memory_order_acquire) != index + 1)
+			continue;
+
+		std::string_view name(event.name.data());
+		std::string escaped;
+		for (char c : name) {
+			if (c == '"' || c == '\\')
+				escaped += '\\';
+			escaped += static_cast<unsigned char>(c) < 0x20 ? '?' : c;
+		}
+
+		out << (is_first ? "\n" : ",\n")
+			<< std::format(
+				   "{{\"name\":\"{}\",\"cat\":\"{}\",\"ph\":\"X\","
+				   "\"ts\":{:.3f},\"dur\":{:.3f},\"pid\":1,\"tid\":{}}}",
+				   escaped, event.category, event.start_ns / 1e3,
+				   event.duration_ns / 1e3, event.thread
+			   );
+		is_first = false;
+	}
+
+	out << std::format(
+		"\n],\"displayTimeUnit\":\"ms\",\"otherData\":{{"
+		"\"events_recorded\":{},\"events_overwritten\":{}}}}}\n",
+		count, first
+	);
+}
@@ -0,0 +1,132 @@
+#ifndef TRACER_HXX_INCLUDED
+#define TRACER_HXX_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <ostream>
+#include <string_view>
+
+// Records spans of time, like the compiler phases and garbage collections,
+// written at exit as Chrome trace event JSON for chrome://tracing and
+// Perfetto. Enabled with --trace.
+//
+// The events go into a ring buffer allocated up front, a span only reads
+// the clock twice and claims a slot with an atomic increment. Once it is
+// full the oldest events are overwritten. The interpreters of actors record
+// into the Tracer of the one which spawned them, each thread is a track.
+class Tracer
+{
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Events kept, the oldest ones are overwritten after that
+	static constexpr std::size_t CAPACITY = 1 << 16;
+
+	/// Calls of Lox functions made from the top level lasting at least
+	/// call_threshold are recorded too, none if it is zero.
+	Tracer(std::chrono::microseconds call_threshold_ = {});
+	Tracer(const Tracer &) = delete;
+	Tracer &operator=(const Tracer &) = delete;
+
+	/// Records an event, the name is cut to fit. Safe to call from any thread.
+	void record(
+		const char *category, std::string_view name, Clock::time_point start,
+		Clock::time_point end
+	);
+
+	/// Writes the events recorded so far, once the threads recording are done.
+	void write_json(std::ostream &out) const;
+
+	// Records the time from its creation to its destruction, does nothing
+	// if the tracer is null
+	class Span
+	{
+	public:
+		Span(Tracer *tracer_, const char *category_, std::string_view name_)
+			: tracer(tracer_)
+			, category(category_)
+			, name(name_)
+		{
+			if (tracer != nullptr)
+				start = Clock::now();
+		}
+
+		Span(const Span &) = delete;
+		Span &operator=(const Span &) = delete;
+
+		~Span()
+		{
+			if (tracer != nullptr)
+				tracer->record(category, name, start, Clock::now());
+		}
+
+	private:
+		Tracer *tracer;
+		const char *category;
+		std::string_view name;
+		Clock::time_point start;
+	};
+
+	// Records a call of a Lox function if it is made from the top level
+	// and lasts long enough. Calls nested in it are not recorded.
+	class CallSpan
+	{
+	public:
+		/// @param depth_ Of the calls being made by the interpreter
+		CallSpan(Tracer *tracer_, unsigned &depth_, std::string_view name_)
+			: tracer(tracer_)
+			, depth(depth_)
+			, name(name_)
+		{
+			if (tracer != nullptr && !tracer->traces_calls())
+				tracer = nullptr;
+			if (tracer != nullptr && depth++ == 0)
+				start = Clock::now();
+		}
+
+		CallSpan(const CallSpan &) = delete;
+		CallSpan &operator=(const CallSpan &) = delete;
+
+		~CallSpan()
+		{
+			if (tracer == nullptr || --depth != 0)
+				return;
+			auto end = Clock::now();
+			if (end - start >= tracer->call_threshold)
+				tracer->record("call", name, start, end);
+		}
+
+	private:
+		Tracer *tracer;
+		unsigned &depth;
+		std::string_view name;
+		Clock::time_point start;
+	};
+
+	/// Whether calls are recorded, see CallSpan.
+	bool traces_calls() const { return call_threshold.count() != 0; }
+
+private:
+	static constexpr std::size_t NAME_SIZE = 48;
+
+	struct Event {
+		const char *category;
+		std::array<char, NAME_SIZE> name;
+		std::int64_t start_ns;
+		std::int64_t duration_ns;
+		unsigned thread;
+		// Index of the event plus one once it is written, 0 before
+		std::atomic<std::size_t> written;
+	};
+
+	Clock::time_point origin = Clock::now();
+	std::chrono::microseconds call_threshold;
+	std::unique_ptr<Event[]> events{new Event[CAPACITY]()};
+	std::atomic<std::size_t> recorded = 0;
+};
+
+#endif
@@ -0,0 +1,479 @@
+#include <cassert>
+#include <cstddef>
+#include <functional>
+#include <memory>
+#include <variant>
+#include <vector>
+
+#include "token_type.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "numeric.hxx"
+#include "type_inference.hxx"
+#include "interpreter.hxx"
+#include "object/object.hxx"
+
+using enum TokenType;
+using std::make_unique;
+
+// Helper functions
+//---------------------------------------------------------
+
+static bool is_arithmetic(TokenType type)
+{
+	return type == PLUS || type == MINUS || type == STAR || type == SLASH;
+}
+
+static bool is_comparison(TokenType type)
+{
+	switch (type) {
+	case GREATER:
+	case GREATER_EQUAL:
+	case LESS:
+	case LESS_EQUAL:
+	case EQUAL_EQUAL:
+	case BANG_EQUAL:
+		return true;
+	default:
+		return false;
+	}
+}
+
+// TypeInference interface methods
+//---------------------------------------------------------
+
+void TypeInference::specialize(std::vector<StmtPtr> &statements)
+{
+	pass = Pass::Collect;
+	walk(statements);
+	solve();
+
+	pass = Pass::Rewrite;
+	walk(statements);
+}
+
+void TypeInference::specialize_function(const Function &function)
+{
+	pass = Pass::Collect;
+	walk_function(function);
+	solve();
+
+	pass = Pass::Rewrite;
+	walk_function(function);
+}
+
+void TypeInference::solve()
+{
+	for (bool changed = true; changed;) {
+		changed = false;
+
+		for (auto &variable : variables) {
+			if (!variable.numeric)
+				continue;
+
+			for (auto definition : variable.definitions) {
+				if (!is_numeric(*definition)) {
+					variable.numeric = false;
+					changed = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void TypeInference::walk(const std::vector<StmtPtr> &statements)
+{
+	for (auto &stmt : statements)
+		walk(*stmt);
+}
+
+void TypeInference::walk(const ExprPtr &expr)
+{
+	if (pass == Pass::Rewrite) {
+		// The AST is owned by the optimizer stage, like in the Optimizer.
+		auto &slot = const_cast<ExprPtr &>(expr);
+
+		if (is_specializable(*expr)) {
+			slot = make_unique<Numeric>(lower(*expr));
+			interpreter.stats.numeric_sites++;
+			return;
+		}
+
+		auto binary = dynamic_cast<const Binary *>(expr.get());
+		if (binary != nullptr && is_comparison(binary->operat.type)
+			&& is_numeric(*binary->left) && is_numeric(*binary->right)) {
+			slot = make_unique<NumericCondition>(lower_comparison(*binary));
+			interpreter.stats.numeric_sites++;
+			return;
+		}
+	}
+
+	expr->accept(*this);
+}
+
+void TypeInference::walk_function(const Function &function)
+{
+	// Lazy bodies are specialized after they are compiled.
+	if (function.lazy_body && !function.lazy_body->compiled)
+		return;
+
+	scopes.emplace_back();
+	for (auto &param : function.params)
+		declare_unknown(param);
+	walk(*function.body);
+	scopes.pop_back();
+}
+
+void TypeInference::declare_unknown(const Token &name)
+{
+	if (scopes.empty() || pass != Pass::Collect)
+		return;
+
+	auto &variable = variables.emplace_back();
+	variable.numeric = false;
+	scopes.back()[name.lexeme] = &variable;
+}
+
+TypeInference::VarInfo *TypeInference::find(const std::string &name) const
+{
+	for (auto iter = scopes.crbegin(); iter != scopes.crend(); ++iter) {
+		if (auto result = iter->find(name); result != iter->end())
+			return result->second;
+	}
+
+	return nullptr;
+}
+
+bool TypeInference::is_numeric(const Expr &expr) const
+{
+	if (auto literal = dynamic_cast<const Literal *>(&expr))
+		return match_types<double>(literal->value);
+
+	if (dynamic_cast<const Variable *>(&expr) != nullptr
+		|| dynamic_cast<const Assign *>(&expr) != nullptr) {
+		auto result = uses.find(&expr);
+		return result != uses.end() && result->second->numeric;
+	}
+
+	if (auto unary = dynamic_cast<const Unary *>(&expr)) {
+		auto type = unary->operat.type;
+		return (type == MINUS || type == PLUS) && is_numeric(*unary->right);
+	}
+
+	if (auto binary = dynamic_cast<const Binary *>(&expr)) {
+		return is_arithmetic(binary->operat.type) && is_numeric(*binary->left)
+			&& is_numeric(*binary->right);
+	}
+
+	if (auto grouping = dynamic_cast<const Grouping *>(&expr))
+		return is_numeric(*grouping->expression);
+
+	return false;
+}
+
+bool TypeInference::is_specializable(const Expr &expr) const
+{
+	bool has_operation = dynamic_cast<const Unary *>(&expr) != nullptr
+		|| dynamic_cast<const Binary *>(&expr) != nullptr
+		|| dynamic_cast<const Assign *>(&expr) != nullptr;
+
+	return has_operation && is_numeric(expr);
+}
+
+NumberExprPtr TypeInference::lower(const Expr &expr) const
+{
+	if (auto literal = dynamic_cast<const Literal *>(&expr))
+		return make_unique<NumberLiteral>(std::get<double>(literal->value));
+
+	if (auto variable = dynamic_cast<const Variable *>(&expr)) {
+		auto distance = interpreter.locals.at(variable);
+		return make_unique<NumberVariable>(variable->name.lexeme, distance);
+	}
+
+	if (auto assign = dynamic_cast<const Assign *>(&expr)) {
+		auto distance = interpreter.locals.at(assign);
+		return make_unique<NumberAssign>(
+			assign->name, distance, lower(*assign->expression)
+		);
+	}
+
+	if (auto unary = dynamic_cast<const Unary *>(&expr)) {
+		if (unary->operat.type == PLUS)
+			return lower(*unary->right);
+		return make_unique<NumberNegate>(lower(*unary->right));
+	}
+
+	if (auto grouping = dynamic_cast<const Grouping *>(&expr))
+		return lower(*grouping->expression);
+
+	auto &binary = dynamic_cast<const Binary &>(expr);
+	auto left = lower(*binary.left);
+	auto right = lower(*binary.right);
+
+	switch (binary.operat.type) {
+	case PLUS:
+		return make_unique<NumberBinary<std::plus<double>>>(
+			std::move(left), std::move(right)
+		);
+	case MINUS:
+		return make_unique<NumberBinary<std::minus<double>>>(
+			std::move(left), std::move(right)
+		);
+	case STAR:
+		return make_unique<NumberBinary<std::multiplies<double>>>(
+			std::move(left), std::move(right)
+		);
+	case SLASH:
+		return make_unique<NumberBinary<std::divides<double>>>(
+			std::move(left), std::move(right)
+		);
+
+	default:
+		break;
+	}
+
+	assert(!"Unreachable code");
+	return nullptr;
+}
+
+NumberConditionPtr TypeInference::lower_comparison(const Binary &expr) const
+{
+	auto left = lower(*expr.left);
+	auto right = lower(*expr.right);
+
+	switch (expr.operat.type) {
+	case GREATER:
+		return make_unique<NumberComparison<std::greater<double>>>(
+			std::move(left), std::move(right)
+		);
+	case GREATER_EQUAL:
+		return make_unique<NumberComparison<std::greater_equal<double>>>(
+			std::move(left), std::move(right)
+		);
+	case LESS:
+		return make_unique<NumberComparison<std::less<double>>>(
+			std::move(left), std::move(right)
+		);
+	case LESS_EQUAL:
+		return make_unique<NumberComparison<std::less_equal<double>>>(
+			std::move(left), std::move(right)
+		);
+	case EQUAL_EQUAL:
+		return make_unique<NumberComparison<std::equal_to<double>>>(
+			std::move(left), std::move(right)
+		);
+	case BANG_EQUAL:
+		return make_unique<NumberComparison<std::not_equal_to<double>>>(
+			std::move(left), std::move(right)
+		);
+
+	default:
+		break;
+	}
+
+	assert(!"Unreachable code");
+	return nullptr;
+}
+
+// Statement visitor methods
+//-----------------------------------------------
+
+void TypeInference::visit_block_stmt(const Block &stmt)
+{
+	scopes.emplace_back();
+	walk(stmt.statements);
+	scopes.pop_back();
+}
+
+void TypeInference::visit_expr_stmt(const Expression &stmt)
+{
+	walk(stmt.expression);
+}
+
+void TypeInference::visit_print_stmt(const Print &stmt)
+{
+	walk(stmt.expression);
+}
+
+void TypeInference::visit_assert_stmt(const Assert &stmt)
+{
+	walk(stmt.expression);
+}
+
+void TypeInference::visit_return_stmt(const Return &stmt)
+{
+	if (stmt.value != nullptr)
+		walk(stmt.value);
+}
+
+void TypeInference::visit_if_stmt(const If &stmt)
+{
+	walk(stmt.condition);
+	walk(*stmt.then_branch);
+	if (stmt.else_branch != nullptr)
+		walk(*stmt.else_branch);
+}
+
+void TypeInference::visit_while_stmt(const While &stmt)
+{
+	walk(stmt.condition);
+	if (stmt.counted != nullptr)
+		walk(stmt.counted->limit);
+	walk(*stmt.body);
+	if (stmt.for_update != nullptr)
+		walk(stmt.for_update);
+}
+
+void TypeInference::visit_var_stmt(const Var &stmt)
+{
+	walk(stmt.initializer);
+
+	// Globals can be changed from anywhere
+	if (scopes.empty() || pass != Pass::Collect)
+		return;
+
+	auto &variable = variables.emplace_back();
+	variable.definitions.push_back(stmt.initializer.get());
+	scopes.back()[stmt.name.lexeme] = &variable;
+}
+
+void TypeInference::visit_function_stmt(const Function &stmt)
+{
+	declare_unknown(stmt.name);
+	walk_function(stmt);
+}
+
+void TypeInference::visit_class_stmt(const Class &stmt)
+{
+	declare_unknown(stmt.name);
+	for (auto &method : stmt.methods)
+		walk_function(method);
+}
+
+// Expression visitor methods
+//-----------------------------------------------
+
+Object TypeInference::visit_assign_expr(const Assign &expr)
+{
+	walk(expr.expression);
+
+	if (pass != Pass::Collect)
+		return nullptr;
+
+	if (auto variable = find(expr.name.lexeme)) {
+		uses[&expr] = variable;
+		variable->definitions.push_back(expr.expression.get());
+	}
+	return nullptr;
+}
+
+Object TypeInference::visit_ternary_expr(const Ternary &expr)
+{
+	walk(expr.condition);
+	walk(expr.true_expr);
+	walk(expr.false_expr);
+	return nullptr;
+}
+
+Object TypeInference::visit_logical_expr(const Logical &expr)
+{
+	walk(expr.left);
+	walk(expr.right);
+	return nullptr;
+}
+
+Object TypeInference::visit_binary_expr(const Binary &expr)
+{
+	walk(expr.left);
+	walk(expr.right);
+	return nullptr;
+}
+
+Object TypeInference::visit_call_expr(const Call &expr)
+{
+	walk(expr.callee);
+	for (auto &arg : expr.arguments)
+		walk(arg);
+	return nullptr;
+}
+
+Object TypeInference::visit_get_expr(const Get &expr)
+{
+	walk(expr.object);
+	return nullptr;
+}
+
+Object TypeInference::visit_set_expr(const Set &expr)
+{
+	walk(expr.object);
+	walk(expr.value);
+	return nullptr;
+}
+
+Object TypeInference::visit_grouping_expr(const Grouping &expr)
+{
+	walk(expr.expression);
+	return nullptr;
+}
+
+Object TypeInference::visit_unary_expr(const Unary &expr)
+{
+	walk(expr.right);
+	return nullptr;
+}
+
+Object TypeInference::visit_variable_expr(const Variable &expr)
+{
+	if (pass != Pass::Collect)
+		return nullptr;
+
+	if (auto variable = find(expr.name.lexeme))
+		uses[&expr] = variable;
+	return nullptr;
+}
+
+Object TypeInference::visit_list_literal_expr(const ListLiteral &expr)
+{
+	for (auto &element : expr.elements)
+		walk(element);
+	return nullptr;
+}
+
+Object TypeInference::visit_map_literal_expr(const MapLiteral &expr)
+{
+	for (std::size_t i = 0; i < expr.keys.size(); ++i) {
+		walk(expr.keys[i]);
+		walk(expr.values[i]);
+	}
+	return nullptr;
+}
+
+Object TypeInference::visit_subscript_expr(const Subscript &expr)
+{
+	walk(expr.object);
+	walk(expr.index);
+	return nullptr;
+}
+
+Object TypeInference::visit_subscript_set_expr(const SubscriptSet &expr)
+{
+	walk(expr.object);
+	walk(expr.index);
+	walk(expr.value);
+	return nullptr;
+}
+
+Object TypeInference::visit_yield_expr(const Yield &expr)
+{
+	if (expr.value != nullptr)
+		walk(expr.value);
+	return nullptr;
+}
+
+Object TypeInference::visit_inline_call_expr(const InlineCall &expr)
+{
+	// The inlined body only refers to its parameters and globals.
+	visit_call_expr(*expr.call);
+	return nullptr;
+}
@@ -0,0 +1,120 @@
+#ifndef TYPE_INFERENCE_HXX_INCLUDED
+#define TYPE_INFERENCE_HXX_INCLUDED
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "token.hxx"
+#include "expr.hxx"
+#include "stmt.hxx"
+#include "numeric.hxx"
+#include "object/object.hxx"
+
+class Interpreter;
+
+// Proves local variables and expressions to be numbers and replaces the
+// numeric expressions and comparisons with Numeric and NumericCondition nodes.
+//
+// A local variable is numeric if its initializer and every value assigned to
+// it anywhere in its scope, closures included, are numeric. Starting with all
+// variables assumed numeric, variables with a non-numeric definition are
+// removed until nothing changes. Parameters and globals are never numeric,
+// as their values come from outside of the code being analysed.
+class TypeInference : private StmtVisitor, private ExprVisitor
+{
+public:
+	TypeInference(Interpreter &interpreter_)
+		: interpreter(interpreter_)
+	{
+	}
+
+	/// Specializes a program, the top-level statements.
+	void specialize(std::vector<StmtPtr> &statements);
+
+	/// Specializes a lazily compiled function body.
+	void specialize_function(const Function &function);
+
+	void visit_block_stmt(const Block &stmt) override;
+	void visit_expr_stmt(const Expression &stmt) override;
+	void visit_print_stmt(const Print &stmt) override;
+	void visit_assert_stmt(const Assert &stmt) override;
+	void visit_break_stmt(const Break &) override {}
+	void visit_continue_stmt(const Continue &) override {}
+	void visit_return_stmt(const Return &stmt) override;
+	void visit_if_stmt(const If &stmt) override;
+	void visit_while_stmt(const While &stmt) override;
+	void visit_var_stmt(const Var &stmt) override;
+	void visit_function_stmt(const Function &stmt) override;
+	void visit_class_stmt(const Class &stmt) override;
+
+	Object visit_assign_expr(const Assign &expr) override;
+	Object visit_ternary_expr(const Ternary &expr) override;
+	Object visit_logical_expr(const Logical &expr) override;
+	Object visit_binary_expr(const Binary &expr) override;
+	Object visit_call_expr(const Call &expr) override;
+	Object visit_get_expr(const Get &expr) override;
+	Object visit_set_expr(const Set &expr) override;
+	Object visit_super_expr(const Super &) override { return nullptr; }
+	Object visit_this_expr(const This &) override { return nullptr; }
+	Object visit_grouping_expr(const Grouping &expr) override;
+	Object visit_literal_expr(const Literal &) override { return nullptr; }
+	Object visit_unary_expr(const Unary &expr) override;
+	Object visit_variable_expr(const Variable &expr) override;
+	Object visit_list_literal_expr(const ListLiteral &expr) override;
+	Object visit_map_literal_expr(const MapLiteral &expr) override;
+	Object visit_subscript_expr(const Subscript &expr) override;
+	Object visit_subscript_set_expr(const SubscriptSet &expr) override;
+	Object visit_yield_expr(const Yield &expr) override;
+	Object visit_inline_call_expr(const InlineCall &expr) override;
+	Object visit_inline_param_expr(const InlineParam &) override
+	{
+		return nullptr;
+	}
+	Object visit_numeric_expr(const Numeric &) override { return nullptr; }
+	Object visit_numeric_condition_expr(const NumericCondition &) override
+	{
+		return nullptr;
+	}
+
+private:
+	struct VarInfo {
+		bool numeric = true;
+		// Initializer and the values assigned
+		std::vector<const Expr *> definitions;
+	};
+
+	using Scope = std::map<std::string, VarInfo *>;
+
+	// First pass collects the variables, second one replaces the expressions
+	enum class Pass { Collect, Rewrite };
+
+	// Removes the variables with non-numeric definitions, see above
+	void solve();
+
+	void walk(const std::vector<StmtPtr> &statements);
+	void walk(const Stmt &stmt) { stmt.accept(*this); }
+	void walk(const ExprPtr &expr);
+	void walk_function(const Function &function);
+
+	// Adds a variable which is never numeric to the current scope
+	void declare_unknown(const Token &name);
+	VarInfo *find(const std::string &name) const;
+
+	bool is_numeric(const Expr &expr) const;
+	// Numeric expression with at least one operation, worth replacing
+	bool is_specializable(const Expr &expr) const;
+	NumberExprPtr lower(const Expr &expr) const;
+	NumberConditionPtr lower_comparison(const Binary &expr) const;
+
+	Interpreter &interpreter;
+	Pass pass = Pass::Collect;
+
+	std::vector<Scope> scopes;
+	std::deque<VarInfo> variables;
+	// Variable and Assign nodes referring to local variables
+	std::map<const Expr *, VarInfo *> uses;
+};
+
+#endif
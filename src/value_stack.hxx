@@ -0,0 +1,131 @@
+#ifndef VALUE_STACK_HXX_INCLUDED
+#define VALUE_STACK_HXX_INCLUDED
+
+#include <cassert>
+#include <cstddef>
+#include <iterator>
+#include <memory>
+#include <optional>
+#include <span>
+#include <utility>
+#include <vector>
+
+#include "object/object.hxx"
+
+// The arguments of the calls being made by an interpreter. They are
+// evaluated in place and passed to the callables as a span of the stack.
+//
+// It grows a chunk at a time and the chunks never move, so the spans stay
+// valid while the callables make more calls. Once grown, calls allocate
+// nothing for their arguments. The garbage collector marks the values in
+// it as reachable, they are not in any environment yet.
+//
+// It also holds the callee and the arguments of a tail call, while the
+// function making it returns to LoxFunction::call, which makes the call.
+class ValueStack
+{
+public:
+	// Values in a chunk, the most a call can have
+	static constexpr std::size_t CHUNK_SIZE = 1024;
+
+	// Values pushed for a call, popped when it goes out of scope
+	class Frame
+	{
+	public:
+		Frame(ValueStack &stack_, std::size_t size)
+			: stack(stack_)
+			, saved_used(stack.used)
+			, saved_top(stack.top)
+			, frame_values(stack.push(size))
+		{
+		}
+
+		Frame(const Frame &) = delete;
+		Frame &operator=(const Frame &) = delete;
+
+		~Frame()
+		{
+			// Hold on to nothing after the call
+			for (auto &value : frame_values)
+				value = nullptr;
+			stack.used = saved_used;
+			stack.top = saved_top;
+		}
+
+		std::span<Object> values() const { return frame_values; }
+
+	private:
+		ValueStack &stack;
+		std::size_t saved_used;
+		std::size_t saved_top;
+		std::span<Object> frame_values;
+	};
+
+	/// Holds on to the callee and the arguments of a tail call, until
+	/// take_tail_call.
+	void hold_tail_call(Object callee, std::span<Object> arguments)
+	{
+		tail_call.clear();
+		tail_call.push_back(std::move(callee));
+		std::move(
+			arguments.begin(), arguments.end(), std::back_inserter(tail_call)
+		);
+	}
+
+	/// Moves the arguments of the tail call held to a new frame, replacing
+	/// the one in frame, and returns its callee.
+	Object take_tail_call(std::optional<Frame> &frame)
+	{
+		assert(!tail_call.empty());
+		frame.reset();
+		frame.emplace(*this, tail_call.size() - 1);
+		auto arguments = std::span(tail_call).subspan(1);
+		std::move(arguments.begin(), arguments.end(), frame->values().begin());
+
+		auto callee = std::move(tail_call.front());
+		tail_call.clear();
+		return callee;
+	}
+
+	/// Calls function with each value on the stack.
+	template <typename F>
+	void for_each(F function) const
+	{
+		for (std::size_t i = 0; i < used; ++i) {
+			auto end = i + 1 == used ? top : CHUNK_SIZE;
+			for (std::size_t j = 0; j < end; ++j)
+				function(chunks[i][j]);
+		}
+		for (auto &value : tail_call)
+			function(value);
+	}
+
+private:
+	std::span<Object> push(std::size_t size)
+	{
+		assert(size <= CHUNK_SIZE);
+		if (size == 0)
+			return {};
+
+		// The rest of the current chunk is left empty
+		if (top + size > CHUNK_SIZE) {
+			if (used == chunks.size())
+				chunks.push_back(std::make_unique<Object[]>(CHUNK_SIZE));
+			used++;
+			top = 0;
+		}
+
+		auto values = std::span(chunks[used - 1].get() + top, size);
+		top += size;
+		return values;
+	}
+
+	std::vector<std::unique_ptr<Object[]>> chunks;
+	// Chunks in use and values used in the last of them
+	std::size_t used = 0;
+	std::size_t top = CHUNK_SIZE;
+	// The callee first, empty unless a tail call is being made
+	std::vector<Object> tail_call;
+};
+
+#endif